@@ -0,0 +1,113 @@
+// Copyright 2009-2020 NTESS. Under the terms
+// of Contract DE-NA0003525 with NTESS, the U.S.
+// Government retains certain rights in this software.
+//
+// Copyright (c) 2009-2020, NTESS
+// All rights reserved.
+//
+// Portions are copyright of other developers:
+// See the file CONTRIBUTORS.TXT in the top level directory
+// the distribution for more information.
+//
+// This file is part of the SST software package. For license
+// information, see the LICENSE file in the top level directory of the
+// distribution.
+//
+
+#include <sst/core/sst_config.h>
+
+#include "binary_trace.h"
+
+#include <sst/core/timeLord.h>
+#include <sst/core/unitAlgebra.h>
+
+#include <chrono>
+#include <cstring>
+
+#include "merlin.h"
+
+using namespace SST::Merlin;
+
+static_assert(sizeof(TraceRecord) == 32, "TraceRecord must stay 32 bytes to match the decoder");
+static_assert(sizeof(TraceFileHeader) == 32, "TraceFileHeader must stay 32 bytes to match the decoder");
+
+static thread_local BinaryTrace *thread_trace = nullptr;
+
+BinaryTrace *BinaryTrace::acquire(const std::string &prefix) {
+    if (thread_trace == nullptr)
+        thread_trace = new BinaryTrace(prefix);
+    thread_trace->refs++;
+    return thread_trace;
+}
+
+void BinaryTrace::release(BinaryTrace *trace) {
+    if (trace == nullptr || --trace->refs > 0)
+        return;
+    if (thread_trace == trace)
+        thread_trace = nullptr;
+    delete trace;
+}
+
+BinaryTrace::BinaryTrace(const std::string &prefix) : current(0), fill(0), refs(0), done(false) {
+    RankInfo rank = Simulation::getSimulation()->getRank();
+    std::string name = prefix + "." + std::to_string(rank.rank) + "." + std::to_string(rank.thread) + ".bin";
+    file = fopen(name.c_str(), "wb");
+    if (file == nullptr) {
+        merlin_abort.fatal(CALL_INFO, -1, "Unable to open trace file %s\n", name.c_str());
+    }
+
+    TraceFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "MRLNTRC", 8);
+    header.version = 1;
+    header.record_size = sizeof(TraceRecord);
+    header.fs_per_cycle = (Simulation::getTimeLord()->getTimeBase() / UnitAlgebra("1fs")).getRoundedValue();
+    header.rank = rank.rank;
+    header.thread = rank.thread;
+    fwrite(&header, sizeof(header), 1, file);
+
+    chunks = new TraceRecord[num_chunks * records_per_chunk];
+    memset(chunks, 0, num_chunks * records_per_chunk * sizeof(TraceRecord));
+    for (int i = 1; i < num_chunks; i++) {
+        empty.push(i);
+    }
+
+    writer_thread = std::thread(&BinaryTrace::writer, this);
+}
+
+BinaryTrace::~BinaryTrace() {
+    if (fill > 0)
+        submit();
+    done.store(true, std::memory_order_release);
+    writer_thread.join();
+    fclose(file);
+    delete[] chunks;
+}
+
+void BinaryTrace::submit() {
+    chunk_fill[current] = fill;
+    full.push(current);
+    fill = 0;
+    // Every chunk is waiting to be written, so the writer is behind.
+    // Wait for it rather than drop records.
+    while (!empty.pop(current)) {
+        std::this_thread::yield();
+    }
+}
+
+void BinaryTrace::writer() {
+    while (true) {
+        // Nothing is pushed after done is set, so if it was set
+        // before an empty pop, everything has been written
+        bool finished = done.load(std::memory_order_acquire);
+        int chunk;
+        if (full.pop(chunk)) {
+            fwrite(&chunks[chunk * records_per_chunk], sizeof(TraceRecord), chunk_fill[chunk], file);
+            empty.push(chunk);
+            continue;
+        }
+        if (finished)
+            break;
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+}
@@ -0,0 +1,157 @@
+// -*- mode: c++ -*-
+
+// Copyright 2009-2020 NTESS. Under the terms
+// of Contract DE-NA0003525 with NTESS, the U.S.
+// Government retains certain rights in this software.
+//
+// Copyright (c) 2009-2020, NTESS
+// All rights reserved.
+//
+// Portions are copyright of other developers:
+// See the file CONTRIBUTORS.TXT in the top level directory
+// the distribution for more information.
+//
+// This file is part of the SST software package. For license
+// information, see the LICENSE file in the top level directory of the
+// distribution.
+
+#ifndef COMPONENTS_MERLIN_BINARY_TRACE_H
+#define COMPONENTS_MERLIN_BINARY_TRACE_H
+
+#include <sst/core/simulation.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+namespace SST {
+namespace Merlin {
+
+// Points along a packet's path that get a trace record.  These match
+// the TRACE lines printed when binary tracing is off.
+enum TraceKind : uint8_t {
+    // Request accepted by LinkControl::send()
+    TRACE_NIC_SEND = 0,
+    // LinkControl put the packet on the link to the router
+    TRACE_NIC_INJECT,
+    // PortControl received the packet, from a NIC or another router
+    TRACE_PORT_RECV,
+    // hr_router moved the packet across the crossbar
+    TRACE_XBAR,
+    // PortControl put the packet on its link
+    TRACE_PORT_SEND,
+    // LinkControl received the packet from the router
+    TRACE_NIC_RECV,
+    // The endpoint pulled the request out of LinkControl::recv()
+    TRACE_NIC_DELIVER
+};
+
+// Fixed size trace record.  location is the router id, or the
+// endpoint id for records written by LinkControl.  port and vc are -1
+// where they don't apply (vc holds the VN for NIC records).
+struct TraceRecord {
+    uint64_t time;
+    int32_t trace_id;
+    int32_t location;
+    int32_t src;
+    int32_t dest;
+    int16_t port;
+    int16_t vc;
+    uint8_t kind;
+    uint8_t pad[3];
+};
+
+// Header at the start of each trace file.  Times in the records are
+// in core time base cycles of fs_per_cycle femtoseconds.
+struct TraceFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t fs_per_cycle;
+    uint32_t rank;
+    uint32_t thread;
+};
+
+// Binary packet trace.  There is one per SST thread, shared by all
+// the components on that thread that have tracing turned on, and
+// each writes its own file, <prefix>.<rank>.<thread>.bin.  The prefix
+// comes from the first component on the thread to acquire it.
+//
+// Records are written into fixed size chunks.  A full chunk is handed
+// to a writer thread through a single producer, single consumer ring
+// of chunk indices and written out from there, while the writer hands
+// empty chunks back through a second ring.  The simulation thread
+// never waits on the file, only on the writer if every chunk is full.
+class BinaryTrace {
+  public:
+    static BinaryTrace *acquire(const std::string &prefix);
+    static void release(BinaryTrace *trace);
+
+    inline void record(TraceKind kind, int trace_id, int location, int port, int vc, int src, int dest) {
+        TraceRecord &rec = chunks[current * records_per_chunk + fill];
+        rec.time = Simulation::getSimulation()->getCurrentSimCycle();
+        rec.trace_id = trace_id;
+        rec.location = location;
+        rec.src = src;
+        rec.dest = dest;
+        rec.port = port;
+        rec.vc = vc;
+        rec.kind = kind;
+        if (++fill == records_per_chunk)
+            submit();
+    }
+
+  private:
+    static const int num_chunks = 8;
+    static const int records_per_chunk = 4096;
+
+    // Ring of chunk indices.  Sized so it can hold every chunk, which
+    // means push never fails.
+    struct ChunkRing {
+        int slots[num_chunks];
+        std::atomic<uint32_t> head{0};
+        std::atomic<uint32_t> tail{0};
+
+        void push(int chunk) {
+            uint32_t t = tail.load(std::memory_order_relaxed);
+            slots[t % num_chunks] = chunk;
+            tail.store(t + 1, std::memory_order_release);
+        }
+
+        bool pop(int &chunk) {
+            uint32_t h = head.load(std::memory_order_relaxed);
+            if (h == tail.load(std::memory_order_acquire))
+                return false;
+            chunk = slots[h % num_chunks];
+            head.store(h + 1, std::memory_order_release);
+            return true;
+        }
+    };
+
+    BinaryTrace(const std::string &prefix);
+    ~BinaryTrace();
+
+    void submit();
+    void writer();
+
+    FILE *file;
+    TraceRecord *chunks;
+    int current;
+    int fill;
+    // Number of records in each chunk handed to the writer.  Only the
+    // last one can be short.
+    int chunk_fill[num_chunks];
+    int refs;
+
+    ChunkRing full;
+    ChunkRing empty;
+    std::atomic<bool> done;
+    std::thread writer_thread;
+};
+
+} // namespace Merlin
+} // namespace SST
+
+#endif // COMPONENTS_MERLIN_BINARY_TRACE_H
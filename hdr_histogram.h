@@ -0,0 +1,132 @@
+// -*- mode: c++ -*-
+
+// Copyright 2009-2020 NTESS. Under the terms
+// of Contract DE-NA0003525 with NTESS, the U.S.
+// Government retains certain rights in this software.
+//
+// Copyright (c) 2009-2020, NTESS
+// All rights reserved.
+//
+// Portions are copyright of other developers:
+// See the file CONTRIBUTORS.TXT in the top level directory
+// the distribution for more information.
+//
+// This file is part of the SST software package. For license
+// information, see the LICENSE file in the top level directory of the
+// distribution.
+
+#ifndef COMPONENTS_MERLIN_HDR_HISTOGRAM_H
+#define COMPONENTS_MERLIN_HDR_HISTOGRAM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace SST {
+namespace Merlin {
+
+// Log-linear histogram in the style of HdrHistogram.  Values below
+// 2^sub_bits each get their own bucket.  Above that, each power of two
+// range is split into 2^(sub_bits - 1) equal buckets, so every value
+// is recorded to within a relative error of 2^-(sub_bits - 1).  The
+// bucket array is sized for max_value up front and values above it
+// land in the last bucket, so record() is a few shifts and an
+// increment.  The exact maximum is kept separately.
+class HdrHistogram {
+  public:
+    HdrHistogram() = default;
+
+    // digits is the number of significant decimal digits to keep
+    void init(int digits, uint64_t max_value) {
+        half_bits = 1;
+        for (uint64_t v = 2; v < pow10(digits); v <<= 1)
+            half_bits++;
+        sub_bits = half_bits + 1;
+        counts.assign(index(max_value) + 1, 0);
+        total = 0;
+        max = 0;
+    }
+
+    inline void record(uint64_t value) {
+        size_t i = index(value);
+        if (i >= counts.size())
+            i = counts.size() - 1;
+        counts[i]++;
+        total++;
+        if (value > max)
+            max = value;
+    }
+
+    // True if other was set up with the same parameters, which merge()
+    // needs
+    bool compatible(const HdrHistogram &other) const {
+        return sub_bits == other.sub_bits && counts.size() == other.counts.size();
+    }
+
+    void merge(const HdrHistogram &other) {
+        for (size_t i = 0; i < counts.size(); i++) {
+            counts[i] += other.counts[i];
+        }
+        total += other.total;
+        if (other.max > max)
+            max = other.max;
+    }
+
+    // Smallest recorded value v such that a fraction p of the values
+    // are <= v, rounded up to the top of its bucket (and never more
+    // than the maximum)
+    uint64_t percentile(double p) const {
+        if (total == 0)
+            return 0;
+        uint64_t target = (uint64_t)(p * total + 0.5);
+        if (target == 0)
+            target = 1;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < counts.size(); i++) {
+            seen += counts[i];
+            if (seen >= target) {
+                uint64_t top = highest(i);
+                return top < max ? top : max;
+            }
+        }
+        return max;
+    }
+
+    uint64_t getCount() const { return total; }
+    uint64_t getMax() const { return max; }
+
+  private:
+    static uint64_t pow10(int digits) {
+        uint64_t v = 1;
+        for (int i = 0; i < digits; i++)
+            v *= 10;
+        return v;
+    }
+
+    inline size_t index(uint64_t value) const {
+        if (value < ((uint64_t)1 << sub_bits))
+            return value;
+        int shift = (63 - __builtin_clzll(value)) - half_bits;
+        return ((size_t)shift << half_bits) + (value >> shift);
+    }
+
+    // Largest value that maps to bucket i
+    uint64_t highest(size_t i) const {
+        if (i < ((size_t)1 << sub_bits))
+            return i;
+        int shift = (int)(i >> half_bits) - 1;
+        uint64_t mantissa = i - ((size_t)shift << half_bits);
+        return ((mantissa + 1) << shift) - 1;
+    }
+
+    int sub_bits{1};
+    int half_bits{0};
+    std::vector<uint64_t> counts;
+    uint64_t total{0};
+    uint64_t max{0};
+};
+
+} // namespace Merlin
+} // namespace SST
+
+#endif // COMPONENTS_MERLIN_HDR_HISTOGRAM_H
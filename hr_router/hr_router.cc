@@ -27,6 +27,7 @@
 #include <csignal>
 
 #include "../merlin.h"
+#include "../binary_trace.h"
 
 using namespace SST::Merlin;
 using namespace SST::Interfaces;
@@ -107,6 +108,7 @@ static UnitAlgebra getLogicalGroupParamUA(const Params &params, Topology *topo,
 
 // Start class functions
 hr_router::~hr_router() {
+    BinaryTrace::release(trace);
     delete[] in_port_busy;
     delete[] out_port_busy;
     delete[] progress_vcs;
@@ -140,6 +142,7 @@ hr_router::hr_router(ComponentId_t cid, Params &params)
     if (!topo) {
         merlin_abort.fatal(CALL_INFO_LONG, 1, "hr_router requires topology to be specified in input file\n");
     }
+    topo->setRouter(this);
 
     // Get the number of VNs
     num_vns = params.find<int>("num_vns", 2);
@@ -236,6 +239,13 @@ hr_router::hr_router(ComponentId_t cid, Params &params)
         pc_params.insert("network_inspectors", params.find<std::string>("network_inspectors", ""));
     pc_params.insert("oql_track_port", params.find<std::string>("oql_track_port", "false"));
     pc_params.insert("oql_track_remote", params.find<std::string>("oql_track_remote", "false"));
+    pc_params.insert("source_routing", params.find<std::string>("source_routing", "false"));
+    voq = params.find<std::string>("input_queueing", "fifo") == "voq";
+    pc_params.insert("input_queueing", params.find<std::string>("input_queueing", "fifo"));
+    pc_params.insert("router_ports", std::to_string(num_ports));
+    std::string trace_file = params.find<std::string>("trace_file", "");
+    pc_params.insert("trace_file", trace_file);
+    trace = trace_file.empty() ? nullptr : BinaryTrace::acquire(trace_file);
 
     for (int i = 0; i < num_ports; i++) {
         in_port_busy[i] = 0;
@@ -283,11 +293,39 @@ hr_router::hr_router(ComponentId_t cid, Params &params)
     // Get the Xbar arbitration
     std::string xbar_arb = params.find<std::string>("xbar_arb", "merlin.xbar_arb_lru");
 
-    Params empty_params; // Empty params sent to subcomponents
-    arb = loadAnonymousSubComponent<XbarArbitration>(xbar_arb, "XbarArb", 0, ComponentInfo::INSERT_STATS, empty_params);
+    Params arb_params = params.find_prefix_params("xbar_arb:");
+    arb = loadAnonymousSubComponent<XbarArbitration>(xbar_arb, "XbarArb", 0, ComponentInfo::INSERT_STATS, arb_params);
 
-    my_clock_handler = new Clock::Handler<hr_router>(this, &hr_router::clock_handler);
-    xbar_tc = registerClock(xbar_clock, my_clock_handler);
+    std::string xbar_mode = params.find<std::string>("xbar_mode", "clocked");
+    if (xbar_mode == "clocked") {
+        event_driven = false;
+    } else if (xbar_mode == "event") {
+        event_driven = true;
+    } else {
+        merlin_abort.fatal(CALL_INFO, -1, "hr_router: unknown xbar_mode: %s\n", xbar_mode.c_str());
+    }
+
+    xbar_timing = nullptr;
+    xbar_scheduled = false;
+    next_xbar_cycle = 0;
+    last_xbar_cycle = 0;
+    xbar_had_data = false;
+    if (event_driven) {
+        // The self link runs on the core time base so events can be
+        // placed on xbar clock edges no matter when a notification
+        // comes in.
+        my_clock_handler = nullptr;
+        xbar_tc = getTimeConverter(xbar_clock);
+        TimeConverter *base_tc = getTimeConverter(Simulation::getTimeLord()->getTimeBase());
+        xbar_timing =
+            configureSelfLink("xbar_timing", base_tc, new Event::Handler<hr_router>(this, &hr_router::handle_xbar));
+        // Nothing to do until data or credits show up
+        setRequestNotifyOnEvent(true);
+        setRequestNotifyOnCredits(true);
+    } else {
+        my_clock_handler = new Clock::Handler<hr_router>(this, &hr_router::clock_handler);
+        xbar_tc = registerClock(xbar_clock, my_clock_handler);
+    }
     num_routers++;
 
 #if VERIFY_DECLOCKING
@@ -315,6 +353,12 @@ hr_router::hr_router(ComponentId_t cid, Params &params)
 }
 
 void hr_router::notifyEvent() {
+    if (event_driven) {
+        // Arbitrate on the next clock edge
+        scheduleXbar(Simulation::getSimulation()->getCurrentSimCycle() / xbar_tc->getFactor() + 1);
+        return;
+    }
+
     setRequestNotifyOnEvent(false);
 
 #if VERIFY_DECLOCKING
@@ -391,18 +435,98 @@ bool hr_router::clock_handler(Cycle_t cycle) {
 
 #endif
     }
-    // Loop through all the events at the heads of the queues and call
-    // route
-    int index = 0;
+    arbitrateXbar();
+    return false;
+}
+
+void hr_router::scheduleXbar(Cycle_t cycle) {
+    // Already have an event that will arbitrate on or before this
+    // cycle
+    if (xbar_scheduled && next_xbar_cycle <= cycle)
+        return;
+
+    xbar_scheduled = true;
+    next_xbar_cycle = cycle;
+    xbar_timing->send(cycle * xbar_tc->getFactor() - Simulation::getSimulation()->getCurrentSimCycle(), nullptr);
+}
+
+void hr_router::handle_xbar(Event * /*ev*/) {
+    Cycle_t cycle = Simulation::getSimulation()->getCurrentSimCycle() / xbar_tc->getFactor();
+
+    // Superseded by an earlier event
+    if (!xbar_scheduled || cycle != next_xbar_cycle)
+        return;
+    xbar_scheduled = false;
+
+    // Account for the cycles that were skipped since the last
+    // arbitration.  Nothing that could change the outcome happened in
+    // between, so ports that stalled then were stalled the whole time.
+    // If there was data, a clocked router would have arbitrated on
+    // each of those cycles, otherwise its clock would have been
+    // paused.
+    int64_t skipped = cycle - last_xbar_cycle - 1;
+    if (skipped > 0) {
+        if (xbar_had_data)
+            arb->reportStalledCycles(skipped, in_port_busy);
+        else
+            arb->reportSkippedCycles(skipped);
+        for (int i = 0; i < num_ports; i++) {
+            int64_t tmp = in_port_busy[i] - skipped;
+            in_port_busy[i] = tmp < 0 ? 0 : tmp;
+            tmp = out_port_busy[i] - skipped;
+            out_port_busy[i] = tmp < 0 ? 0 : tmp;
+            if (progress_vcs[i] == -2)
+                xbar_stalls[i]->addData(skipped);
+        }
+    }
+    last_xbar_cycle = cycle;
+
+    arbitrateXbar();
+
+    xbar_had_data = get_vcs_with_data() != 0;
+    if (!xbar_had_data) {
+        // Wait for new data unless the arbiter still needs cycles
+        if (!arb->isOkayToPauseClock())
+            scheduleXbar(cycle + 1);
+        return;
+    }
+
+    // Anything still waiting can only move once a busy port frees up
+    // or credits come back.  A port with busy count b is free again
+    // b + 1 cycles from now.  Ports that were granted this cycle count
+    // even if they are already down to zero, since the VC behind the
+    // grant (or another VC on the port) may be able to go next.
+    int min_busy = -1;
     for (int i = 0; i < num_ports; i++) {
-        for (int j = 0; j < num_vcs; j++) {
-            if (vc_heads[index] != nullptr) {
-                topo->reroute(i, j, vc_heads[index]);
-            }
-            index++;
+        if ((in_port_busy[i] > 0 || progress_vcs[i] > -1) && (min_busy == -1 || in_port_busy[i] < min_busy))
+            min_busy = in_port_busy[i];
+        if (out_port_busy[i] > 0 && (min_busy == -1 || out_port_busy[i] < min_busy))
+            min_busy = out_port_busy[i];
+    }
+    if (min_busy != -1)
+        scheduleXbar(cycle + min_busy + 1);
+    else if (!arb->isOkayToPauseClock())
+        scheduleXbar(cycle + 1);
+}
+
+void hr_router::arbitrateXbar() {
+    // Let ports with virtual output queues present a packet that can
+    // move this cycle on each VC
+    if (voq) {
+        for (int i = 0; i < num_ports; i++) {
+            if (active_vcs.getPortCount(i) != 0 && in_port_busy[i] <= 0)
+                ports[i]->selectVOQHeads(ports, out_port_busy);
         }
     }
 
+    // Loop through all the events at the heads of the queues and call
+    // route.  Only the VCs marked in the occupancy map have events.
+    // Source routed packets already have their path.
+    for (int index = active_vcs.next(0); index != -1; index = active_vcs.next(index + 1)) {
+        if (!vc_heads[index]->isSourceRouted())
+            topo->reroute(index / num_vcs, index % num_vcs, vc_heads[index]);
+    }
+
     // All we need to do is arbitrate the crossbar
 #if VERIFY_DECLOCKING
     arb->arbitrate(ports, in_port_busy, out_port_busy, progress_vcs, clocking);
@@ -415,11 +539,18 @@ bool hr_router::clock_handler(Cycle_t cycle) {
         // if ( progress_vcs[i] != -1 ) {
         if (progress_vcs[i] > -1) {
             internal_router_event *ev = ports[i]->recv(progress_vcs[i]);
+            if (ev->getHopDelays() != nullptr)
+                ev->getHopDelays()->enter(HopDelays::OUTPUT_QUEUE);
             ports[ev->getNextPort()]->send(ev, ev->getVC());
             // std::cout << "" << id << ": " << "Moving VC " << progress_vcs[i] <<
             // 	" for port " << i << " to port " << ev->getNextPort() << std::endl;
 
-            if (ev->getTraceType() == SimpleNetwork::Request::FULL) {
+            if (ev->getTraceType() == SimpleNetwork::Request::FULL && trace != nullptr) {
+                // The input port and VC are in the record from when
+                // the packet arrived
+                trace->record(TRACE_XBAR, ev->getTraceID(), id, ev->getNextPort(), ev->getVC(), ev->getSrc(),
+                              ev->getDest());
+            } else if (ev->getTraceType() == SimpleNetwork::Request::FULL) {
                 output.output("TRACE(%d): %" PRIu64 " ns: Copying event (src = %d, dest = %d) "
                               "over crossbar in router %d (%s) from port %d, VC %d to port"
                               " %d, VC %d.\n",
@@ -438,11 +569,10 @@ bool hr_router::clock_handler(Cycle_t cycle) {
         if (out_port_busy[i] != 0)
             out_port_busy[i]--;
     }
-
-    return false;
 }
 
 void hr_router::setup() {
+    topo->setup();
     for (int i = 0; i < num_ports; i++) {
         ports[i]->setup();
     }
@@ -569,7 +699,10 @@ void hr_router::init_vcs() {
     topo->setOutputBufferCreditArray(xbar_in_credits, num_vcs);
     topo->setOutputQueueLengthsArray(output_queue_lengths, num_vcs);
 
+    active_vcs.init(num_ports, num_vcs);
+
     // Now that we have the number of VCs we can finish initializing
     // arbitration logic
     arb->setPorts(num_ports, num_vcs);
+    arb->setActiveVCs(&active_vcs);
 }
@@ -35,6 +35,7 @@ namespace SST {
 namespace Merlin {
 
 class PortControlBase;
+class BinaryTrace;
 
 class hr_router : public Router {
 
@@ -45,7 +46,14 @@ class hr_router : public Router {
     SST_ELI_DOCUMENT_PARAMS(
         {"id", "ID of the router."}, {"num_ports", "Number of ports that the router has"},
         {"topology", "Name of the topology subcomponent that should be loaded to control routing."},
-        {"xbar_arb", "Arbitration unit to be used for crossbar.", "merlin.xbar_arb_lru"},
+        {"xbar_arb",
+         "Arbitration unit to be used for crossbar.  Parameters prefixed with xbar_arb: are passed to it.",
+         "merlin.xbar_arb_lru"},
+        {"xbar_mode",
+         "How the crossbar is scheduled.  clocked runs arbitration every xbar cycle while there is data in the "
+         "router.  event only schedules arbitration for the next cycle at which a busy port frees up, a VC gets new "
+         "data or an output buffer returns credits, so busy and idle cycles are skipped.",
+         "clocked"},
         {"link_bw", "Bandwidth of the links specified in either b/s or B/s (can include SI prefix)."},
         {"flit_size", "Flit size specified in either b or B (can include SI prefix)."},
         {"xbar_bw", "Bandwidth of the crossbar specified in either b/s or B/s (can include SI prefix)."},
@@ -61,6 +69,19 @@ class hr_router : public Router {
         {"oql_track_remote",
          "Set to true to track output queue length including remote input queue.  False tracks only local queue.",
          "false"},
+        {"source_routing",
+         "Compute the full path of each packet when it enters the network so routers along the way don't have to "
+         "route it.  Only used if the topology's routing is deterministic, otherwise packets are routed hop by hop.",
+         "false"},
+        {"input_queueing",
+         "Organization of the port input buffers [fifo (default) | voq].  voq gives each VC a queue per output "
+         "port, so packets aren't stuck behind one waiting on a busy output.",
+         "fifo"},
+        {"trace_file",
+         "Prefix of the binary trace files for packets with tracing turned on.  Each SST thread writes "
+         "<prefix>.<rank>.<thread>.bin, which merlin_trace.py converts to text or Chrome trace JSON.  If empty, "
+         "traced packets are printed as TRACE lines instead.",
+         ""},
         {"num_vns", "Number of VNs.", "2"},
         {"vn_remap", "Array that specifies the vn remapping for each node in the systsm."},
         {"vn_remap_shm", "Name of shared memory region for vn remapping.  If empty, no remapping is done", ""},
@@ -110,6 +131,13 @@ class hr_router : public Router {
     int *out_port_busy;
     int *progress_vcs;
 
+    // Ports split their input buffers into virtual output queues and
+    // pick the head each VC presents before arbitration
+    bool voq;
+
+    // Binary trace for traced packets, or nullptr to print them
+    BinaryTrace *trace;
+
     /* int input_buf_size; */
     /* int output_buf_size; */
     UnitAlgebra input_buf_size;
@@ -120,9 +148,26 @@ class hr_router : public Router {
     TimeConverter *xbar_tc;
     Clock::Handler<hr_router> *my_clock_handler;
 
+    // Event driven crossbar.  Instead of a clock, a self event is
+    // scheduled for the next xbar cycle at which arbitration could
+    // make progress.  Only the earliest pending event is live; any
+    // others are ignored when they arrive.
+    bool event_driven;
+    Link *xbar_timing;
+    bool xbar_scheduled;
+    Cycle_t next_xbar_cycle;
+    Cycle_t last_xbar_cycle;
+    // Whether any VC held data after the last arbitration.  Cycles
+    // skipped with data are cycles a clocked router would have spent
+    // arbitrating.
+    bool xbar_had_data;
+
     std::vector<std::string> inspector_names;
 
     bool clock_handler(Cycle_t cycle);
+    void handle_xbar(Event *ev);
+    void scheduleXbar(Cycle_t cycle);
+    void arbitrateXbar();
     // bool debug_clock_handler(Cycle_t cycle);
     static void sigHandler(int signal);
 
@@ -0,0 +1,278 @@
+// Copyright 2009-2020 NTESS. Under the terms
+// of Contract DE-NA0003525 with NTESS, the U.S.
+// Government retains certain rights in this software.
+//
+// Copyright (c) 2009-2020, NTESS
+// All rights reserved.
+//
+// Portions are copyright of other developers:
+// See the file CONTRIBUTORS.TXT in the top level directory
+// the distribution for more information.
+//
+// This file is part of the SST software package. For license
+// information, see the LICENSE file in the top level directory of the
+// distribution.
+
+#ifndef COMPONENTS_HR_ROUTER_XBAR_ARB_ISLIP_H
+#define COMPONENTS_HR_ROUTER_XBAR_ARB_ISLIP_H
+
+#include <sst/core/component.h>
+#include <sst/core/event.h>
+#include <sst/core/link.h>
+#include <sst/core/timeConverter.h>
+
+#include <cstring>
+
+#include "../router.h"
+
+using namespace SST;
+
+namespace SST {
+namespace Merlin {
+
+// iSLIP allocator (McKeown, "The iSLIP scheduling algorithm for
+// input-queued switches").  Each input port requests every output
+// that one of its VC heads could move to this cycle, using the first
+// such VC after its round robin VC pointer.  Each iteration, every
+// free output grants the first requesting free input at or after its
+// grant pointer, and every input accepts the first granting output at
+// or after its accept pointer.  Pointers only move for matches made
+// in the first iteration, one past the matched port, which is what
+// keeps iSLIP from starving anyone.
+//
+// Requests and grants are kept as bitmasks over ports, both by input
+// (rows) and by output (columns), so each step is a masked find first
+// set rather than a scan over the ports.
+class xbar_arb_islip : public XbarArbitration {
+
+  public:
+    SST_ELI_REGISTER_SUBCOMPONENT_DERIVED(xbar_arb_islip, "merlin", "xbar_arb_islip", SST_ELI_ELEMENT_VERSION(1, 0, 0),
+                                          "iSLIP input/output matching arbitration unit for hr_router",
+                                          SST::Merlin::XbarArbitration)
+
+    SST_ELI_DOCUMENT_PARAMS({"iterations",
+                             "Maximum number of request/grant/accept iterations per cycle.  0 iterates until no "
+                             "more matches are made, which gives a maximal matching.",
+                             "0"})
+
+  private:
+    int num_ports;
+    int num_vcs;
+    int num_words;
+    int max_iterations;
+
+    // Indexed by input * num_words: outputs each input requests
+    uint64_t *req_rows;
+    // Indexed by output * num_words: inputs requesting each output
+    uint64_t *req_cols;
+    // Indexed by input * num_words: outputs that granted each input
+    uint64_t *grant_rows;
+    uint64_t *has_grant;
+    uint64_t *free_in;
+    uint64_t *free_out;
+
+    // VC each input uses for each output, indexed by input * num_ports
+    // + output
+    int *req_vc;
+    int *grant_ptr;
+    int *accept_ptr;
+    int *rr_vcs;
+    // Inputs that received a grant this iteration
+    int *granted;
+
+    internal_router_event **vc_heads;
+
+    static inline void setBit(uint64_t *mask, int bit) { mask[bit >> 6] |= (uint64_t)1 << (bit & 63); }
+    static inline void clearBit(uint64_t *mask, int bit) { mask[bit >> 6] &= ~((uint64_t)1 << (bit & 63)); }
+    static inline bool testBit(const uint64_t *mask, int bit) { return (mask[bit >> 6] >> (bit & 63)) & 1; }
+
+    // Returns the first bit set in both a and b at or after start,
+    // wrapping around, or -1 if there is none
+    inline int findFrom(const uint64_t *a, const uint64_t *b, int start) const {
+        int word = start >> 6;
+        uint64_t val = a[word] & b[word] & (~(uint64_t)0 << (start & 63));
+        for (int i = 0; i < num_words; i++) {
+            if (val != 0)
+                return (word << 6) + __builtin_ctzll(val);
+            word = (word + 1 == num_words) ? 0 : word + 1;
+            val = a[word] & b[word];
+        }
+        // Back at the start word, pick up the bits before start
+        return val != 0 ? (word << 6) + __builtin_ctzll(val) : -1;
+    }
+
+  public:
+    xbar_arb_islip(ComponentId_t cid, Params &params)
+        : XbarArbitration(cid), req_rows(nullptr), req_cols(nullptr), grant_rows(nullptr), has_grant(nullptr),
+          free_in(nullptr), free_out(nullptr), req_vc(nullptr), grant_ptr(nullptr), accept_ptr(nullptr),
+          rr_vcs(nullptr), granted(nullptr) {
+        max_iterations = params.find<int>("iterations", 0);
+    }
+
+    ~xbar_arb_islip() override {
+        delete[] req_rows;
+        delete[] req_cols;
+        delete[] grant_rows;
+        delete[] has_grant;
+        delete[] free_in;
+        delete[] free_out;
+        delete[] req_vc;
+        delete[] grant_ptr;
+        delete[] accept_ptr;
+        delete[] rr_vcs;
+        delete[] granted;
+    }
+
+    void setPorts(int num_ports_s, int num_vcs_s) override {
+        num_ports = num_ports_s;
+        num_vcs = num_vcs_s;
+        num_words = (num_ports + 63) / 64;
+        if (max_iterations <= 0 || max_iterations > num_ports)
+            max_iterations = num_ports;
+
+        req_rows = new uint64_t[num_ports * num_words];
+        req_cols = new uint64_t[num_ports * num_words];
+        grant_rows = new uint64_t[num_ports * num_words];
+        has_grant = new uint64_t[num_words];
+        free_in = new uint64_t[num_words];
+        free_out = new uint64_t[num_words];
+        memset(req_rows, 0, num_ports * num_words * sizeof(uint64_t));
+        memset(req_cols, 0, num_ports * num_words * sizeof(uint64_t));
+        memset(grant_rows, 0, num_ports * num_words * sizeof(uint64_t));
+        memset(has_grant, 0, num_words * sizeof(uint64_t));
+
+        req_vc = new int[num_ports * num_ports];
+        grant_ptr = new int[num_ports];
+        accept_ptr = new int[num_ports];
+        rr_vcs = new int[num_ports];
+        granted = new int[num_ports];
+        for (int i = 0; i < num_ports; i++) {
+            grant_ptr[i] = 0;
+            accept_ptr[i] = 0;
+            rr_vcs[i] = 0;
+        }
+    }
+
+    // Naming convention is from point of view of the xbar.  So,
+    // in_port_busy is >0 if someone is writing to that xbar port and
+    // out_port_busy is >0 if that xbar port being read.
+    void arbitrate(
+#if VERIFY_DECLOCKING
+        PortInterface **ports, int *in_port_busy, int *out_port_busy, int *progress_vc, bool clocking
+#else
+        PortInterface **ports, int *in_port_busy, int *out_port_busy, int *progress_vc
+#endif
+        ) override {
+
+        memset(free_in, 0, num_words * sizeof(uint64_t));
+        memset(free_out, 0, num_words * sizeof(uint64_t));
+
+        // Build the requests.  An input only requests outputs it
+        // could actually send to this cycle.
+        bool have_requests = false;
+        for (int port = 0; port < num_ports; port++) {
+            progress_vc[port] = -1;
+            if (out_port_busy[port] <= 0)
+                setBit(free_out, port);
+            if (in_port_busy[port] > 0 || active_vcs->getPortCount(port) == 0)
+                continue;
+
+            vc_heads = ports[port]->getVCHeads();
+            uint64_t *row = &req_rows[port * num_words];
+            for (int vc = rr_vcs[port], vcount = 0; vcount < num_vcs;
+                 vc = ((vc != num_vcs - 1) ? (vc + 1) : 0), vcount++) {
+                internal_router_event *src_event = vc_heads[vc];
+                if (src_event == nullptr)
+                    continue;
+                progress_vc[port] = -2;
+                int next_port = src_event->getNextPort();
+                if (testBit(row, next_port))
+                    continue;
+                if (out_port_busy[next_port] > 0 ||
+                    !ports[next_port]->spaceToSend(src_event->getVC(), src_event->getFlitCount()))
+                    continue;
+                setBit(row, next_port);
+                setBit(&req_cols[next_port * num_words], port);
+                setBit(free_in, port);
+                req_vc[port * num_ports + next_port] = vc;
+                have_requests = true;
+            }
+        }
+
+        for (int iter = 0; have_requests && iter < max_iterations; iter++) {
+            // Grant
+            int num_granted = 0;
+            for (int w = 0; w < num_words; w++) {
+                uint64_t outs = free_out[w];
+                while (outs != 0) {
+                    int out = (w << 6) + __builtin_ctzll(outs);
+                    outs &= outs - 1;
+                    int in = findFrom(&req_cols[out * num_words], free_in, grant_ptr[out]);
+                    if (in == -1)
+                        continue;
+                    if (!testBit(has_grant, in)) {
+                        setBit(has_grant, in);
+                        granted[num_granted++] = in;
+                    }
+                    setBit(&grant_rows[in * num_words], out);
+                }
+            }
+            if (num_granted == 0)
+                break;
+
+            // Accept
+            for (int g = 0; g < num_granted; g++) {
+                int in = granted[g];
+                uint64_t *grow = &grant_rows[in * num_words];
+                int out = findFrom(grow, grow, accept_ptr[in]);
+                memset(grow, 0, num_words * sizeof(uint64_t));
+                clearBit(has_grant, in);
+
+                clearBit(free_in, in);
+                clearBit(free_out, out);
+                if (iter == 0) {
+                    grant_ptr[out] = (in + 1) % num_ports;
+                    accept_ptr[in] = (out + 1) % num_ports;
+                }
+
+                int vc = req_vc[in * num_ports + out];
+                int flits = ports[in]->getVCHeads()[vc]->getFlitCount();
+                progress_vc[in] = vc;
+                in_port_busy[in] = flits;
+                out_port_busy[out] = flits;
+                rr_vcs[in] = (vc + 1) % num_vcs;
+            }
+        }
+
+        // Clear the requests for next time.  Only inputs that were
+        // free to request have anything set.
+        for (int port = 0; port < num_ports; port++) {
+            if (progress_vc[port] == -1)
+                continue;
+            uint64_t *row = &req_rows[port * num_words];
+            for (int w = 0; w < num_words; w++) {
+                uint64_t outs = row[w];
+                while (outs != 0) {
+                    int out = (w << 6) + __builtin_ctzll(outs);
+                    outs &= outs - 1;
+                    clearBit(&req_cols[out * num_words], port);
+                }
+                row[w] = 0;
+            }
+        }
+    }
+
+    void reportSkippedCycles(Cycle_t cycles) override {}
+
+    void dumpState(std::ostream &stream) override {
+        stream << "  Grant, accept pointer and round robin VC by port:" << std::endl;
+        for (int i = 0; i < num_ports; i++) {
+            stream << i << ": " << grant_ptr[i] << ", " << accept_ptr[i] << ", " << rr_vcs[i] << std::endl;
+        }
+    }
+};
+
+} // namespace Merlin
+} // namespace SST
+
+#endif // COMPONENTS_HR_ROUTER_XBAR_ARB_ISLIP_H
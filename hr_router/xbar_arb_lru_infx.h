@@ -21,6 +21,7 @@
 #include <sst/core/link.h>
 #include <sst/core/timeConverter.h>
 
+#include <algorithm>
 #include <vector>
 
 #include "../router.h"
@@ -98,7 +99,12 @@ class xbar_arb_lru_infx : public XbarArbitration {
         priority_entry_t *sat_list = &next_list[total_entries - 1];
         priority_entry_t *unsat_list = next_list;
 
-        for (int i = 0; i < total_entries; i++) {
+        // Only entries with data need to be looked at.  Once all of
+        // them have been seen, the rest of the list keeps its order
+        // and is copied over as is.
+        int remaining = active_vcs->getCount();
+        int i = 0;
+        for (; i < total_entries && remaining > 0; i++) {
 
             const priority_entry_t &check = cur_list[i];
 
@@ -109,6 +115,13 @@ class xbar_arb_lru_infx : public XbarArbitration {
 
             // std::cout << check.first << ", " << check.second << std::endl;
 
+            if (!active_vcs->test(port, vc)) {
+                *unsat_list = check;
+                ++unsat_list;
+                continue;
+            }
+            --remaining;
+
             vc_heads = ports[port]->getVCHeads();
 
             internal_router_event *src_event = vc_heads[vc];
@@ -149,6 +162,12 @@ class xbar_arb_lru_infx : public XbarArbitration {
             // trace.getOutput().output("Got to here 4\n");
         }
 
+        // Everything left is empty and stays in the unsatisfied
+        // section in the same order
+        if (i < total_entries) {
+            std::copy(&cur_list[i], &cur_list[total_entries], unsat_list);
+        }
+
         // std::cout << "+++++++++" << std::endl;
         // for ( int i = 0; i < total_entries; i++ ) {
         //     std::cout << priority[next_list][i].first << ", " << priority[cur_list][i].second << std::endl;
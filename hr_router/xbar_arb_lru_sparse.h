@@ -0,0 +1,237 @@
+// Copyright 2009-2020 NTESS. Under the terms
+// of Contract DE-NA0003525 with NTESS, the U.S.
+// Government retains certain rights in this software.
+//
+// Copyright (c) 2009-2020, NTESS
+// All rights reserved.
+//
+// Portions are copyright of other developers:
+// See the file CONTRIBUTORS.TXT in the top level directory
+// the distribution for more information.
+//
+// This file is part of the SST software package. For license
+// information, see the LICENSE file in the top level directory of the
+// distribution.
+
+#ifndef COMPONENTS_HR_ROUTER_XBAR_ARB_LRU_SPARSE_H
+#define COMPONENTS_HR_ROUTER_XBAR_ARB_LRU_SPARSE_H
+
+#include <sst/core/component.h>
+#include <sst/core/event.h>
+#include <sst/core/link.h>
+#include <sst/core/timeConverter.h>
+
+#include "../router.h"
+
+namespace SST {
+namespace Merlin {
+
+// Same grants as xbar_arb_lru, but only entries whose VC holds data
+// are looked at.  Instead of rewriting the full priority list every
+// cycle, each entry carries a stamp giving its position in the LRU
+// order, and only the active entries are kept in an intrusive list
+// sorted by stamp.  Granted entries get new stamps and move to the
+// tail.  Entries that go idle keep their stamp, so when they become
+// active again they are linked back in at the same place they would
+// have held in xbar_arb_lru's list.
+class xbar_arb_lru_sparse : public XbarArbitration {
+
+  public:
+    SST_ELI_REGISTER_SUBCOMPONENT_DERIVED(
+        xbar_arb_lru_sparse, "merlin", "xbar_arb_lru_sparse", SST_ELI_ELEMENT_VERSION(1, 0, 0),
+        "Least recently used arbitration unit for hr_router that only examines VCs holding data.  Grants are "
+        "identical to merlin.xbar_arb_lru.",
+        SST::Merlin::XbarArbitration)
+
+  private:
+    struct lru_entry_t {
+        uint64_t stamp;
+        int prev;
+        int next;
+        bool linked;
+    };
+
+    int num_ports;
+    int num_vcs;
+    int total_entries;
+
+    // Indexed by port * num_vcs + vc
+    lru_entry_t *entries;
+    int head;
+    int tail;
+    uint64_t next_stamp;
+
+    // Entries granted this cycle, in grant order.  Each input port can
+    // only be granted once per cycle, so num_ports is enough.
+    int *granted;
+
+    internal_router_event **vc_heads;
+
+  public:
+    xbar_arb_lru_sparse(ComponentId_t cid, Params & /*param*/)
+        : XbarArbitration(cid), entries(nullptr), head(-1), tail(-1), next_stamp(0), granted(nullptr) {}
+
+    ~xbar_arb_lru_sparse() override {
+        delete[] entries;
+        delete[] granted;
+    }
+
+    void setPorts(int num_ports_s, int num_vcs_s) override {
+        num_ports = num_ports_s;
+        num_vcs = num_vcs_s;
+
+        total_entries = num_ports * num_vcs;
+
+        // Initial order is the same as xbar_arb_lru: by port, then VC
+        entries = new lru_entry_t[total_entries];
+        for (int i = 0; i < total_entries; i++) {
+            entries[i].stamp = i;
+            entries[i].prev = -1;
+            entries[i].next = -1;
+            entries[i].linked = false;
+        }
+        next_stamp = total_entries;
+        head = -1;
+        tail = -1;
+
+        granted = new int[num_ports];
+    }
+
+    // Naming convention is from point of view of the xbar.  So,
+    // in_port_busy is >0 if someone is writing to that xbar port and
+    // out_port_busy is >0 if that xbar port being read.
+    void arbitrate(
+#if VERIFY_DECLOCKING
+        PortInterface **ports, int *in_port_busy, int *out_port_busy, int *progress_vc, bool clocking
+#else
+        PortInterface **ports, int *in_port_busy, int *out_port_busy, int *progress_vc
+#endif
+        ) override {
+
+        for (int i = 0; i < num_ports; i++)
+            progress_vc[i] = -1;
+
+        // Link in any VCs that got data since the last cycle
+        for (int index = active_vcs->next(0); index != -1; index = active_vcs->next(index + 1)) {
+            if (!entries[index].linked)
+                insert(index);
+        }
+
+        int num_granted = 0;
+        int index = head;
+        while (index != -1) {
+            int next = entries[index].next;
+            int port = index / num_vcs;
+            int vc = index % num_vcs;
+
+            // VC has emptied since it was linked in
+            if (!active_vcs->test(port, vc)) {
+                unlink(index);
+                index = next;
+                continue;
+            }
+
+            vc_heads = ports[port]->getVCHeads();
+
+            // if the output of this port is busy or if there is no
+            // event to be processed, nothing to do.
+            internal_router_event *src_event = vc_heads[vc];
+            if (in_port_busy[port] <= 0 && src_event != nullptr) {
+                // Have an event, see if it can be progressed
+                int next_port = src_event->getNextPort();
+                int next_vc = src_event->getVC();
+
+                // We can progress if the next port's input is not
+                // busy and there are enough credits.
+                if (out_port_busy[next_port] <= 0 &&
+                    ports[next_port]->spaceToSend(next_vc, src_event->getFlitCount())) {
+
+                    // Tell the router what to move
+                    progress_vc[port] = vc;
+
+                    // Need to set the busy values
+                    in_port_busy[port] = src_event->getFlitCount();
+                    out_port_busy[next_port] = src_event->getFlitCount();
+
+                    granted[num_granted++] = index;
+                } else {
+                    progress_vc[port] = -2;
+                }
+            }
+            index = next;
+        }
+
+        // xbar_arb_lru fills the satisfied section from the bottom of
+        // the list up, so the first grant of the cycle ends up last.
+        // Move grants to the tail in reverse order to match.
+        for (int i = num_granted - 1; i >= 0; i--) {
+            int entry = granted[i];
+            unlink(entry);
+            entries[entry].stamp = next_stamp++;
+            append(entry);
+        }
+    }
+
+    void reportSkippedCycles(Cycle_t cycles) override {}
+
+    void dumpState(std::ostream &stream) override {
+        stream << "  Active entries in LRU order:" << std::endl;
+        for (int index = head; index != -1; index = entries[index].next) {
+            stream << "    " << index / num_vcs << ", " << index % num_vcs << std::endl;
+        }
+    }
+
+  private:
+    // Links index in after the last entry with a smaller stamp
+    void insert(int index) {
+        uint64_t stamp = entries[index].stamp;
+        int after = tail;
+        while (after != -1 && entries[after].stamp > stamp)
+            after = entries[after].prev;
+
+        entries[index].linked = true;
+        entries[index].prev = after;
+        if (after == -1) {
+            entries[index].next = head;
+            head = index;
+        } else {
+            entries[index].next = entries[after].next;
+            entries[after].next = index;
+        }
+        if (entries[index].next == -1)
+            tail = index;
+        else
+            entries[entries[index].next].prev = index;
+    }
+
+    void append(int index) {
+        entries[index].linked = true;
+        entries[index].prev = tail;
+        entries[index].next = -1;
+        if (tail == -1)
+            head = index;
+        else
+            entries[tail].next = index;
+        tail = index;
+    }
+
+    void unlink(int index) {
+        lru_entry_t &entry = entries[index];
+        if (entry.prev == -1)
+            head = entry.next;
+        else
+            entries[entry.prev].next = entry.next;
+        if (entry.next == -1)
+            tail = entry.prev;
+        else
+            entries[entry.next].prev = entry.prev;
+        entry.linked = false;
+        entry.prev = -1;
+        entry.next = -1;
+    }
+};
+
+} // namespace Merlin
+} // namespace SST
+
+#endif // COMPONENTS_HR_ROUTER_XBAR_ARB_LRU_SPARSE_H
@@ -22,10 +22,10 @@
 #include <sst/core/timeConverter.h>
 #include <sst/core/rng/xorshift.h>
 
-#include <vector>
-#include <queue>
+#include <functional>
 
 #include "../router.h"
+#include "xbar_arb_sorted.h"
 
 namespace SST {
 namespace Merlin {
@@ -36,59 +36,19 @@ class xbar_arb_rand : public XbarArbitration {
     SST_ELI_REGISTER_SUBCOMPONENT_DERIVED(xbar_arb_rand, "merlin", "xbar_arb_rand", SST_ELI_ELEMENT_VERSION(1, 0, 0),
                                           "Random arbitration unit for hr_router", SST::Merlin::XbarArbitration)
 
-  private:
-    /**
-       Structure for sorting based on random priority
-     */
-    struct priority_entry_t {
-        uint16_t port{0};
-        uint16_t vc{0};
-        uint16_t next_port{0};
-        uint16_t next_vc{0};
-        double rand_pri{0.0};
-        int size_in_flits{0};
-
-        // priority_entry_t(uint16_t port, uint16_t vc, SimTime_t injection_time) :
-        //     port(port),
-        //     vc(vc),
-        //     injection_time(injection_time)
-        // {}
-
-        priority_entry_t()
-
-            = default;
-
-        priority_entry_t(uint16_t port, uint16_t vc)
-            : port(port), vc(vc)
-
-        {}
-    };
-
-    /** To use with STL priority queues, that order in reverse. */
-    class rand_priority {
-      public:
-        /** Compare based off pointers */
-        inline bool operator()(const priority_entry_t *lhs, const priority_entry_t *rhs) const {
-            return lhs->rand_pri > rhs->rand_pri;
-        }
-
-        /** Compare based off references */
-        inline bool operator()(const priority_entry_t &lhs, const priority_entry_t &rhs) {
-            return lhs.rand_pri > rhs.rand_pri;
-        }
-    };
+    SST_ELI_DOCUMENT_PARAMS({"sort_requests",
+                             "Bucket sort the requests instead of granting them from a heap.  The grants are the "
+                             "same either way, false is only useful to check that.",
+                             "true"})
 
-    typedef std::priority_queue<priority_entry_t *, std::vector<priority_entry_t *>, xbar_arb_rand::rand_priority>
-        rand_queue_t;
-    rand_queue_t rand_queue;
-
-    priority_entry_t *entries;
+  private:
+    // Lowest random priority first
+    SortedRequests<double, std::greater<double>> requests;
+    bool sort_requests;
 
     int num_ports;
     int num_vcs;
 
-    int total_entries;
-
     internal_router_event **vc_heads;
 
     RNG::XORShiftRNG *rng;
@@ -96,23 +56,18 @@ class xbar_arb_rand : public XbarArbitration {
     // PortControl** ports;
 
   public:
-    xbar_arb_rand(ComponentId_t cid, Params & /*params*/) : XbarArbitration(cid) { rng = new RNG::XORShiftRNG(69); }
+    xbar_arb_rand(ComponentId_t cid, Params &params) : XbarArbitration(cid) {
+        sort_requests = params.find<bool>("sort_requests", true);
+        rng = new RNG::XORShiftRNG(69);
+    }
 
-    ~xbar_arb_rand() override { delete[] entries; }
+    ~xbar_arb_rand() override { delete rng; }
 
     void setPorts(int num_ports_s, int num_vcs_s) override {
         num_ports = num_ports_s;
         num_vcs = num_vcs_s;
 
-        total_entries = num_ports * num_vcs;
-        entries = new priority_entry_t[total_entries];
-
-        int index = 0;
-        for (int i = 0; i < num_ports; i++) {
-            for (int j = 0; j < num_vcs; j++) {
-                entries[index++] = priority_entry_t(i, j);
-            }
-        }
+        requests.init(num_ports, num_vcs, sort_requests);
 
         vc_heads = new internal_router_event *[num_vcs];
     }
@@ -132,74 +87,47 @@ class xbar_arb_rand : public XbarArbitration {
             progress_vc[i] = -1;
 
         // Find all ports that have data and who's inputs to the xbar
-        // aren't busy.  Sort them by prioritizing on injection time.
-        // Oldest gets top priority.
-        int index = 0;
-        for (int i = 0; i < num_ports; i++) {
-            if (in_port_busy[i] > 0) {
-                index += num_vcs;
-                continue; // No need to consider port if input to xbar is busy
-            }
-
-            vc_heads = ports[i]->getVCHeads();
-            for (int j = 0; j < num_vcs; j++) {
-                internal_router_event *src_event = vc_heads[j];
-                if (src_event != nullptr) {
-                    entries[index].next_port = vc_heads[j]->getNextPort();
-                    entries[index].next_vc = vc_heads[j]->getVC();
-                    entries[index].size_in_flits = vc_heads[j]->getFlitCount();
-                    entries[index].rand_pri = rng->nextUniform();
-
-                    rand_queue.push(&entries[index]);
-                }
-                index++;
+        // aren't busy.  Only the VCs marked in the occupancy map have
+        // data, so those are the only ones visited.  Every port found
+        // here ends the cycle either granted or at -2.
+        requests.clear();
+        int index = active_vcs->next(0);
+        while (index != -1) {
+            int port = index / num_vcs;
+            if (in_port_busy[port] > 0) {
+                // No need to consider port if input to xbar is busy
+                index = active_vcs->next((port + 1) * num_vcs);
+                continue;
             }
-        }
-
-        while (!rand_queue.empty()) {
-
-            priority_entry_t *entry = rand_queue.top();
-            rand_queue.pop();
-
-            int port = entry->port;
-            int vc = entry->vc;
-
-            // if the input to the xbar for this port is busy, nothing
-            // to do.  This will only happen at this point if a higher
-            // priority VC from this port was satisfied this cycle.
-            if (in_port_busy[port] <= 0) {
-                // Have an event, see if it can be progressed
-                int next_port = entry->next_port;
-                int next_vc = entry->next_vc;
-
-                // We can progress if the next port's output from xbar
-                // is not busy and there are enough credits.
-                if (out_port_busy[next_port] <= 0 && ports[next_port]->spaceToSend(next_vc, entry->size_in_flits)) {
 
-                    // Tell the router what to move
-                    progress_vc[port] = vc;
+            progress_vc[port] = -2;
 
-                    // Need to set the busy values
-                    in_port_busy[port] = entry->size_in_flits;
-                    out_port_busy[next_port] = entry->size_in_flits;
-
-                } else {
-                    progress_vc[port] = -2;
-                }
-            }
+            vc_heads = ports[port]->getVCHeads();
+            internal_router_event *src_event = vc_heads[index - port * num_vcs];
+            requests.add(index, src_event, rng->nextUniform());
+            index = active_vcs->next(index + 1);
         }
 
-        // std::cout << "+++++++++" << std::endl;
-        // for ( int i = 0; i < total_entries; i++ ) {
-        //     std::cout << priority[next_list][i].first << ", " << priority[cur_list][i].second << std::endl;
-        // }
-        // std::cout << "+++++++++" << std::endl;
-
-        return;
+        // Requests are granted lowest random priority first
+        requests.grant(ports, in_port_busy, out_port_busy, progress_vc);
     }
 
     void reportSkippedCycles(Cycle_t cycles) override {}
 
+    void reportStalledCycles(Cycle_t cycles, int const *in_port_busy) override {
+        // A clocked arbitrate() draws a priority for every VC with data
+        // on an input that isn't busy.  Input i is busy for the first
+        // in_port_busy[i] of the skipped cycles.  Making the same draws
+        // keeps later priorities the same.
+        uint64_t draws = 0;
+        for (int i = 0; i < num_ports; i++) {
+            if ((Cycle_t)in_port_busy[i] < cycles)
+                draws += (cycles - in_port_busy[i]) * active_vcs->getPortCount(i);
+        }
+        for (uint64_t i = 0; i < draws; i++)
+            rng->nextUniform();
+    }
+
     void dumpState(std::ostream &stream) override {
         /* stream << "Current round robin port: " << rr_port << std::endl; */
         /* stream << "  Current round robin VC by port:" << std::endl; */
@@ -90,8 +90,6 @@ class xbar_arb_rr : public XbarArbitration {
         for (int port = rr_port, pcount = 0; pcount < num_ports;
              port = ((port != num_ports - 1) ? port + 1 : 0), pcount++) {
 
-            vc_heads = ports[port]->getVCHeads();
-
             // Overwrite old data
             progress_vc[port] = -1;
             // if the output of this port is busy, nothing to do.
@@ -99,6 +97,15 @@ class xbar_arb_rr : public XbarArbitration {
                 continue;
             }
 
+            // No VCs with data on this port, so only the round robin
+            // state needs to move
+            if (active_vcs->getPortCount(port) == 0) {
+                rr_vcs[port] = (rr_vcs[port] + 1) % num_vcs;
+                continue;
+            }
+
+            vc_heads = ports[port]->getVCHeads();
+
             // See what we should progress for this port
             // for ( int vc = rr_vcs[port], vcount = 0; vcount < num_vcs; vc = (vc+1) % num_vcs, vcount++ ) {
             for (int vc = rr_vcs[port], vcount = 0; vcount < num_vcs;
@@ -157,6 +164,19 @@ class xbar_arb_rr : public XbarArbitration {
 #endif
     }
 
+    void reportStalledCycles(Cycle_t cycles, int const *in_port_busy) override {
+        // A clocked arbitrate() moves rr_vcs on every input that isn't
+        // busy.  Input i is busy for the first in_port_busy[i] of the
+        // skipped cycles and free for the rest.
+        for (int i = 0; i < num_ports; i++) {
+            if ((Cycle_t)in_port_busy[i] >= cycles)
+                continue;
+            int free_cycles = (cycles - in_port_busy[i]) % num_vcs;
+            rr_vcs[i] = (rr_vcs[i] + free_cycles) % num_vcs;
+        }
+        reportSkippedCycles(cycles);
+    }
+
     void dumpState(std::ostream &stream) override {
         stream << "Current round robin port: " << rr_port << std::endl;
         stream << "  Current round robin VC by port:" << std::endl;
@@ -0,0 +1,290 @@
+// Copyright 2009-2020 NTESS. Under the terms
+// of Contract DE-NA0003525 with NTESS, the U.S.
+// Government retains certain rights in this software.
+//
+// Copyright (c) 2009-2020, NTESS
+// All rights reserved.
+//
+// Portions are copyright of other developers:
+// See the file CONTRIBUTORS.TXT in the top level directory
+// the distribution for more information.
+//
+// This file is part of the SST software package. For license
+// information, see the LICENSE file in the top level directory of the
+// distribution.
+
+#ifndef COMPONENTS_HR_ROUTER_XBAR_ARB_SORTED_H
+#define COMPONENTS_HR_ROUTER_XBAR_ARB_SORTED_H
+
+#include <algorithm>
+
+#include "../router.h"
+
+namespace SST {
+namespace Merlin {
+
+// Grants crossbar requests in priority order for the arbiters that
+// used to be built on a std::priority_queue (age and rand).  Compare
+// has the priority_queue meaning: compare(a, b) is true if a goes
+// after b.
+//
+// Popping requests one at a time from a heap costs a hard to predict
+// branch at every level.  A bucket sort puts them in the same order
+// for much less.  Requests with equal keys come off the heap in an
+// order that depends on how it was built.  That only changes the
+// grants if two of them could both go and share an input or an
+// output, so only then are the grants made from a heap built exactly
+// as the priority_queue built it.  Ties like that tend to last for a
+// while, so once the heap has been needed the next few cycles go
+// straight to it instead of sorting first.
+template <typename Key, typename Compare> class SortedRequests {
+  public:
+    SortedRequests()
+        : requests(nullptr), sorted(nullptr), num_requests(0), request_bucket(nullptr), bucket_start(nullptr),
+          entries(nullptr), input_stamp(nullptr), output_stamp(nullptr), stamp(0), heap_cycles(0),
+          sort_requests(true) {}
+
+    ~SortedRequests() {
+        delete[] entries;
+        delete[] requests;
+        delete[] sorted;
+        delete[] request_bucket;
+        delete[] bucket_start;
+        delete[] input_stamp;
+        delete[] output_stamp;
+    }
+
+    // All the arrays are allocated once here.  With sort_s false
+    // every cycle is granted from the heap, which is only useful to
+    // check that sorting doesn't change anything.
+    void init(int num_ports, int num_vcs, bool sort_s) {
+        int total_entries = num_ports * num_vcs;
+        entries = new entry_t[total_entries];
+        requests = new request_t[total_entries];
+        sorted = new request_t[total_entries];
+        request_bucket = new int[total_entries];
+        bucket_start = new int[total_entries + 1];
+        input_stamp = new uint64_t[num_ports]();
+        output_stamp = new uint64_t[num_ports]();
+        sort_requests = sort_s;
+
+        int index = 0;
+        for (int i = 0; i < num_ports; i++) {
+            for (int j = 0; j < num_vcs; j++) {
+                entries[index].port = i;
+                entries[index].vc = j;
+                index++;
+            }
+        }
+        num_requests = 0;
+    }
+
+    inline void clear() { num_requests = 0; }
+
+    // Adds the head of VC index (port * num_vcs + vc)
+    inline void add(int index, internal_router_event *ev, Key key) {
+        entry_t &entry = entries[index];
+        entry.next_port = ev->getNextPort();
+        entry.next_vc = ev->getVC();
+        entry.size_in_flits = ev->getFlitCount();
+
+        requests[num_requests].key = key;
+        requests[num_requests].index = index;
+        num_requests++;
+    }
+
+    void grant(PortInterface **ports, int *in_port_busy, int *out_port_busy, int *progress_vc) {
+        if (num_requests == 0)
+            return;
+
+        if (!sort_requests || heap_cycles > 0) {
+            if (heap_cycles > 0)
+                heap_cycles--;
+            grantFromHeap(ports, in_port_busy, out_port_busy, progress_vc);
+            return;
+        }
+        if (!sortRequests() || equalKeysConflict(ports, out_port_busy)) {
+            heap_cycles = heap_backoff;
+            grantFromHeap(ports, in_port_busy, out_port_busy, progress_vc);
+            return;
+        }
+
+        for (int i = 0; i < num_requests; i++)
+            tryGrant(sorted[i].index, ports, in_port_busy, out_port_busy, progress_vc);
+    }
+
+  private:
+    struct entry_t {
+        uint16_t port{0};
+        uint16_t vc{0};
+        uint16_t next_port{0};
+        uint16_t next_vc{0};
+        int size_in_flits{0};
+    };
+
+    // The key is kept next to the entry index so ordering never has to
+    // go through entries
+    struct request_t {
+        Key key;
+        int index;
+    };
+
+    struct request_compare {
+        inline bool operator()(const request_t &lhs, const request_t &rhs) const { return Compare()(lhs.key, rhs.key); }
+    };
+
+    // Requests for the current cycle in the order they were found, and
+    // the same requests in grant order
+    request_t *requests;
+    request_t *sorted;
+    int num_requests;
+
+    // Bucket of each request and the start of each bucket in sorted
+    int *request_bucket;
+    int *bucket_start;
+
+    entry_t *entries;
+
+    // Stamps that mark inputs and outputs already requested within a
+    // group of equal keys
+    uint64_t *input_stamp;
+    uint64_t *output_stamp;
+    uint64_t stamp;
+
+    // Cycles left that use the heap without trying to sort first
+    int heap_cycles;
+    static const int heap_backoff = 16;
+
+    // Insertion sort moves allowed per request before sortRequests()
+    // gives up on it
+    static const int max_shifts_per_request = 4;
+
+    bool sort_requests;
+
+    // Bucket sorts requests into sorted.  Keys are spread over buckets
+    // between the lowest and the highest, so each bucket is expected
+    // to hold about one request and the insertion sort that finishes
+    // the job only has a few short runs to fix.  A few keys far from
+    // the rest, such as one very old packet, crowd everything else
+    // into one bucket and make the insertion sort quadratic, so it
+    // hands over to std::sort once it has moved too many requests.
+    // Returns false if the requests all have the same key, in which
+    // case sorted is not filled in.
+    bool sortRequests() {
+        request_compare after;
+        int first = 0;
+        int last = 0;
+        for (int i = 1; i < num_requests; i++) {
+            if (after(requests[first], requests[i]))
+                first = i;
+            if (after(requests[i], requests[last]))
+                last = i;
+        }
+        if (!after(requests[last], requests[first]))
+            return false;
+
+        double low = (double)requests[first].key;
+        double high = (double)requests[last].key;
+        // Works whichever way Compare orders the keys
+        double scale = (double)num_requests / (high - low);
+        for (int i = 0; i < num_requests; i++) {
+            int bucket = (int)(((double)requests[i].key - low) * scale);
+            request_bucket[i] = std::min(bucket, num_requests - 1);
+        }
+
+        std::fill(bucket_start, bucket_start + num_requests + 1, 0);
+        for (int i = 0; i < num_requests; i++)
+            bucket_start[request_bucket[i] + 1]++;
+        for (int i = 1; i <= num_requests; i++)
+            bucket_start[i] += bucket_start[i - 1];
+        for (int i = 0; i < num_requests; i++)
+            sorted[bucket_start[request_bucket[i]]++] = requests[i];
+
+        int shifts = 0;
+        for (int i = 1; i < num_requests; i++) {
+            request_t request = sorted[i];
+            int j = i;
+            for (; j > 0 && after(sorted[j - 1], request); j--)
+                sorted[j] = sorted[j - 1];
+            sorted[j] = request;
+            shifts += i - j;
+            if (shifts > max_shifts_per_request * num_requests) {
+                std::sort(sorted, sorted + num_requests,
+                          [&after](const request_t &lhs, const request_t &rhs) { return after(rhs, lhs); });
+                break;
+            }
+        }
+        return true;
+    }
+
+    // Returns true if two requests with equal keys that could both be
+    // granted, going by the state at the start of the cycle, share an
+    // input or an output.  A request whose output is busy or out of
+    // credits can never be granted this cycle, so where it sits in the
+    // order doesn't matter.
+    bool equalKeysConflict(PortInterface **ports, int *out_port_busy) {
+        request_compare after;
+        int first = 0;
+        while (first < num_requests) {
+            int last = first + 1;
+            while (last < num_requests && !after(sorted[last], sorted[first]))
+                last++;
+            if (last - first > 1) {
+                stamp++;
+                for (int i = first; i < last; i++) {
+                    entry_t &entry = entries[sorted[i].index];
+                    if (out_port_busy[entry.next_port] > 0 ||
+                        !ports[entry.next_port]->spaceToSend(entry.next_vc, entry.size_in_flits))
+                        continue;
+                    if (input_stamp[entry.port] == stamp || output_stamp[entry.next_port] == stamp)
+                        return true;
+                    input_stamp[entry.port] = stamp;
+                    output_stamp[entry.next_port] = stamp;
+                }
+            }
+            first = last;
+        }
+        return false;
+    }
+
+    // Pops every request from a heap built the same way
+    // std::priority_queue built it
+    void grantFromHeap(PortInterface **ports, int *in_port_busy, int *out_port_busy, int *progress_vc) {
+        for (int i = 2; i <= num_requests; i++)
+            std::push_heap(requests, requests + i, request_compare());
+
+        for (int heap_size = num_requests; heap_size > 0; heap_size--) {
+            std::pop_heap(requests, requests + heap_size, request_compare());
+            tryGrant(requests[heap_size - 1].index, ports, in_port_busy, out_port_busy, progress_vc);
+        }
+    }
+
+    inline void tryGrant(int index, PortInterface **ports, int *in_port_busy, int *out_port_busy, int *progress_vc) {
+        entry_t &entry = entries[index];
+        int port = entry.port;
+
+        // if the input to the xbar for this port is busy, nothing
+        // to do.  This will only happen at this point if a higher
+        // priority VC from this port was satisfied this cycle.
+        if (in_port_busy[port] > 0)
+            return;
+
+        // We can progress if the next port's output from xbar
+        // is not busy and there are enough credits.
+        int next_port = entry.next_port;
+        if (out_port_busy[next_port] <= 0 && ports[next_port]->spaceToSend(entry.next_vc, entry.size_in_flits)) {
+
+            // Tell the router what to move
+            progress_vc[port] = entry.vc;
+
+            // Need to set the busy values
+            in_port_busy[port] = entry.size_in_flits;
+            out_port_busy[next_port] = entry.size_in_flits;
+        }
+    }
+};
+
+} // namespace Merlin
+} // namespace SST
+
+#endif // COMPONENTS_HR_ROUTER_XBAR_ARB_SORTED_H
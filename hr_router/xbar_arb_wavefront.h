@@ -0,0 +1,239 @@
+// Copyright 2009-2020 NTESS. Under the terms
+// of Contract DE-NA0003525 with NTESS, the U.S.
+// Government retains certain rights in this software.
+//
+// Copyright (c) 2009-2020, NTESS
+// All rights reserved.
+//
+// Portions are copyright of other developers:
+// See the file CONTRIBUTORS.TXT in the top level directory
+// the distribution for more information.
+//
+// This file is part of the SST software package. For license
+// information, see the LICENSE file in the top level directory of the
+// distribution.
+
+#ifndef COMPONENTS_HR_ROUTER_XBAR_ARB_WAVEFRONT_H
+#define COMPONENTS_HR_ROUTER_XBAR_ARB_WAVEFRONT_H
+
+#include <sst/core/component.h>
+#include <sst/core/event.h>
+#include <sst/core/link.h>
+#include <sst/core/timeConverter.h>
+
+#include <cstring>
+
+#include "../router.h"
+
+using namespace SST;
+
+namespace SST {
+namespace Merlin {
+
+// Wavefront allocator (Tamir and Chi, "Symmetric crossbar arbiters
+// for VLSI communication switches").  The request matrix of inputs
+// by outputs is swept one wrapped diagonal at a time, starting from a
+// priority diagonal that moves by one every cycle.  The cells on a
+// diagonal share no input or output, so every request on it whose
+// input and output are both still free is granted.  One sweep gives a
+// maximal matching.
+//
+// Requests are stored by diagonal: diagonal d holds a bitmask of the
+// inputs i that request output (i + d) % num_ports.  Only diagonals
+// with requests are visited, and the free inputs on each are found
+// by masking with the free input set.
+class xbar_arb_wavefront : public XbarArbitration {
+
+  public:
+    SST_ELI_REGISTER_SUBCOMPONENT_DERIVED(xbar_arb_wavefront, "merlin", "xbar_arb_wavefront",
+                                          SST_ELI_ELEMENT_VERSION(1, 0, 0),
+                                          "Wavefront input/output matching arbitration unit for hr_router",
+                                          SST::Merlin::XbarArbitration)
+
+  private:
+    int num_ports;
+    int num_vcs;
+    int num_words;
+
+    // Indexed by diagonal * num_words
+    uint64_t *diags;
+    // Diagonals that have requests
+    uint64_t *active_diags;
+    uint64_t *free_in;
+    uint64_t *free_out;
+
+    // VC each input uses for each output, indexed by input * num_ports
+    // + output
+    int *req_vc;
+    int *rr_vcs;
+    int priority_diag;
+
+#if VERIFY_DECLOCKING
+    int priority_diag_shadow;
+#endif
+
+    internal_router_event **vc_heads;
+
+    static inline void setBit(uint64_t *mask, int bit) { mask[bit >> 6] |= (uint64_t)1 << (bit & 63); }
+    static inline void clearBit(uint64_t *mask, int bit) { mask[bit >> 6] &= ~((uint64_t)1 << (bit & 63)); }
+    static inline bool testBit(const uint64_t *mask, int bit) { return (mask[bit >> 6] >> (bit & 63)) & 1; }
+
+    // Returns the first bit set in mask at or after start, wrapping
+    // around, or -1 if there is none
+    inline int findFrom(const uint64_t *mask, int start) const {
+        int word = start >> 6;
+        uint64_t val = mask[word] & (~(uint64_t)0 << (start & 63));
+        for (int i = 0; i < num_words; i++) {
+            if (val != 0)
+                return (word << 6) + __builtin_ctzll(val);
+            word = (word + 1 == num_words) ? 0 : word + 1;
+            val = mask[word];
+        }
+        return val != 0 ? (word << 6) + __builtin_ctzll(val) : -1;
+    }
+
+  public:
+    xbar_arb_wavefront(ComponentId_t cid, Params & /*params*/)
+        : XbarArbitration(cid), diags(nullptr), active_diags(nullptr), free_in(nullptr), free_out(nullptr),
+          req_vc(nullptr), rr_vcs(nullptr) {}
+
+    ~xbar_arb_wavefront() override {
+        delete[] diags;
+        delete[] active_diags;
+        delete[] free_in;
+        delete[] free_out;
+        delete[] req_vc;
+        delete[] rr_vcs;
+    }
+
+    void setPorts(int num_ports_s, int num_vcs_s) override {
+        num_ports = num_ports_s;
+        num_vcs = num_vcs_s;
+        num_words = (num_ports + 63) / 64;
+
+        diags = new uint64_t[num_ports * num_words];
+        active_diags = new uint64_t[num_words];
+        free_in = new uint64_t[num_words];
+        free_out = new uint64_t[num_words];
+        memset(diags, 0, num_ports * num_words * sizeof(uint64_t));
+        memset(active_diags, 0, num_words * sizeof(uint64_t));
+
+        req_vc = new int[num_ports * num_ports];
+        rr_vcs = new int[num_ports];
+        for (int i = 0; i < num_ports; i++) {
+            rr_vcs[i] = 0;
+        }
+        priority_diag = 0;
+#if VERIFY_DECLOCKING
+        priority_diag_shadow = 0;
+#endif
+    }
+
+    // Naming convention is from point of view of the xbar.  So,
+    // in_port_busy is >0 if someone is writing to that xbar port and
+    // out_port_busy is >0 if that xbar port being read.
+    void arbitrate(
+#if VERIFY_DECLOCKING
+        PortInterface **ports, int *in_port_busy, int *out_port_busy, int *progress_vc, bool clocking
+#else
+        PortInterface **ports, int *in_port_busy, int *out_port_busy, int *progress_vc
+#endif
+        ) override {
+
+        memset(free_in, 0, num_words * sizeof(uint64_t));
+        memset(free_out, 0, num_words * sizeof(uint64_t));
+
+        // Build the requests.  An input only requests outputs it
+        // could actually send to this cycle, each through the first
+        // such VC after its round robin VC.
+        for (int port = 0; port < num_ports; port++) {
+            progress_vc[port] = -1;
+            if (out_port_busy[port] <= 0)
+                setBit(free_out, port);
+            if (in_port_busy[port] > 0 || active_vcs->getPortCount(port) == 0)
+                continue;
+
+            vc_heads = ports[port]->getVCHeads();
+            for (int vc = rr_vcs[port], vcount = 0; vcount < num_vcs;
+                 vc = ((vc != num_vcs - 1) ? (vc + 1) : 0), vcount++) {
+                internal_router_event *src_event = vc_heads[vc];
+                if (src_event == nullptr)
+                    continue;
+                progress_vc[port] = -2;
+                int next_port = src_event->getNextPort();
+                int diag = next_port >= port ? next_port - port : next_port - port + num_ports;
+                if (testBit(&diags[diag * num_words], port))
+                    continue;
+                if (out_port_busy[next_port] > 0 ||
+                    !ports[next_port]->spaceToSend(src_event->getVC(), src_event->getFlitCount()))
+                    continue;
+                setBit(&diags[diag * num_words], port);
+                setBit(active_diags, diag);
+                setBit(free_in, port);
+                req_vc[port * num_ports + next_port] = vc;
+            }
+        }
+
+        // Sweep the diagonals with requests, starting at the priority
+        // diagonal.  Each is cleared once visited, which also leaves
+        // the request state empty for the next cycle.
+        int diag = priority_diag;
+        while ((diag = findFrom(active_diags, diag)) != -1) {
+            uint64_t *row = &diags[diag * num_words];
+            for (int w = 0; w < num_words; w++) {
+                uint64_t ins = row[w] & free_in[w];
+                row[w] = 0;
+                while (ins != 0) {
+                    int in = (w << 6) + __builtin_ctzll(ins);
+                    ins &= ins - 1;
+                    int out = in + diag < num_ports ? in + diag : in + diag - num_ports;
+                    if (!testBit(free_out, out))
+                        continue;
+
+                    clearBit(free_in, in);
+                    clearBit(free_out, out);
+
+                    int vc = req_vc[in * num_ports + out];
+                    int flits = ports[in]->getVCHeads()[vc]->getFlitCount();
+                    progress_vc[in] = vc;
+                    in_port_busy[in] = flits;
+                    out_port_busy[out] = flits;
+                    rr_vcs[in] = (vc + 1) % num_vcs;
+                }
+            }
+            clearBit(active_diags, diag);
+        }
+
+        priority_diag = (priority_diag + 1) % num_ports;
+
+#if VERIFY_DECLOCKING
+        if (clocking) {
+            priority_diag_shadow = priority_diag;
+        }
+#endif
+    }
+
+    void reportSkippedCycles(Cycle_t cycles) override {
+#if VERIFY_DECLOCKING
+        priority_diag_shadow = (priority_diag_shadow + cycles) % num_ports;
+        if (priority_diag_shadow != priority_diag)
+            std::cout << "  PROBLEM:  priority_diag = " << priority_diag
+                      << ", priority_diag_shadow = " << priority_diag_shadow << ", cycles = " << cycles << std::endl;
+#else
+        priority_diag = (priority_diag + cycles) % num_ports;
+#endif
+    }
+
+    void dumpState(std::ostream &stream) override {
+        stream << "Current priority diagonal: " << priority_diag << std::endl;
+        stream << "  Current round robin VC by port:" << std::endl;
+        for (int i = 0; i < num_ports; i++) {
+            stream << i << ": " << rr_vcs[i] << std::endl;
+        }
+    }
+};
+
+} // namespace Merlin
+} // namespace SST
+
+#endif // COMPONENTS_HR_ROUTER_XBAR_ARB_WAVEFRONT_H
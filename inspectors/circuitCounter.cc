@@ -17,6 +17,8 @@
 
 #include "circuitCounter.h"
 
+#include <cmath>
+
 using namespace std;
 
 namespace SST {
@@ -24,97 +26,176 @@ namespace Merlin {
 
 SST::Core::ThreadSafe::Spinlock CircNetworkInspector::mapLock;
 CircNetworkInspector::setMap_t CircNetworkInspector::setMap;
+int CircNetworkInspector::pendingInspectors = 0;
+
+CircNetworkInspector::PathSet::PathSet() : slots(64, empty_key), count(0), has_empty_key(false) {}
+
+void CircNetworkInspector::PathSet::merge(const PathSet &other) {
+    for (uint64_t key : other.slots) {
+        if (key != empty_key)
+            insert(key);
+    }
+    has_empty_key |= other.has_empty_key;
+}
+
+void CircNetworkInspector::PathSet::grow() {
+    std::vector<uint64_t> old_slots(slots.size() * 2, empty_key);
+    old_slots.swap(slots);
+    count = 0;
+    for (uint64_t key : old_slots) {
+        if (key != empty_key)
+            insert(key);
+    }
+}
+
+void CircNetworkInspector::PathSketch::init(int precision_s) {
+    precision = precision_s;
+    registers.assign(size_t(1) << precision, 0);
+}
+
+void CircNetworkInspector::PathSketch::merge(const PathSketch &other) {
+    for (size_t i = 0; i < registers.size(); i++) {
+        if (other.registers[i] > registers[i])
+            registers[i] = other.registers[i];
+    }
+}
+
+uint64_t CircNetworkInspector::PathSketch::size() const {
+    double m = registers.size();
+    double sum = 0;
+    int zeros = 0;
+    for (uint8_t r : registers) {
+        sum += std::ldexp(1.0, -r);
+        if (r == 0)
+            zeros++;
+    }
+
+    double alpha;
+    switch (precision) {
+    case 4:
+        alpha = 0.673;
+        break;
+    case 5:
+        alpha = 0.697;
+        break;
+    case 6:
+        alpha = 0.709;
+        break;
+    default:
+        alpha = 0.7213 / (1.0 + 1.079 / m);
+        break;
+    }
+
+    double estimate = alpha * m * m / sum;
+    // Use linear counting for small cardinalities.  The hash is 64
+    // bits, so no large range correction is needed.
+    if (estimate <= 2.5 * m && zeros != 0) {
+        estimate = m * std::log(m / zeros);
+    }
+    return uint64_t(estimate + 0.5);
+}
 
 CircNetworkInspector::CircNetworkInspector(SST::ComponentId_t id, SST::Params &params, const std::string & /*sub_id*/)
-    : SimpleNetwork::NetworkInspector(id) {
+    : SimpleNetwork::NetworkInspector(id), registered(false) {
     outFileName = params.find<std::string>("output_file");
     if (outFileName.empty()) {
         outFileName = "RouterCircuits";
     }
 
-    {
-        mapLock.lock();
-
-        // use router name as the key
-        // Get router name from my name
-        string fullname = getName();
-
-        // Nmae of router is the name before the first :
-        int index = fullname.find(":");
-
-        const string &key = index == string::npos ? fullname : fullname.substr(0, index);
-        // look up our key
-        auto iter = setMap.find(key);
-        if (iter == setMap.end()) {
-            // we're first!
-            auto *ps = new pairSet_t;
-            setMap[key] = ps;
-            uniquePaths = ps;
-        } else {
-            // someone else created the set already
-            uniquePaths = iter->second;
-        }
+    std::string mode = params.find<std::string>("mode", "exact");
+    if (mode == "exact") {
+        approximate = false;
+    } else if (mode == "approximate") {
+        approximate = true;
+    } else {
+        Output::getDefaultObject().fatal(CALL_INFO, -1, "circuit_network_inspector: unknown mode: %s\n",
+                                         mode.c_str());
+    }
 
-        mapLock.unlock();
+    hll_precision = params.find<int>("hll_precision", 12);
+    if (hll_precision < 4 || hll_precision > 18) {
+        Output::getDefaultObject().fatal(CALL_INFO, -1,
+                                         "circuit_network_inspector: hll_precision must be between 4 and 18, "
+                                         "got %d\n",
+                                         hll_precision);
     }
+    if (approximate)
+        pathSketch.init(hll_precision);
+
+    registerInspector();
 }
 
 #ifndef SST_ENABLE_PREVIEW_BUILD
-void CircNetworkInspector::initialize(string /*id*/) {
+void CircNetworkInspector::initialize(string /*id*/) { registerInspector(); }
+#endif
+
+void CircNetworkInspector::registerInspector() {
+    if (registered)
+        return;
+    registered = true;
+
+    // use router name as the key
+    // Get router name from my name
+    string fullname = getName();
+
+    // Name of router is the name before the first :
+    size_t index = fullname.find(":");
+    routerName = index == string::npos ? fullname : fullname.substr(0, index);
+
     // critical section for accessing the map
     {
         mapLock.lock();
 
-        // use router name as the key
-        // Get router name from my name
-        string fullname = getName();
-
-        // Nmae of router is the name before the first :
-        int index = fullname.find(":");
-
-        const string &key = index == string::npos ? fullname : fullname.substr(0, index);
-        // look up our key
-        auto iter = setMap.find(key);
+        auto iter = setMap.find(routerName);
         if (iter == setMap.end()) {
             // we're first!
-            auto *ps = new pairSet_t;
-            setMap[key] = ps;
-            uniquePaths = ps;
-        } else {
-            // someone else created the set already
-            uniquePaths = iter->second;
+            auto *rp = new RouterPaths;
+            rp->approximate = approximate;
+            if (approximate)
+                rp->approx.init(hll_precision);
+            setMap[routerName] = rp;
+        } else if (iter->second->approximate != approximate ||
+                   (approximate && iter->second->approx.getPrecision() != hll_precision)) {
+            mapLock.unlock();
+            Output::getDefaultObject().fatal(CALL_INFO, -1,
+                                             "circuit_network_inspector: all inspectors on router %s must use the "
+                                             "same mode and hll_precision\n",
+                                             routerName.c_str());
         }
+        pendingInspectors++;
 
         mapLock.unlock();
     }
 }
-#endif
 
-void CircNetworkInspector::inspectNetworkData(SimpleNetwork::Request *req) {
-    uniquePaths->insert(SDPair(req->src, req->dest));
-}
-
-// Print out all the stats. We have the first component print all the
-// stats and peform cleanup, everyone else finds an empty map.
+// Each inspector merges its pairs into its router's results.  The
+// last one to finish prints all the stats and peforms cleanup.
 void CircNetworkInspector::finish() {
     // critical section for accessing the map
     {
         mapLock.lock();
 
-        if (!setMap.empty()) {
+        RouterPaths *rp = setMap[routerName];
+        if (approximate)
+            rp->approx.merge(pathSketch);
+        else
+            rp->exact.merge(uniquePaths);
+
+        if (--pendingInspectors == 0) {
             // create new file
             auto *output_file = new SST::Output("", 0, 0, SST::Output::FILE, outFileName);
 
             for (auto &i : setMap) {
+                uint64_t count = i.second->approximate ? i.second->approx.size() : i.second->exact.size();
                 // print
-                output_file->output(CALL_INFO, "%s %" PRIu64 "\n", i.first.c_str(),
-                                    (unsigned long long)i.second->size());
+                output_file->output(CALL_INFO, "%s %" PRIu64 "\n", i.first.c_str(), count);
                 // clean up
                 delete (i.second);
             }
-        }
 
-        setMap.clear();
+            setMap.clear();
+            delete output_file;
+        }
 
         mapLock.unlock();
     }
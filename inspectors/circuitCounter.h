@@ -20,6 +20,11 @@
 #include <sst/core/interfaces/simpleNetwork.h>
 #include <sst/core/threadsafe.h>
 
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
 namespace SST {
 using namespace SST::Interfaces;
 namespace Merlin {
@@ -32,19 +37,123 @@ class CircNetworkInspector : public SimpleNetwork::NetworkInspector {
         "Used to count the number of network circuits (as in 'circuit switched' circuits)",
         SST::Interfaces::SimpleNetwork::NetworkInspector)
 
+    SST_ELI_DOCUMENT_PARAMS(
+        {"output_file", "File to write the per router circuit counts to.", "RouterCircuits"},
+        {"mode", "How to count unique (src, dest) pairs: exact or approximate.  Approximate uses a HyperLogLog "
+                 "sketch, which keeps memory constant for very large systems.",
+         "exact"},
+        {"hll_precision", "Number of index bits for the HyperLogLog sketch (4-18).  The sketch uses 2^hll_precision "
+                          "bytes per port and has a standard error of about 1.04/sqrt(2^hll_precision).",
+         "12"})
+
   private:
-    typedef std::pair<SimpleNetwork::nid_t, SimpleNetwork::nid_t> SDPair;
-    using pairSet_t = std::set<SDPair>;
-    pairSet_t *uniquePaths;
+    // Open addressing hash set of packed (src, dest) keys.  Uses
+    // linear probing and keeps the load factor under 1/2.
+    class PathSet {
+      public:
+        PathSet();
+
+        inline void insert(uint64_t key) {
+            if (key == empty_key) {
+                has_empty_key = true;
+                return;
+            }
+            size_t mask = slots.size() - 1;
+            size_t index = hash(key) & mask;
+            while (slots[index] != empty_key) {
+                if (slots[index] == key)
+                    return;
+                index = (index + 1) & mask;
+            }
+            slots[index] = key;
+            if (++count * 2 > slots.size())
+                grow();
+        }
+
+        void merge(const PathSet &other);
+        uint64_t size() const { return count + (has_empty_key ? 1 : 0); }
+
+      private:
+        static const uint64_t empty_key = ~0ULL;
+
+        std::vector<uint64_t> slots;
+        size_t count;
+        // The key that marks an empty slot is also a legal pair, so it
+        // is tracked on its own
+        bool has_empty_key;
+
+        void grow();
+    };
+
+    // HyperLogLog sketch.  Each register holds the largest rank seen
+    // for the keys hashed to it.  Sketches merge by taking the max of
+    // each register.
+    class PathSketch {
+      public:
+        PathSketch() : precision(0) {}
+
+        // Registers are only allocated when the sketch is used
+        void init(int precision_s);
+
+        inline void insert(uint64_t key) {
+            uint64_t h = hash(key);
+            uint64_t index = h >> (64 - precision);
+            // Set a guard bit so the rank is bounded when the rest of
+            // the hash is zero
+            uint64_t rest = (h << precision) | (1ULL << (precision - 1));
+            uint8_t rank = __builtin_clzll(rest) + 1;
+            if (rank > registers[index])
+                registers[index] = rank;
+        }
+
+        void merge(const PathSketch &other);
+        uint64_t size() const;
+        int getPrecision() const { return precision; }
+
+      private:
+        int precision;
+        std::vector<uint8_t> registers;
+    };
+
+    // Per router results.  Each inspector merges its own set in at
+    // finish().
+    struct RouterPaths {
+        bool approximate;
+        PathSet exact;
+        PathSketch approx;
+    };
+
+    static inline uint64_t hash(uint64_t key) {
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdULL;
+        key ^= key >> 33;
+        key *= 0xc4ceb9fe1a85ec53ULL;
+        key ^= key >> 33;
+        return key;
+    }
+
+    // Only this port's pairs are recorded here, so
+    // inspectNetworkData() never touches shared state
+    bool approximate;
+    int hll_precision;
+    PathSet uniquePaths;
+    PathSketch pathSketch;
+
     std::string outFileName;
+    std::string routerName;
+    bool registered;
 
-    using setMap_t = std::map<std::string, pairSet_t *>;
-    // Map which makes sure that all the inspectors on one router use
-    // the same pairSet. This structure can be accessed by multiple
-    // threads during intiailize, so it needs to be protected.
+    using setMap_t = std::map<std::string, RouterPaths *>;
+    // Map of merged results for each router.  This structure is
+    // accessed by multiple threads during construction and finish(),
+    // so it needs to be protected.  The results are written out by
+    // the last inspector to finish.
     static setMap_t setMap;
+    static int pendingInspectors;
     static SST::Core::ThreadSafe::Spinlock mapLock;
 
+    void registerInspector();
+
   public:
     CircNetworkInspector(SST::ComponentId_t, SST::Params &params, const std::string &sub_id);
 
@@ -53,7 +162,14 @@ class CircNetworkInspector : public SimpleNetwork::NetworkInspector {
 #endif
     void finish() override;
 
-    void inspectNetworkData(SimpleNetwork::Request *req) override;
+    void inspectNetworkData(SimpleNetwork::Request *req) override {
+        // Node ids fit in 32 bits for any system merlin can build
+        uint64_t key = (uint64_t(uint32_t(req->src)) << 32) | uint32_t(req->dest);
+        if (approximate)
+            pathSketch.insert(key);
+        else
+            uniquePaths.insert(key);
+    }
 };
 
 } // namespace Merlin
@@ -19,8 +19,14 @@
 
 #include <sst/core/simulation.h>
 #include <sst/core/sharedRegion.h>
+#include <sst/core/timeLord.h>
+
+#include <map>
+#include <memory>
+#include <tuple>
 
 #include "../merlin.h"
+#include "../binary_trace.h"
 
 namespace SST {
 using namespace Interfaces;
@@ -28,11 +34,16 @@ using namespace Interfaces;
 namespace Merlin {
 
 LinkControl::LinkControl(ComponentId_t cid, Params &params, int vns)
-    : SST::Interfaces::SimpleNetwork(cid), rtr_link(nullptr), output_timing(nullptr), req_vns(vns), used_vns(0),
-      total_vns(0), vn_out_map(nullptr), vn_remap_out(nullptr), output_queues(nullptr), router_credits(nullptr),
-      router_return_credits(nullptr), input_queues(nullptr), id(-1), logical_nid(-1), nid_map_shm(nullptr),
-      nid_map(nullptr), curr_out_vn(0), waiting(true), have_packets(false), start_block(0), idle_start(0),
-      is_idle(true), receiveFunctor(nullptr), sendFunctor(nullptr), network_initialized(false),
+    : SST::Interfaces::SimpleNetwork(cid), rtr_link(nullptr), output_timing(nullptr), flit_cycle(nullptr),
+      req_vns(vns), used_vns(0), total_vns(0), vn_out_map(nullptr), vn_remap_out(nullptr), output_queues(nullptr),
+      router_credits(nullptr), router_return_credits(nullptr), input_queues(nullptr), credit_return_flits(1),
+      credit_return_window(1), credit_piggyback(false), credit_flush_scheduled(false), credit_timing(nullptr), id(-1),
+      logical_nid(-1), nid_map_shm(nullptr), nid_map(nullptr), curr_out_vn(0), vns_with_data(0), lazy_output(false),
+      output_deferred(false), deferred_have_packets(false), output_busy_until(0), core_tc(nullptr),
+      direct_inject(false), send_notify(nullptr), send_notify_scheduled(false), waiting(true), have_packets(false),
+      start_block(0), idle_start(0), is_idle(true), receiveFunctor(nullptr), sendFunctor(nullptr),
+      network_initialized(false), latency_hist(nullptr), ns_tc(nullptr), ps_tc(nullptr), delay_breakdown(false),
+      hop_delay_hist(nullptr), trace(nullptr),
       output(Simulation::getSimulation()->getSimulationOutput()) {
     // Get the link bandwidth
     link_bw = params.find<UnitAlgebra>("link_bw");
@@ -81,6 +92,58 @@ LinkControl::LinkControl(ComponentId_t cid, Params &params, int vns)
     output_timing = configureSelfLink(port_name + "_output_timing", "1GHz",
                                       new Event::Handler<LinkControl>(this, &LinkControl::handle_output));
 
+    // Credit return coalescing
+    credit_return_flits = params.find<int>("credit_return_flits", 1);
+    if (credit_return_flits < 1) {
+        merlin_abort.fatal(CALL_INFO, -1, "LinkControl: credit_return_flits must be at least 1\n");
+    }
+    credit_return_window = params.find<int>("credit_return_window", credit_return_flits);
+    if (credit_return_window < 1) {
+        merlin_abort.fatal(CALL_INFO, -1, "LinkControl: credit_return_window must be at least 1\n");
+    }
+    credit_piggyback = params.find<bool>("credit_piggyback", false);
+
+    std::string trace_file = params.find<std::string>("trace_file", "");
+    if (!trace_file.empty())
+        trace = BinaryTrace::acquire(trace_file);
+
+    ns_tc = getTimeConverter("1ns");
+    ps_tc = getTimeConverter("1ps");
+    delay_breakdown = params.find<bool>("delay_breakdown", false);
+    if (params.find<bool>("latency_histogram", false) || delay_breakdown) {
+        int digits = params.find<int>("latency_histogram_digits", 2);
+        if (digits < 1 || digits > 5) {
+            merlin_abort.fatal(CALL_INFO, -1, "LinkControl: latency_histogram_digits must be between 1 and 5\n");
+        }
+        UnitAlgebra max_latency = params.find<UnitAlgebra>("latency_histogram_max", "1ms");
+        if (!max_latency.hasUnits("s")) {
+            merlin_abort.fatal(CALL_INFO, -1, "LinkControl: latency_histogram_max must be specified in s: %s\n",
+                               max_latency.toStringBestSI().c_str());
+        }
+        uint64_t max_ps = (max_latency / UnitAlgebra("1ps")).getRoundedValue();
+        if (params.find<bool>("latency_histogram", false))
+            latency_hist = acquireHistograms("latency", req_vns, digits, max_ps);
+        if (delay_breakdown)
+            hop_delay_hist = acquireHistograms("hop_delay", HopDelays::NUM_STAGES, digits, max_ps);
+    }
+    credit_timing = configureSelfLink(port_name + "_credit_timing", "1GHz",
+                                      new Event::Handler<LinkControl>(this, &LinkControl::handle_credit_flush));
+
+    std::string output_scheduling = params.find<std::string>("output_scheduling", "self_event");
+    if (output_scheduling == "self_event") {
+        lazy_output = false;
+    } else if (output_scheduling == "busy_until") {
+        lazy_output = true;
+    } else {
+        merlin_abort.fatal(CALL_INFO, -1, "LinkControl: unknown output_scheduling: %s\n",
+                           output_scheduling.c_str());
+    }
+    core_tc = getTimeConverter(Simulation::getTimeLord()->getTimeBase());
+    if (lazy_output) {
+        send_notify = configureSelfLink(port_name + "_send_notify", "1GHz",
+                                        new Event::Handler<LinkControl>(this, &LinkControl::handle_send_notify));
+    }
+
     // Input and output buffers.  Not all of them can be set up now.
     // Only those that are sized based on req_vns can be intialized
     // now.  Others will wait until init when we find out the rest of
@@ -143,6 +206,23 @@ LinkControl::LinkControl(ComponentId_t cid, Params &params, int vns)
     send_bit_count = registerStatistic<uint64_t>("send_bit_count");
     output_port_stalls = registerStatistic<uint64_t>("output_port_stalls");
     idle_time = registerStatistic<uint64_t>("idle_time");
+    for (int i = 0; latency_hist != nullptr && i < req_vns; i++) {
+        std::string vn = std::to_string(i);
+        latency_stats.push_back(registerStatistic<uint64_t>("latency_p50", vn));
+        latency_stats.push_back(registerStatistic<uint64_t>("latency_p99", vn));
+        latency_stats.push_back(registerStatistic<uint64_t>("latency_p999", vn));
+        latency_stats.push_back(registerStatistic<uint64_t>("latency_max", vn));
+    }
+    if (delay_breakdown) {
+        static const char *stage_names[HopDelays::NUM_STAGES] = {"input_queue", "xbar_wait", "output_queue",
+                                                                 "credit_stall"};
+        for (int i = 0; i < HopDelays::NUM_STAGES; i++) {
+            hop_delay_stats.push_back(registerStatistic<uint64_t>("hop_delay", stage_names[i]));
+            hop_delay_stats.push_back(registerStatistic<uint64_t>("hop_delay_p50", stage_names[i]));
+            hop_delay_stats.push_back(registerStatistic<uint64_t>("hop_delay_p99", stage_names[i]));
+            hop_delay_stats.push_back(registerStatistic<uint64_t>("hop_delay_max", stage_names[i]));
+        }
+    }
 }
 
 LinkControl::~LinkControl() {
@@ -155,6 +235,8 @@ LinkControl::~LinkControl() {
     // Delete shared region manager for nid map if we're using one
     if (nid_map_shm)
         delete nid_map_shm;
+
+    BinaryTrace::release(trace);
 }
 
 void LinkControl::setup() {
@@ -199,8 +281,9 @@ void LinkControl::init(unsigned int phase) {
 
         // Need to reset the time base of the output link
         UnitAlgebra link_clock = link_bw / flit_size_ua;
-        TimeConverter *tc = getTimeConverter(link_clock);
-        output_timing->setDefaultTimeBase(tc);
+        flit_cycle = getTimeConverter(link_clock);
+        output_timing->setDefaultTimeBase(flit_cycle);
+        credit_timing->setDefaultTimeBase(flit_cycle);
 
         // Initialize links
         // Receive the endpoint ID from PortControl
@@ -285,6 +368,12 @@ void LinkControl::init(unsigned int phase) {
             }
         }
 
+        // Output VNs with data are tracked in a 64 bit mask
+        if (used_vns > 64) {
+            merlin_abort.fatal(CALL_INFO, -1, "LinkControl: at most 64 VNs can be used by an endpoint, got %d\n",
+                               used_vns);
+        }
+
         // Instance the output queues
         int count = 0;
         vn_remap_out = new output_queue_bundle_t *[req_vns];
@@ -294,6 +383,7 @@ void LinkControl::init(unsigned int phase) {
                 // Set up the credits
                 output_queues[count].credits = (outbuf_size / flit_size_ua).getRoundedValue();
                 output_queues[count].vn = i;
+                output_queues[count].queue.reserve(output_queues[count].credits);
                 // Find which outputs map to this vn
                 for (int j = 0; j < req_vns; ++j) {
                     if (vn_out_map[j] == i) {
@@ -307,6 +397,19 @@ void LinkControl::init(unsigned int phase) {
         // Don't need this map anymore
         delete[] vn_out_map;
 
+        // With one output queue the next packet to inject is always
+        // its head, so it can be injected ahead of time
+        direct_inject = lazy_output && used_vns == 1 && !credit_piggyback;
+        if (direct_inject)
+            pending_out_credits.reserve(output_queues[0].credits);
+
+        // The input queues are bounded by the credits handed to the
+        // router, which are only known now that we have the flit size
+        int input_entries = (inbuf_size / flit_size_ua).getRoundedValue();
+        for (int i = 0; i < req_vns; ++i) {
+            input_queues[i].reserve(input_entries);
+        }
+
         network_initialized = true;
 
         // Need to send available credits to other side of link
@@ -371,10 +474,20 @@ void LinkControl::complete(unsigned int /*phase*/) {
 }
 
 void LinkControl::finish() {
+    // Pick up the state from a skipped wakeup that should already have
+    // happened
+    if (output_deferred && Simulation::getSimulation()->getCurrentSimCycle() >= output_busy_until)
+        resolveDeferredOutput(false);
+
     if (is_idle) {
         idle_time->addData(Simulation::getSimulation()->getCurrentSimCycle() - idle_start);
         is_idle = false;
     }
+    if (latency_hist != nullptr && --latency_hist->users == 0)
+        reportLatencyHistograms();
+    if (hop_delay_hist != nullptr && --hop_delay_hist->users == 0)
+        reportHopDelayHistograms();
+
     // Clean up all the events left in the queues.  This will help
     // track down real memory leaks as all this events won't be in the
     // way.
@@ -392,6 +505,53 @@ void LinkControl::finish() {
     }
 }
 
+LinkControl::SharedHistograms *LinkControl::acquireHistograms(const std::string &kind, int count, int digits,
+                                                             uint64_t max_ps) {
+    // Shared histograms on this thread, by kind, count, digits and max
+    static thread_local std::map<std::tuple<std::string, int, int, uint64_t>, std::unique_ptr<SharedHistograms>>
+        thread_histograms;
+    std::unique_ptr<SharedHistograms> &shared = thread_histograms[std::make_tuple(kind, count, digits, max_ps)];
+    if (!shared) {
+        shared.reset(new SharedHistograms());
+        shared->hists.resize(count);
+        for (auto &hist : shared->hists) {
+            hist.init(digits, max_ps);
+        }
+        shared->users = 0;
+        shared->endpoints = 0;
+    }
+    shared->users++;
+    shared->endpoints++;
+    return shared.get();
+}
+
+// Per thread results.  There's no reduction across threads or ranks,
+// so each prints its own line per VN, tagged with where it ran.
+void LinkControl::reportLatencyHistograms() {
+    RankInfo rank = Simulation::getSimulation()->getRank();
+    for (int i = 0; i < req_vns; i++) {
+        const HdrHistogram &hist = latency_hist->hists[i];
+        latency_stats[i * 4]->addData(hist.percentile(0.5));
+        latency_stats[i * 4 + 1]->addData(hist.percentile(0.99));
+        latency_stats[i * 4 + 2]->addData(hist.percentile(0.999));
+        latency_stats[i * 4 + 3]->addData(hist.getMax());
+        output.output("Packet latency over %d endpoints on rank %u thread %u, VN %d: %" PRIu64
+                      " packets, p50 = %" PRIu64 " ps, p99 = %" PRIu64 " ps, p99.9 = %" PRIu64
+                      " ps, max = %" PRIu64 " ps\n",
+                      latency_hist->endpoints, rank.rank, rank.thread, i, hist.getCount(), hist.percentile(0.5),
+                      hist.percentile(0.99), hist.percentile(0.999), hist.getMax());
+    }
+}
+
+void LinkControl::reportHopDelayHistograms() {
+    for (int i = 0; i < HopDelays::NUM_STAGES; i++) {
+        const HdrHistogram &hist = hop_delay_hist->hists[i];
+        hop_delay_stats[i * 4 + 1]->addData(hist.percentile(0.5));
+        hop_delay_stats[i * 4 + 2]->addData(hist.percentile(0.99));
+        hop_delay_stats[i * 4 + 3]->addData(hist.getMax());
+    }
+}
+
 // Returns true if there is space in the output buffer and false
 // otherwise.
 bool LinkControl::send(SimpleNetwork::Request *req, int vn) {
@@ -416,6 +576,8 @@ bool LinkControl::send(SimpleNetwork::Request *req, int vn) {
     int flits = ev->getSizeInFlits();
 
     // Check to see if there are enough credits to send
+    if (!pending_out_credits.empty())
+        releaseOutputCredits();
     if (out_handle.credits < flits)
         return false;
 
@@ -423,14 +585,23 @@ bool LinkControl::send(SimpleNetwork::Request *req, int vn) {
     out_handle.credits -= flits;
     // ev->request->vn = vn;
 
-    ev->setInjectionTime(getCurrentSimTimeNano());
+    ev->setInjectionTime(Simulation::getSimulation()->getCurrentSimCycle());
+    if (delay_breakdown)
+        ev->enableHopDelays();
     out_handle.queue.push(ev);
+    vns_with_data |= uint64_t(1) << (&out_handle - output_queues);
+    resolveDeferredOutput(true);
     if (waiting && !have_packets) {
-        output_timing->send(1, nullptr);
         waiting = false;
+        if (direct_inject)
+            injectAhead(Simulation::getSimulation()->getCurrentSimCycle() + flit_cycle->getFactor());
+        else
+            output_timing->send(1, nullptr);
     }
 
-    if (ev->getTraceType() != SimpleNetwork::Request::NONE) {
+    if (ev->getTraceType() != SimpleNetwork::Request::NONE && trace != nullptr) {
+        trace->record(TRACE_NIC_SEND, ev->getTraceID(), id, -1, vn, id, req->dest);
+    } else if (ev->getTraceType() != SimpleNetwork::Request::NONE) {
         output.output("TRACE(%d): %" PRIu64 " ns: Send on LinkControl in NIC: %s\n", ev->getTraceID(),
                       getCurrentSimTimeNano(), getName().c_str());
     }
@@ -440,6 +611,8 @@ bool LinkControl::send(SimpleNetwork::Request *req, int vn) {
 // Returns true if there is space in the output buffer and false
 // otherwise.
 bool LinkControl::spaceToSend(int vn, int bits) {
+    if (!pending_out_credits.empty())
+        releaseOutputCredits();
     if (vn_remap_out[vn]->credits * flit_size < bits)
         return false;
     return true;
@@ -454,19 +627,24 @@ SST::Interfaces::SimpleNetwork::Request *LinkControl::recv(int vn) {
     RtrEvent *event = input_queues[vn].front();
     input_queues[vn].pop();
 
-    // Figure out how many credits to return
+    // Figure out how many credits to return.  Credits are tracked by
+    // the network VN the packet travelled on.
     int flits = event->getSizeInFlits();
-    router_return_credits[vn] += flits;
-
-    // For now, we're just going to send the credits back to the
-    // other side.  The required BW to do this will not be taken
-    // into account.
-    // rtr_link->send(1,new credit_event(event->request->vn,in_ret_credits[event->request->vn]));
-    // in_ret_credits[event->request->vn] = 0;
-    rtr_link->send(1, new credit_event(event->getRouteVN(), router_return_credits[vn]));
-    router_return_credits[vn] = 0;
+    int route_vn = event->getRouteVN();
+    router_return_credits[route_vn] += flits;
+
+    // Return the credits once enough have built up, otherwise make
+    // sure they get flushed by the end of the window
+    if (router_return_credits[route_vn] >= credit_return_flits) {
+        returnCredits(route_vn);
+    } else if (!credit_flush_scheduled) {
+        credit_timing->send(credit_return_window, nullptr);
+        credit_flush_scheduled = true;
+    }
 
-    if (event->getTraceType() != SimpleNetwork::Request::NONE) {
+    if (event->getTraceType() != SimpleNetwork::Request::NONE && trace != nullptr) {
+        trace->record(TRACE_NIC_DELIVER, event->getTraceID(), id, -1, vn, event->getTrustedSrc(), event->getDest());
+    } else if (event->getTraceType() != SimpleNetwork::Request::NONE) {
         output.output("TRACE(%d): %" PRIu64 " ns: recv called on LinkControl in NIC: %s\n", event->getTraceID(),
                       getCurrentSimTimeNano(), getName().c_str());
     }
@@ -479,6 +657,46 @@ SST::Interfaces::SimpleNetwork::Request *LinkControl::recv(int vn) {
     return ret;
 }
 
+void LinkControl::returnCredits(int vn) {
+    // For now, we're just going to send the credits back to the
+    // other side.  The required BW to do this will not be taken
+    // into account.
+    rtr_link->send(1, new credit_event(vn, router_return_credits[vn]));
+    router_return_credits[vn] = 0;
+}
+
+void LinkControl::handle_credit_flush(Event * /*ev*/) {
+    credit_flush_scheduled = false;
+    for (int i = 0; i < total_vns; i++) {
+        if (router_return_credits[i] > 0)
+            returnCredits(i);
+    }
+}
+
+void LinkControl::receiveCredits(int vn, int credits) {
+    router_credits[vn] += credits;
+
+    // Credits come over the link, so one that lands just as the link
+    // goes free was sent before that wakeup was scheduled and would
+    // have been seen by it
+    resolveDeferredOutput(true);
+
+    // If we're waiting, we need to send a wakeup event to the
+    // output queues
+    if (waiting) {
+        waiting = false;
+        // If we were stalled waiting for credits and we had
+        // packets, we need to add stall time
+        if (have_packets) {
+            output_port_stalls->addData(Simulation::getSimulation()->getCurrentSimCycle() - start_block);
+        }
+        if (direct_inject)
+            injectAhead(Simulation::getSimulation()->getCurrentSimCycle() + flit_cycle->getFactor());
+        else
+            output_timing->send(1, nullptr);
+    }
+}
+
 void LinkControl::sendUntimedData(SST::Interfaces::SimpleNetwork::Request *req) {
     if (nid_map) {
         req->dest = nid_map[req->dest];
@@ -509,22 +727,14 @@ void LinkControl::handle_input(Event *ev) {
     auto *base_event = static_cast<BaseRtrEvent *>(ev);
     if (base_event->getType() == BaseRtrEvent::CREDIT) {
         auto *ce = static_cast<credit_event *>(ev);
-        router_credits[ce->vc] += ce->credits;
+        receiveCredits(ce->vc, ce->credits);
         delete ev;
-
-        // If we're waiting, we need to send a wakeup event to the
-        // output queues
-        if (waiting) {
-            output_timing->send(1, nullptr);
-            waiting = false;
-            // If we were stalled waiting for credits and we had
-            // packets, we need to add stall time
-            if (have_packets) {
-                output_port_stalls->addData(Simulation::getSimulation()->getCurrentSimCycle() - start_block);
-            }
-        }
     } else {
         auto *event = static_cast<RtrEvent *>(ev);
+        if (event->getPiggybackVC() != -1) {
+            receiveCredits(event->getPiggybackVC(), event->getPiggybackCredits());
+            event->setPiggybackCredits(-1, 0);
+        }
         // Simply put the event into the right virtual network queue
         // int orig_vn = event->getOriginalVN();
         int vn = event->getLogicalVN();
@@ -535,14 +745,27 @@ void LinkControl::handle_input(Event *ev) {
             idle_time->addData(Simulation::getSimulation()->getCurrentSimCycle() - idle_start);
             is_idle = false;
         }
-        if (event->getTraceType() == SimpleNetwork::Request::FULL) {
+        if (event->getTraceType() == SimpleNetwork::Request::FULL && trace != nullptr) {
+            trace->record(TRACE_NIC_RECV, event->getTraceID(), id, -1, event->getRouteVN(), event->getTrustedSrc(),
+                          event->getDest());
+        } else if (event->getTraceType() == SimpleNetwork::Request::FULL) {
             output.output("TRACE(%d): %" PRIu64 " ns: Received and event on LinkControl in NIC: %s"
                           " on VN %d from src %" PRIu64 "\n",
                           event->getTraceID(), getCurrentSimTimeNano(), getName().c_str(), event->getRouteVN(),
                           event->getTrustedSrc());
         }
-        SimTime_t lat = getCurrentSimTimeNano() - event->getInjectionTime();
-        packet_latency->addData(lat);
+        SimTime_t lat = Simulation::getSimulation()->getCurrentSimCycle() - event->getInjectionTime();
+        packet_latency->addData(ns_tc->convertFromCoreTime(lat));
+        if (latency_hist != nullptr)
+            latency_hist->hists[vn].record(ps_tc->convertFromCoreTime(lat));
+        if (hop_delay_hist != nullptr && event->getHopDelays() != nullptr) {
+            const HopDelays *delays = event->getHopDelays();
+            for (int i = 0; i < HopDelays::NUM_STAGES; i++) {
+                uint64_t delay = ps_tc->convertFromCoreTime(delays->total[i]);
+                hop_delay_hist->hists[i].record(delay);
+                hop_delay_stats[i * 4]->addData(delay);
+            }
+        }
         if (receiveFunctor != nullptr) {
             bool keep = (*receiveFunctor)(vn);
             if (!keep)
@@ -559,80 +782,39 @@ void LinkControl::handle_output(Event * /*ev*/) {
     // of the block
 
     // We do a round robin scheduling.  If the current vn has no
-    // data, find one that does.
+    // data, find one that does.  Only VNs with data are looked at,
+    // starting with curr_out_vn and wrapping around.
     int vn_to_send = -1;
     bool found = false;
     RtrEvent *send_event = nullptr;
-    have_packets = false;
-    for (int i = curr_out_vn; i < used_vns; i++) {
-        if (output_queues[i].queue.empty())
-            continue;
-        have_packets = true;
-        send_event = output_queues[i].queue.front();
-        // Check to see if the needed VN has enough space
-        if (router_credits[output_queues[i].vn] < send_event->getSizeInFlits())
-            continue;
-        vn_to_send = i;
-        output_queues[i].queue.pop();
-        found = true;
-        break;
-    }
-
-    if (!found) {
-        for (int i = 0; i < curr_out_vn; i++) {
-            if (output_queues[i].queue.empty())
-                continue;
-            have_packets = true;
+    have_packets = vns_with_data != 0;
+    uint64_t upper = vns_with_data & (~uint64_t(0) << curr_out_vn);
+    uint64_t candidates[2] = {upper, vns_with_data & ~upper};
+    for (int pass = 0; pass < 2 && !found; pass++) {
+        uint64_t mask = candidates[pass];
+        while (mask != 0) {
+            int i = __builtin_ctzll(mask);
+            mask &= mask - 1;
             send_event = output_queues[i].queue.front();
             // Check to see if the needed VN has enough space
             if (router_credits[output_queues[i].vn] < send_event->getSizeInFlits())
                 continue;
             vn_to_send = i;
             output_queues[i].queue.pop();
+            if (output_queues[i].queue.empty())
+                vns_with_data &= ~(uint64_t(1) << i);
             found = true;
             break;
         }
     }
+
     // If we found an event to send, go ahead and send it
     if (found) {
-        // Need to return credits to the output buffer
         int size = send_event->getSizeInFlits();
-        // outbuf_credits[vn_to_send] += size;
-        output_queues[vn_to_send].credits += size;
+        injectPacket(vn_to_send, send_event, Simulation::getSimulation()->getCurrentSimCycle(), false);
 
         // Send an event to wake up again after this packet is sent.
-        output_timing->send(size, nullptr);
-
-        curr_out_vn = vn_to_send + 1;
-        if (curr_out_vn == used_vns)
-            curr_out_vn = 0;
-
-        // Add in inject time so we can track latencies
-        send_event->setInjectionTime(getCurrentSimTimeNano());
-
-        // Subtract credits
-        // rtr_credits[vn_to_send] -= size;
-        router_credits[output_queues[vn_to_send].vn] -= size;
-
-        if (is_idle) {
-            idle_time->addData(Simulation::getSimulation()->getCurrentSimCycle() - idle_start);
-            is_idle = false;
-        }
-
-        rtr_link->send(send_event);
-
-        if (send_event->getTraceType() == SimpleNetwork::Request::FULL) {
-            output.output("TRACE(%d): %" PRIu64 " ns: Sent an event to router from LinkControl"
-                          " in NIC: %s on VN %d to dest %" PRIu64 ".\n",
-                          send_event->getTraceID(), getCurrentSimTimeNano(), getName().c_str(),
-                          send_event->getRouteVN(), send_event->getDest());
-        }
-        send_bit_count->addData(send_event->getSizeInBits());
-        if (sendFunctor != nullptr) {
-            bool keep = (*sendFunctor)(send_event->getLogicalVN());
-            if (!keep)
-                sendFunctor = nullptr;
-        }
+        scheduleOutput(size);
     } else {
         // What do we do if there's nothing to send??  It could be
         // because everything is empty or because there's not
@@ -656,5 +838,198 @@ void LinkControl::handle_output(Event * /*ev*/) {
     }
 }
 
+// Injects send_event, already taken off output_queues[vn], starting
+// at start.  With ahead set that is later than now: the packet goes
+// out with the difference as extra delay, and its output buffer
+// space is only handed back to the endpoint once it has started.
+void LinkControl::injectPacket(int vn, RtrEvent *send_event, SimTime_t start, bool ahead) {
+    // Need to return credits to the output buffer
+    int size = send_event->getSizeInFlits();
+    // outbuf_credits[vn] += size;
+    if (ahead) {
+        pending_out_credits.push({start, size, send_event->getLogicalVN()});
+        scheduleSendNotify();
+    } else {
+        output_queues[vn].credits += size;
+    }
+
+    curr_out_vn = vn + 1;
+    if (curr_out_vn == used_vns)
+        curr_out_vn = 0;
+
+    // Add in inject time so we can track latencies
+    send_event->setInjectionTime(start);
+
+    // Subtract credits
+    // rtr_credits[vn] -= size;
+    router_credits[output_queues[vn].vn] -= size;
+
+    if (is_idle) {
+        idle_time->addData(start - idle_start);
+        is_idle = false;
+    }
+
+    if (credit_piggyback) {
+        // Only one VN worth of credits fits on a packet.  Anything
+        // else still held goes with the next packet or the flush.
+        for (int i = 0; i < total_vns; i++) {
+            if (router_return_credits[i] > 0) {
+                send_event->setPiggybackCredits(i, router_return_credits[i]);
+                router_return_credits[i] = 0;
+                break;
+            }
+        }
+    }
+
+    if (ahead)
+        rtr_link->send(start - Simulation::getSimulation()->getCurrentSimCycle(), core_tc, send_event);
+    else
+        rtr_link->send(send_event);
+
+    if (send_event->getTraceType() == SimpleNetwork::Request::FULL && trace != nullptr) {
+        trace->record(TRACE_NIC_INJECT, send_event->getTraceID(), id, -1, send_event->getRouteVN(), id,
+                      send_event->getDest());
+    } else if (send_event->getTraceType() == SimpleNetwork::Request::FULL) {
+        output.output("TRACE(%d): %" PRIu64 " ns: Sent an event to router from LinkControl"
+                      " in NIC: %s on VN %d to dest %" PRIu64 ".\n",
+                      send_event->getTraceID(), getCurrentSimTimeNano(), getName().c_str(),
+                      send_event->getRouteVN(), send_event->getDest());
+    }
+    send_bit_count->addData(send_event->getSizeInBits());
+    if (!ahead && sendFunctor != nullptr) {
+        bool keep = (*sendFunctor)(send_event->getLogicalVN());
+        if (!keep)
+            sendFunctor = nullptr;
+    }
+}
+
+// Schedules the wakeup at the end of a packet that takes flits flit
+// cycles to inject.  In busy_until mode the wakeup is skipped when it
+// would find nothing to inject.
+void LinkControl::scheduleOutput(int flits) {
+    if (direct_inject) {
+        injectAhead(Simulation::getSimulation()->getCurrentSimCycle() + flits * flit_cycle->getFactor());
+        return;
+    }
+    if (!lazy_output || canSendOutput()) {
+        output_timing->send(flits, nullptr);
+        return;
+    }
+    output_deferred = true;
+    output_busy_until = Simulation::getSimulation()->getCurrentSimCycle() + flits * flit_cycle->getFactor();
+}
+
+// Called when a packet is queued or credits come back.  If the
+// skipped wakeup is still in the future, schedule it after all.
+// Otherwise do what it would have done when it found nothing to
+// inject.
+void LinkControl::resolveDeferredOutput(bool inclusive) {
+    if (!output_deferred)
+        return;
+    output_deferred = false;
+
+    SimTime_t now = Simulation::getSimulation()->getCurrentSimCycle();
+    if (now < output_busy_until || (inclusive && now == output_busy_until)) {
+        if (direct_inject)
+            injectAhead(output_busy_until);
+        else
+            output_timing->send(output_busy_until - now, core_tc, nullptr);
+        return;
+    }
+
+    have_packets = deferred_have_packets;
+    start_block = output_busy_until;
+    waiting = true;
+    if (!have_packets && !is_idle) {
+        idle_start = output_busy_until;
+        is_idle = true;
+    }
+}
+
+// Returns true if handle_output() could inject something right now
+bool LinkControl::canSendOutput() {
+    deferred_have_packets = vns_with_data != 0;
+    uint64_t mask = vns_with_data;
+    while (mask != 0) {
+        int i = __builtin_ctzll(mask);
+        mask &= mask - 1;
+        if (router_credits[output_queues[i].vn] >= output_queues[i].queue.front()->getSizeInFlits())
+            return true;
+    }
+    return false;
+}
+
+// Does now what a wakeup at start would do.  Nothing that happens
+// before then can change which packet goes next, and more credits
+// can only let more packets go, so every packet at the head of the
+// queue that has credits now is injected back to back.  Whatever
+// stops that is handled the busy_until way.  Running out of packets
+// or credits leaves a deferred wakeup at the time the link goes free
+// for the next send() or credit return to pick up.  Traced packets
+// and a registered send functor have to be handled at start itself,
+// so they get a real wakeup.
+void LinkControl::injectAhead(SimTime_t start) {
+    output_queue_bundle_t &out_handle = output_queues[0];
+    while (true) {
+        if (vns_with_data == 0 || router_credits[out_handle.vn] < out_handle.queue.front()->getSizeInFlits()) {
+            deferred_have_packets = vns_with_data != 0;
+            output_deferred = true;
+            output_busy_until = start;
+            return;
+        }
+
+        RtrEvent *send_event = out_handle.queue.front();
+        if (sendFunctor != nullptr || send_event->getTraceType() == SimpleNetwork::Request::FULL) {
+            output_timing->send(start - Simulation::getSimulation()->getCurrentSimCycle(), core_tc, nullptr);
+            return;
+        }
+
+        out_handle.queue.pop();
+        if (out_handle.queue.empty())
+            vns_with_data = 0;
+        have_packets = true;
+        int size = send_event->getSizeInFlits();
+        injectPacket(0, send_event, start, true);
+        start += size * flit_cycle->getFactor();
+    }
+}
+
+// Hands back the output buffer space of packets injected ahead once
+// they have started.  Packets that start this cycle are left alone:
+// their wakeup would have run after the endpoint's clock handler.
+void LinkControl::releaseOutputCredits() {
+    SimTime_t now = Simulation::getSimulation()->getCurrentSimCycle();
+    while (!pending_out_credits.empty() && pending_out_credits.front().start < now) {
+        output_queues[0].credits += pending_out_credits.front().flits;
+        pending_out_credits.pop();
+    }
+}
+
+// Makes sure the send functor is called when the next packet
+// injected ahead starts, as it would have been from handle_output()
+void LinkControl::scheduleSendNotify() {
+    if (sendFunctor == nullptr || pending_out_credits.empty() || send_notify_scheduled)
+        return;
+    send_notify->send(pending_out_credits.front().start - Simulation::getSimulation()->getCurrentSimCycle(),
+                      core_tc, nullptr);
+    send_notify_scheduled = true;
+}
+
+void LinkControl::handle_send_notify(Event * /*ev*/) {
+    send_notify_scheduled = false;
+    SimTime_t now = Simulation::getSimulation()->getCurrentSimCycle();
+    while (!pending_out_credits.empty() && pending_out_credits.front().start <= now) {
+        pending_credits_t pending = pending_out_credits.front();
+        pending_out_credits.pop();
+        output_queues[0].credits += pending.flits;
+        if (sendFunctor != nullptr) {
+            bool keep = (*sendFunctor)(pending.logical_vn);
+            if (!keep)
+                sendFunctor = nullptr;
+        }
+    }
+    scheduleSendNotify();
+}
+
 } // namespace Merlin
 } // namespace SST
@@ -25,9 +25,13 @@
 
 #include <sst/core/statapi/statbase.h>
 
+#include "../hdr_histogram.h"
 #include "../router.h"
 
+#include <deque>
 #include <queue>
+#include <string>
+#include <vector>
 
 namespace SST {
 
@@ -35,10 +39,12 @@ class Component;
 
 namespace Merlin {
 
+class BinaryTrace;
+
 // Whole class definition needs to be in the header file so that other
 // libraries can use the class to talk with the merlin routers.
 
-typedef std::queue<RtrEvent *> network_queue_t;
+typedef RingBuffer<RtrEvent *> network_queue_t;
 
 // Class to manage link between NIC and router.  A single NIC can have
 // more than one link_control (and thus link to router).
@@ -61,6 +67,51 @@ class LinkControl : public SST::Interfaces::SimpleNetwork {
         {"nid_map_name",
          "Base name of shared region where my NID map will be located.  If empty, no NID map will be used.", ""},
         {"vn_remap", "Remap VNs onto/off of the network.  If empty, no vn remapping is done", ""},
+        {"credit_return_flits",
+         "Number of flits of credit to accumulate for a VN before returning them to the router.  1 returns credits "
+         "for every packet.",
+         "1"},
+        {"credit_return_window",
+         "Maximum number of flit cycles returned credits are held before being sent, regardless of "
+         "credit_return_flits.  This bounds how late credits arrive at the router compared to returning them per "
+         "packet.  Defaults to credit_return_flits.",
+         ""},
+        {"credit_piggyback", "Attach held credits to packets injected into the router instead of sending them "
+                             "separately.",
+         "false"},
+        {"latency_histogram",
+         "Keep a log-linear histogram of packet latencies in ps for each VN.  All the endpoints on a thread record "
+         "into the same histograms, which are printed and fill in the p50, p99, p99.9 and max statistics at the "
+         "end of the run.  Each thread prints its own.  They aren't combined across threads or MPI ranks.",
+         "false"},
+        {"latency_histogram_digits",
+         "Number of significant decimal digits latencies are kept to in the histogram.  Also used for the "
+         "delay_breakdown histograms.",
+         "2"},
+        {"latency_histogram_max",
+         "Largest latency the histogram resolves.  Larger latencies are counted in the last bucket, though max is "
+         "still exact.  Also used for the delay_breakdown histograms.",
+         "1ms"},
+        {"delay_breakdown",
+         "Have the routers record how long each packet sent waits in the input queue, for the crossbar, in the "
+         "output queue and for credits, summed over its hops.  Received packets are added to a histogram per stage "
+         "and the hop_delay statistics.  Off, packets carry nothing extra.",
+         "false"},
+        {"trace_file",
+         "Prefix of the binary trace files for traced packets.  If empty, traced packets are printed as TRACE lines "
+         "instead.",
+         ""},
+        {"output_scheduling",
+         "How the output side is woken up.  self_event wakes up after every injected packet.  busy_until only "
+         "schedules the wakeup at the end of a packet when there is something that could be injected then, and "
+         "otherwise remembers when the link goes free.  Packets are injected at the same times either way.  "
+         "Only an endpoint that uses a single output VN and has credit_piggyback off injects the packets queued "
+         "behind the one on the link straight away, with the time left until the link goes free as extra delay, "
+         "so a backlogged endpoint takes no wakeups.  With more VNs a later send() or credit return can change "
+         "which VN goes next, and piggybacked credits have to be picked up when the packet starts, so those "
+         "endpoints still take one wakeup per packet that has something to inject.  So do packets sent while a "
+         "send functor is registered and traced packets.",
+         "self_event"},
 
     )
 
@@ -69,7 +120,30 @@ class LinkControl : public SST::Interfaces::SimpleNetwork {
                                 {"output_port_stalls", "Time output port is stalled (in units of core timebase)",
                                  "time in stalls", 1},
                                 {"idle_time", "Number of (in unites of core timebas) that port was idle",
-                                 "time spent idle", 1}, )
+                                 "time spent idle", 1},
+                                {"latency_p50",
+                                 "Median packet latency in ps over the endpoints on the thread, per VN.  Only the "
+                                 "last endpoint on the thread to finish reports it.  Needs latency_histogram.",
+                                 "latency", 1},
+                                {"latency_p99", "99th percentile packet latency in ps, reported like latency_p50.",
+                                 "latency", 1},
+                                {"latency_p999", "99.9th percentile packet latency in ps, reported like latency_p50.",
+                                 "latency", 1},
+                                {"latency_max", "Maximum packet latency in ps, reported like latency_p50.", "latency",
+                                 1},
+                                {"hop_delay",
+                                 "Time each received packet spent in one stage of the routers, in ps.  The subId is "
+                                 "the stage: input_queue, xbar_wait, output_queue or credit_stall.  Needs "
+                                 "delay_breakdown.",
+                                 "latency", 1},
+                                {"hop_delay_p50",
+                                 "Median hop_delay in ps over the endpoints on the thread, per stage.  Only the last "
+                                 "endpoint on the thread to finish reports it.  Needs delay_breakdown.",
+                                 "latency", 1},
+                                {"hop_delay_p99", "99th percentile hop_delay in ps, reported like hop_delay_p50.",
+                                 "latency", 1},
+                                {"hop_delay_max", "Maximum hop_delay in ps, reported like hop_delay_p50.", "latency",
+                                 1}, )
 
     SST_ELI_DOCUMENT_PORTS({"rtr_port",
                             "Port that connects to router",
@@ -91,6 +165,7 @@ class LinkControl : public SST::Interfaces::SimpleNetwork {
     // Self link for timing output.  This is how we manage bandwidth
     // usage
     Link *output_timing;
+    TimeConverter *flit_cycle;
 
     // Perforamne paramters
     UnitAlgebra link_bw;
@@ -133,6 +208,16 @@ class LinkControl : public SST::Interfaces::SimpleNetwork {
     // Input queues.  Size is req_vn
     network_queue_t *input_queues;
 
+    // Credit return coalescing.  Credits are held in
+    // router_return_credits until credit_return_flits of them have
+    // built up for a VN, or until credit_return_window flit cycles
+    // after the first one was held.
+    int credit_return_flits;
+    int credit_return_window;
+    bool credit_piggyback;
+    bool credit_flush_scheduled;
+    Link *credit_timing;
+
     nid_t id;
     nid_t logical_nid;
     SharedRegion *nid_map_shm;
@@ -141,6 +226,40 @@ class LinkControl : public SST::Interfaces::SimpleNetwork {
     // Doing a round robin on the output.  Need to keep track of the
     // current virtual channel.
     int curr_out_vn;
+    // Bit i is set when output_queues[i] holds data
+    uint64_t vns_with_data;
+
+    // Output wakeups in busy_until mode.  A wakeup at the end of a
+    // packet that would find nothing to inject is not scheduled, and
+    // the next send() or credit return sorts out what it would have
+    // done.
+    bool lazy_output;
+    bool output_deferred;
+    bool deferred_have_packets;
+    SimTime_t output_busy_until;
+    TimeConverter *core_tc;
+
+    // Direct injection, busy_until with a single output queue and no
+    // credit piggybacking.  With one queue the next packet to inject
+    // can't change.  With several, a send() or credit return before
+    // the link goes free can change the round robin pick, and
+    // piggybacked credits are only known at injection.  So instead of
+    // waking up when the link goes free the packet is sent right away
+    // with the time left as extra delay.  Its output buffer space is
+    // handed back to the endpoint once it starts, from
+    // pending_out_credits.  Every entry holds at least a flit of the
+    // output buffer, so it never needs more entries than the buffer
+    // has credits.  If a send functor is registered, send_notify
+    // calls it at that time.
+    struct pending_credits_t {
+        SimTime_t start;
+        int flits;
+        int logical_vn;
+    };
+    bool direct_inject;
+    RingBuffer<pending_credits_t> pending_out_credits;
+    Link *send_notify;
+    bool send_notify_scheduled;
 
     // Represents the start of when a port was idle
     // If the buffer was empty we instantiate this to the current time
@@ -171,6 +290,37 @@ class LinkControl : public SST::Interfaces::SimpleNetwork {
     Statistic<uint64_t> *output_port_stalls;
     Statistic<uint64_t> *idle_time;
 
+    // Histograms shared by the LinkControls on a thread that use the
+    // same settings, so their size doesn't grow with the number of
+    // endpoints.  A thread only runs its own components, so they are
+    // recorded into without a lock.  The last LinkControl using them
+    // to finish reports them.
+    struct SharedHistograms {
+        std::vector<HdrHistogram> hists;
+        // LinkControls that haven't finished
+        int users;
+        int endpoints;
+    };
+
+    // Packet latency histograms in ps, one per requested VN.  nullptr
+    // unless latency_histogram is set.
+    SharedHistograms *latency_hist;
+    // p50, p99, p99.9 and max for each VN, at vn * 4 + i
+    std::vector<Statistic<uint64_t> *> latency_stats;
+    TimeConverter *ns_tc;
+    TimeConverter *ps_tc;
+
+    // Per hop delay breakdown.  With delay_breakdown set, every packet
+    // sent carries a HopDelays that the routers fill in, and received
+    // packets are added to a histogram per stage, in ps.
+    bool delay_breakdown;
+    SharedHistograms *hop_delay_hist;
+    // hop_delay, p50, p99 and max for each stage, at stage * 4 + i
+    std::vector<Statistic<uint64_t> *> hop_delay_stats;
+
+    // Binary trace for traced packets, or nullptr to print them
+    BinaryTrace *trace;
+
     Output &output;
 
   public:
@@ -213,7 +363,10 @@ class LinkControl : public SST::Interfaces::SimpleNetwork {
     SST::Interfaces::SimpleNetwork::Request *recvUntimedData() override;
 
     inline void setNotifyOnReceive(HandlerBase *functor) override { receiveFunctor = functor; }
-    inline void setNotifyOnSend(HandlerBase *functor) override { sendFunctor = functor; }
+    inline void setNotifyOnSend(HandlerBase *functor) override {
+        sendFunctor = functor;
+        scheduleSendNotify();
+    }
 
     inline bool isNetworkInitialized() const override { return network_initialized; }
     // inline nid_t getEndpointID() const { return id; }
@@ -231,6 +384,20 @@ class LinkControl : public SST::Interfaces::SimpleNetwork {
 
     void handle_input(Event *ev);
     void handle_output(Event *ev);
+    void injectPacket(int vn, RtrEvent *send_event, SimTime_t start, bool ahead);
+    void scheduleOutput(int flits);
+    void injectAhead(SimTime_t start);
+    void resolveDeferredOutput(bool inclusive);
+    bool canSendOutput();
+    void releaseOutputCredits();
+    void scheduleSendNotify();
+    void handle_send_notify(Event *ev);
+    void handle_credit_flush(Event *ev);
+    void returnCredits(int vn);
+    void receiveCredits(int vn, int credits);
+    static SharedHistograms *acquireHistograms(const std::string &kind, int count, int digits, uint64_t max_ps);
+    void reportLatencyHistograms();
+    void reportHopDelayHistograms();
 };
 
 } // namespace Merlin
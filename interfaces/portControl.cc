@@ -19,6 +19,7 @@
 
 #include "output_arb_basic.h"
 #include "output_arb_qos_multi.h"
+#include "../binary_trace.h"
 
 #include <sst/core/sharedRegion.h>
 
@@ -43,6 +44,10 @@ void PortControl::sendTopologyEvent(TopologyEvent *ev) {
     // free and it will consume the port for the appropriate time
     // based on number of flits.
     topo_queue.push(ev);
+    if (waiting) {
+        output_timing->send(1, nullptr);
+        waiting = false;
+    }
 }
 
 void PortControl::send(internal_router_event *ev, int vc) {
@@ -67,6 +72,8 @@ void PortControl::send(internal_router_event *ev, int vc) {
     ev->setVC(vc);
 
     output_buf[vc].push(ev);
+    if (output_buf[vc].size() == 1)
+        checkCreditStall(vc);
     if (waiting) {
         // if ( waiting && !have_packets ) {
         // std::cout << "waking up the output" << std::endl;
@@ -95,30 +102,61 @@ internal_router_event *PortControl::recv(int vc) {
         printStatus(Simulation::getSimulation()->getSimulationOutput(), 0, 0);
     }
 #endif
-    // if ( input_buf[vc].size() == 0 ) return NULL;
-    if (input_buf[vc].empty())
-        return nullptr;
+    internal_router_event *event;
+    if (voq) {
+        if (vc_heads[vc] == nullptr)
+            return nullptr;
+
+        int head = voq_head_port[vc];
+        event = voq_buf[vc * num_router_ports + head].front();
+        voq_buf[vc * num_router_ports + head].pop();
+        voq_count[vc]--;
+        voq_rr[vc] = (head + 1) % num_router_ports;
+
+        // Next head is the first nonempty queue after the one just
+        // served.  selectVOQHeads() may still move it before the
+        // next arbitration.
+        if (voq_count[vc] == 0) {
+            vc_heads[vc] = nullptr;
+            parent->dec_vcs_with_data(port_number, vc);
+        } else {
+            int out = voq_rr[vc];
+            while (voq_buf[vc * num_router_ports + out].empty())
+                out = (out + 1) % num_router_ports;
+            voq_head_port[vc] = out;
+            vc_heads[vc] = voq_buf[vc * num_router_ports + out].front();
+            startXbarWait(vc_heads[vc]);
+        }
+    } else {
+        // if ( input_buf[vc].size() == 0 ) return NULL;
+        if (input_buf[vc].empty())
+            return nullptr;
 
-    internal_router_event *event = input_buf[vc].front();
-    input_buf[vc].pop();
+        event = input_buf[vc].front();
+        input_buf[vc].pop();
 
-    // Need to update vc_heads
-    if (input_buf[vc].empty()) {
-        vc_heads[vc] = nullptr;
-        parent->dec_vcs_with_data();
-    } else {
-        vc_heads[vc] = input_buf[vc].front();
+        // Need to update vc_heads
+        if (input_buf[vc].empty()) {
+            vc_heads[vc] = nullptr;
+            parent->dec_vcs_with_data(port_number, vc);
+        } else {
+            vc_heads[vc] = input_buf[vc].front();
+            startXbarWait(vc_heads[vc]);
+        }
     }
 
     int vc_return = topo->isHostPort(port_number) ? event->getCreditReturnVC() : vc;
     // Figure out how many credits to return
     port_ret_credits[vc_return] += event->getFlitCount();
 
-    // For now, we're just going to send the credits back to the
-    // other side.  The required BW to do this will not be taken
-    // into account.
-    port_link->send(1, new credit_event(vc_return, port_ret_credits[vc_return]));
-    port_ret_credits[vc_return] = 0;
+    // Return the credits once enough have built up, otherwise make
+    // sure they get flushed by the end of the window
+    if (port_ret_credits[vc_return] >= credit_return_flits) {
+        returnCredits(vc_return);
+    } else if (!credit_flush_scheduled) {
+        credit_timing->send(credit_return_window, nullptr);
+        credit_flush_scheduled = true;
+    }
 
 #if TRACK
     if (rtr_id == TRACK_ID && port_number == TRACK_PORT) {
@@ -129,12 +167,115 @@ internal_router_event *PortControl::recv(int vc) {
     return event;
 }
 
+// For each VC with more than one nonempty queue, present the first
+// packet, round robin from the last queue served, that could move
+// through the crossbar this cycle.  If none can, the head stays put.
+//
+// The router reroutes VC heads after this, so an adaptive topology
+// may have sent the head to another output since it was queued.  It
+// is moved to the front of that output's queue first, so every packet
+// sits in the queue of the output it is routed to.
+void PortControl::selectVOQHeads(PortInterface **ports, const int *out_port_busy) {
+    if (!voq)
+        return;
+    for (int vc = 0; vc < num_vcs; vc++) {
+        if (vc_heads[vc] == nullptr)
+            continue;
+        internal_router_event *head = vc_heads[vc];
+        if (head->getNextPort() != voq_head_port[vc]) {
+            voq_buf[vc * num_router_ports + voq_head_port[vc]].pop();
+            voq_head_port[vc] = head->getNextPort();
+            voq_buf[vc * num_router_ports + voq_head_port[vc]].push_front(head);
+        }
+        if (out_port_busy[head->getNextPort()] <= 0 &&
+            ports[head->getNextPort()]->spaceToSend(head->getVC(), head->getFlitCount()))
+            continue;
+        if (voq_count[vc] == (int)voq_buf[vc * num_router_ports + voq_head_port[vc]].size())
+            continue;
+
+        for (int i = 0; i < num_router_ports; i++) {
+            int out = (voq_rr[vc] + i) % num_router_ports;
+            port_queue_t &q = voq_buf[vc * num_router_ports + out];
+            if (q.empty())
+                continue;
+            internal_router_event *ev = q.front();
+            if (out_port_busy[ev->getNextPort()] <= 0 &&
+                ports[ev->getNextPort()]->spaceToSend(ev->getVC(), ev->getFlitCount())) {
+                voq_head_port[vc] = out;
+                vc_heads[vc] = ev;
+                startXbarWait(ev);
+                break;
+            }
+        }
+    }
+}
+
+void PortControl::returnCredits(int vc) {
+    // For now, we're just going to send the credits back to the
+    // other side.  The required BW to do this will not be taken
+    // into account.
+    port_link->send(1, new credit_event(vc, port_ret_credits[vc]));
+    port_ret_credits[vc] = 0;
+}
+
+void PortControl::handle_credit_flush(Event * /*ev*/) {
+    credit_flush_scheduled = false;
+    for (int i = 0; i < num_vcs; i++) {
+        if (port_ret_credits[i] > 0)
+            returnCredits(i);
+    }
+}
+
+void PortControl::attachPiggybackCredits(BaseRtrEvent *ev) {
+    // Only one VC worth of credits fits on an event.  Anything else
+    // still held will go out with the next packet or the flush.
+    for (int i = 0; i < num_vcs; i++) {
+        if (port_ret_credits[i] > 0) {
+            ev->setPiggybackCredits(i, port_ret_credits[i]);
+            port_ret_credits[i] = 0;
+            return;
+        }
+    }
+}
+
+void PortControl::receiveCredits(int vc, int credits) {
+    port_out_credits[vc] += credits;
+    if (credit_stalled_heads > 0)
+        releaseCreditStalls();
+
+    if (host_port && oql_track_remote) {
+        if (oql_track_port) {
+            for (int i = 0; i < num_vcs; ++i) {
+                output_queue_lengths[i] -= credits;
+            }
+        } else {
+            output_queue_lengths[vc] -= credits;
+        }
+    }
+
+    // If we're waiting, we need to send a wakeup event to the
+    // output queues
+    if (waiting) {
+        output_timing->send(1, nullptr);
+        waiting = false;
+        // If we were stalled waiting for credits and we had
+        // packets, we need to add stall time
+        if (have_packets) {
+            output_port_stalls->addData(Simulation::getSimulation()->getCurrentSimCycle() - start_block);
+        }
+    }
+}
+
 PortControl::PortControl(ComponentId_t cid, Params &params, Router *rif, int rtr_id, int port_number, Topology *topo)
     : PortInterface(cid), rtr_id(rtr_id), num_vcs(-1), topo(topo), port_number(port_number),
       remote_rdy_for_credits(false), input_buf(nullptr), output_buf(nullptr), input_buf_count(nullptr),
       output_buf_count(nullptr), port_ret_credits(nullptr), port_out_credits(nullptr), idle_start(0), sai_win_start(0),
       sai_port_disabled(false), ongoing_transmit(false), is_idle(true), is_active(false), waiting(true),
-      have_packets(false), start_block(0), parent(rif), output(Simulation::getSimulation()->getSimulationOutput()) {
+      have_packets(false), start_block(0), credit_return_flits(1), credit_return_window(1), credit_piggyback(false),
+      credit_flush_scheduled(false), credit_timing(nullptr), voq(false), num_router_ports(0), voq_buf(nullptr),
+      voq_count(nullptr), voq_head_port(nullptr), voq_rr(nullptr), credit_stalled_heads(0), parent(rif),
+      trace(nullptr),
+      output(Simulation::getSimulation()->getSimulationOutput()) {
     // Process the parameters
 
     // Get the port name.  For now, we only load anonymously, but when
@@ -218,6 +359,19 @@ PortControl::PortControl(ComponentId_t cid, Params &params, Router *rif, int rtr
         return;
     }
 
+    // Credit return coalescing
+    credit_return_flits = params.find<int>("credit_return_flits", 1);
+    if (credit_return_flits < 1) {
+        merlin_abort.fatal(CALL_INFO, -1, "PortControl: credit_return_flits must be at least 1\n");
+    }
+    credit_return_window = params.find<int>("credit_return_window", credit_return_flits);
+    if (credit_return_window < 1) {
+        merlin_abort.fatal(CALL_INFO, -1, "PortControl: credit_return_window must be at least 1\n");
+    }
+    credit_piggyback = params.find<bool>("credit_piggyback", false);
+    credit_timing = configureSelfLink(link_port_name + "_credit_timing", "1GHz",
+                                      new Event::Handler<PortControl>(this, &PortControl::handle_credit_flush));
+
     input_buf_size = params.find<UnitAlgebra>("input_buf_size", found);
     if (!found) {
         merlin_abort.fatal(CALL_INFO_LONG, 1, "PortContol: input_buf_size must be specified\n");
@@ -293,6 +447,22 @@ PortControl::PortControl(ComponentId_t cid, Params &params, Router *rif, int rtr
     dlink_thresh = params.find<float>("dlink_thresh", -1.0);
     oql_track_port = params.find<bool>("oql_track_port", false);
     oql_track_remote = params.find<bool>("oql_track_remote", false);
+    source_routing = params.find<bool>("source_routing", false);
+
+    std::string trace_file = params.find<std::string>("trace_file", "");
+    if (!trace_file.empty())
+        trace = BinaryTrace::acquire(trace_file);
+
+    std::string input_queueing = params.find<std::string>("input_queueing", "fifo");
+    if (input_queueing == "voq") {
+        voq = true;
+        num_router_ports = params.find<int>("router_ports", 0);
+        if (num_router_ports <= 0) {
+            merlin_abort.fatal(CALL_INFO, -1, "PortControl: router_ports must be set to use voq input_queueing\n");
+        }
+    } else if (input_queueing != "fifo") {
+        merlin_abort.fatal(CALL_INFO, -1, "PortControl: unknown input_queueing: %s\n", input_queueing.c_str());
+    }
 
     Params arb_params = params.find_prefix_params("arbitration:");
 
@@ -348,6 +518,18 @@ void PortControl::initVCs(int vns, int *vcs_per_vn, internal_router_event **vc_h
         vc_heads[i] = nullptr;
     }
 
+    if (voq) {
+        voq_buf = new port_queue_t[num_vcs * num_router_ports];
+        voq_count = new int[num_vcs];
+        voq_head_port = new int[num_vcs];
+        voq_rr = new int[num_vcs];
+        for (int i = 0; i < num_vcs; i++) {
+            voq_count[i] = 0;
+            voq_head_port[i] = 0;
+            voq_rr[i] = 0;
+        }
+    }
+
     // Initialize credit arrays
     // xbar_in_credits = new int[vcs];
     port_ret_credits = new int[num_vcs];
@@ -379,6 +561,16 @@ void PortControl::initVCs(int vns, int *vcs_per_vn, internal_router_event **vc_h
         port_ret_credits[i] = ibs.getRoundedValue();
         xbar_in_credits[i] = obs.getRoundedValue();
         port_out_credits[i] = 0;
+
+        // Every packet is at least one flit, so the credit count
+        // bounds the number of events that can be in each buffer.
+        // The VOQs are left to grow on demand instead.  Any one of a
+        // VC's VOQs can hold all of its credits, but together they
+        // never hold more, so reserving each for the worst case would
+        // take ports times the storage that is ever used.
+        if (!voq)
+            input_buf[i].reserve(port_ret_credits[i]);
+        output_buf[i].reserve(xbar_in_credits[i]);
     }
 
     // // Copy the starting return tokens for the input buffers (this
@@ -411,6 +603,11 @@ PortControl::~PortControl() {
         delete[] port_ret_credits;
     if (port_out_credits != nullptr)
         delete[] port_out_credits;
+    delete[] voq_buf;
+    delete[] voq_count;
+    delete[] voq_head_port;
+    delete[] voq_rr;
+    BinaryTrace::release(trace);
     for (auto &network_inspector : network_inspectors) {
         delete network_inspector;
     }
@@ -451,6 +648,12 @@ void PortControl::finish() {
             output_buf[i].pop();
         }
     }
+    for (int i = 0; i < num_vcs * num_router_ports; i++) {
+        while (!voq_buf[i].empty()) {
+            delete voq_buf[i].front();
+            voq_buf[i].pop();
+        }
+    }
 
     // finish any inspectors
     for (auto &network_inspector : network_inspectors) {
@@ -511,6 +714,7 @@ void PortControl::init(unsigned int phase) {
         // std::cout << link_clock.toStringBestSI() << std::endl;
         flit_cycle = getTimeConverter(link_clock);
         output_timing->setDefaultTimeBase(flit_cycle);
+        credit_timing->setDefaultTimeBase(flit_cycle);
         delete ev;
 
         // Get initialization event from endpoint, but only if I am a host port
@@ -673,6 +877,12 @@ void PortControl::dumpState(std::ostream &stream) {
         stream << "    port_ret_credits = " << port_ret_credits[i] << std::endl;
         stream << "    Input Buffer:" << std::endl;
         dumpQueueState(input_buf[i], stream);
+        for (int j = 0; voq && j < num_router_ports; j++) {
+            if (voq_buf[i * num_router_ports + j].empty())
+                continue;
+            stream << "    Input Queue for port " << j << ":" << std::endl;
+            dumpQueueState(voq_buf[i * num_router_ports + j], stream);
+        }
         stream << "    Output Buffer:" << std::endl;
         dumpQueueState(output_buf[i], stream);
     }
@@ -694,6 +904,12 @@ void PortControl::printStatus(Output &out, int out_port_busy, int in_port_busy)
         out.output("    port_ret_credits = %d\n", port_ret_credits[i]);
         out.output("    Start Input Buffer\n");
         dumpQueueState(input_buf[i], out);
+        for (int j = 0; voq && j < num_router_ports; j++) {
+            if (voq_buf[i * num_router_ports + j].empty())
+                continue;
+            out.output("    Input Queue for port %d\n", j);
+            dumpQueueState(voq_buf[i * num_router_ports + j], out);
+        }
         out.output("    End Input Buffer\n");
         out.output("    Start Output Buffer\n");
         dumpQueueState(output_buf[i], out);
@@ -725,6 +941,61 @@ void PortControl::dumpQueueState(port_queue_t &q, Output &out) {
     }
 }
 
+// Puts a packet at the head of output VC vc into credit stall if
+// there aren't enough credits to send it.  On host ports credits are
+// per VN, so a head can also lose its credits to another VC of the
+// same VN after this check.  That time counts as output queueing.
+void PortControl::checkCreditStall(int vc) {
+    internal_router_event *ev = output_buf[vc].front();
+    HopDelays *delays = ev->getHopDelays();
+    if (delays == nullptr)
+        return;
+    if (port_out_credits[host_port ? ev->getVN() : vc] < ev->getFlitCount()) {
+        delays->enter(HopDelays::CREDIT_STALL);
+        credit_stalled_heads++;
+    }
+}
+
+void PortControl::releaseCreditStalls() {
+    for (int vc = 0; vc < num_vcs; vc++) {
+        if (output_buf[vc].empty())
+            continue;
+        internal_router_event *ev = output_buf[vc].front();
+        HopDelays *delays = ev->getHopDelays();
+        if (delays == nullptr || delays->stage != HopDelays::CREDIT_STALL)
+            continue;
+        if (port_out_credits[host_port ? ev->getVN() : vc] >= ev->getFlitCount()) {
+            delays->enter(HopDelays::OUTPUT_QUEUE);
+            credit_stalled_heads--;
+        }
+    }
+}
+
+void PortControl::pushInput(int vc, internal_router_event *ev) {
+    HopDelays *delays = ev->getHopDelays();
+    if (delays != nullptr)
+        delays->enter(HopDelays::INPUT_QUEUE);
+    input_buf_count[vc]++;
+    if (voq) {
+        int out = ev->getNextPort();
+        voq_buf[vc * num_router_ports + out].push(ev);
+        voq_count[vc]++;
+        if (vc_heads[vc] != nullptr)
+            return;
+        voq_head_port[vc] = out;
+    } else {
+        input_buf[vc].push(ev);
+        if (vc_heads[vc] != nullptr)
+            return;
+    }
+
+    // This becomes the vc_head (there isn't an event already in the
+    // array), so we need to put it into the vc_heads array
+    vc_heads[vc] = ev;
+    startXbarWait(ev);
+    parent->inc_vcs_with_data(port_number, vc);
+}
+
 void PortControl::handle_input_n2r(Event *ev) {
     // Check to see if this is a credit or data packet
     // credit_event* ce = dynamic_cast<credit_event*>(ev);
@@ -734,35 +1005,15 @@ void PortControl::handle_input_n2r(Event *ev) {
     switch (base_event->getType()) {
     case BaseRtrEvent::CREDIT: {
         auto *ce = static_cast<credit_event *>(ev);
-        port_out_credits[ce->vc] += ce->credits;
-
-        if (oql_track_remote) {
-            if (oql_track_port) {
-                for (int i = 0; i < num_vcs; ++i) {
-                    output_queue_lengths[i] -= ce->credits;
-                }
-            } else {
-                output_queue_lengths[ce->vc] -= ce->credits;
-            }
-        }
-
+        receiveCredits(ce->vc, ce->credits);
         delete ce;
-
-        // If we're waiting, we need to send a wakeup event to the
-        // output queues
-        if (waiting) {
-            // std::cout << output_timing << std::endl;
-            output_timing->send(1, nullptr);
-            waiting = false;
-            // If we were stalled waiting for credits and we had
-            // packets, we need to add stall time
-            if (have_packets) {
-                output_port_stalls->addData(Simulation::getSimulation()->getCurrentSimCycle() - start_block);
-            }
-        }
     } break;
     case BaseRtrEvent::PACKET: {
         auto *event = static_cast<RtrEvent *>(ev);
+        if (event->getPiggybackVC() != -1) {
+            receiveCredits(event->getPiggybackVC(), event->getPiggybackCredits());
+            event->setPiggybackCredits(-1, 0);
+        }
         // Simply put the event into the right virtual network queue
 
         // Need to process input and do the routing
@@ -770,17 +1021,16 @@ void PortControl::handle_input_n2r(Event *ev) {
         internal_router_event *rtr_event = topo->process_input(event);
         rtr_event->setCreditReturnVC(vn);
         int curr_vc = rtr_event->getVC();
-        topo->route(port_number, rtr_event->getVC(), rtr_event);
-        input_buf[curr_vc].push(rtr_event);
-        input_buf_count[curr_vc]++;
-
-        // If this becomes vc_head we need to put it into the vc_heads array
-        if (vc_heads[curr_vc] == nullptr) {
-            vc_heads[curr_vc] = rtr_event;
-            parent->inc_vcs_with_data();
-        }
-
-        if (event->getTraceType() != SST::Interfaces::SimpleNetwork::Request::NONE) {
+        if (source_routing && topo->computeSourceRoute(port_number, curr_vc, rtr_event))
+            rtr_event->popSourceRoute();
+        else
+            topo->route(port_number, rtr_event->getVC(), rtr_event);
+        pushInput(curr_vc, rtr_event);
+
+        if (event->getTraceType() != SST::Interfaces::SimpleNetwork::Request::NONE && trace != nullptr) {
+            trace->record(TRACE_PORT_RECV, event->getTraceID(), rtr_id, port_number, curr_vc, event->getTrustedSrc(),
+                          event->getDest());
+        } else if (event->getTraceType() != SST::Interfaces::SimpleNetwork::Request::NONE) {
             output.output("TRACE(%d): %" PRIu64 " ns: Received an event on port %d in router %d"
                           " (%s) on VC %d from src %" PRIu64 " to dest %" PRIu64 ".\n",
                           event->getTraceID(), getCurrentSimTimeNano(), port_number, rtr_id, getName().c_str(), curr_vc,
@@ -823,43 +1073,33 @@ void PortControl::handle_input_r2r(Event *ev) {
     switch (base_event->getType()) {
     case BaseRtrEvent::CREDIT: {
         auto *ce = static_cast<credit_event *>(ev);
-        port_out_credits[ce->vc] += ce->credits;
+        receiveCredits(ce->vc, ce->credits);
         delete ce;
-
-        // If we're waiting, we need to send a wakeup event to the
-        // output queues
-        if (waiting) {
-            output_timing->send(1, nullptr);
-            waiting = false;
-            // If we were stalled waiting for credits and we had
-            // packets, we need to add stall time
-            if (have_packets) {
-                output_port_stalls->addData(Simulation::getSimulation()->getCurrentSimCycle() - start_block);
-            }
-        }
     } break;
     case BaseRtrEvent::PACKET:
         // This shouldn't happen
         break;
     case BaseRtrEvent::INTERNAL: {
         auto *event = static_cast<internal_router_event *>(ev);
+        if (event->getPiggybackVC() != -1) {
+            receiveCredits(event->getPiggybackVC(), event->getPiggybackCredits());
+            event->setPiggybackCredits(-1, 0);
+        }
         // Simply put the event into the right virtual network queue
 
         // Need to do the routing
         int curr_vc = event->getVC();
-        topo->route(port_number, event->getVC(), event);
-        input_buf[curr_vc].push(event);
-        input_buf_count[curr_vc]++;
-
-        // If this becomes vc_head (there isn't an event already
-        // in the array) we need to put it into the vc_heads array
-        if (vc_heads[curr_vc] == nullptr) {
-            vc_heads[curr_vc] = event;
-            parent->inc_vcs_with_data();
-        }
+        if (event->isSourceRouted())
+            event->popSourceRoute();
+        else
+            topo->route(port_number, event->getVC(), event);
+        pushInput(curr_vc, event);
         // std::cout << "Got to here 3" << std::endl;
 
-        if (event->getTraceType() != SimpleNetwork::Request::NONE) {
+        if (event->getTraceType() != SimpleNetwork::Request::NONE && trace != nullptr) {
+            trace->record(TRACE_PORT_RECV, event->getTraceID(), rtr_id, port_number, curr_vc, event->getSrc(),
+                          event->getDest());
+        } else if (event->getTraceType() != SimpleNetwork::Request::NONE) {
             output.output("TRACE(%d): %" PRIu64 " ns: Received an event on port %d in router %d"
                           " (%s) on VC %d from src %d to dest %d.\n",
                           event->getTraceID(), getCurrentSimTimeNano(), port_number, rtr_id, getName().c_str(), curr_vc,
@@ -899,6 +1139,7 @@ void PortControl::handle_output(Event * /*ev*/) {
     // If there is data in the topo_queue, it takes priority
     if (!topo_queue.empty()) {
         TopologyEvent *event = topo_queue.front();
+        topo_queue.pop();
         // Send an event to wake up again after packet is done
         output_timing->send(event->getSizeInFlits(), nullptr);
 
@@ -926,6 +1167,8 @@ void PortControl::handle_output(Event * /*ev*/) {
         // Need to return credits to the output buffer
         int size = send_event->getFlitCount();
         xbar_in_credits[vc_to_send] += size;
+        if (parent->getRequestNotifyOnCredits())
+            parent->notifyEvent();
         if (!oql_track_remote) {
             if (oql_track_port) {
                 for (int i = 0; i < num_vcs; ++i) {
@@ -936,19 +1179,31 @@ void PortControl::handle_output(Event * /*ev*/) {
             }
         }
 
-        // Send an event to wake up again after this packet is sent.
-        output_timing->send(size, nullptr);
-
         // Subtract credits
         port_out_credits[vc_to_send] -= size;
         output_buf_count[vc_to_send]++;
 
+        HopDelays *delays = send_event->getHopDelays();
+        if (delays != nullptr) {
+            if (delays->stage == HopDelays::CREDIT_STALL)
+                credit_stalled_heads--;
+            delays->enter(HopDelays::IN_FLIGHT);
+        }
+        if (!output_buf[vc_to_send].empty())
+            checkCreditStall(vc_to_send);
+
+        // Send an event to wake up again after this packet is sent.
+        output_timing->send(size, nullptr);
+
         if (is_idle) {
             idle_time->addData(Simulation::getSimulation()->getCurrentSimCycle() - idle_start);
             is_idle = false;
         }
 
-        if (send_event->getTraceType() == SimpleNetwork::Request::FULL) {
+        if (send_event->getTraceType() == SimpleNetwork::Request::FULL && trace != nullptr) {
+            trace->record(TRACE_PORT_SEND, send_event->getTraceID(), rtr_id, port_number, send_event->getVC(),
+                          send_event->getSrc(), send_event->getDest());
+        } else if (send_event->getTraceType() == SimpleNetwork::Request::FULL) {
             output.output("TRACE(%d): %" PRIu64 " ns: Sent and event to router from PortControl in router: %d"
                           " (%s) on VC %d from src %d to dest %d.\n",
                           send_event->getTraceID(), getCurrentSimTimeNano(), rtr_id, getName().c_str(),
@@ -963,10 +1218,14 @@ void PortControl::handle_output(Event * /*ev*/) {
         }
 
         if (host_port) {
+            if (credit_piggyback)
+                attachPiggybackCredits(send_event->getEncapsulatedEvent());
             port_link->send(1, send_event->getEncapsulatedEvent());
             send_event->setEncapsulatedEvent(nullptr);
             delete send_event;
         } else {
+            if (credit_piggyback)
+                attachPiggybackCredits(send_event);
             port_link->send(1, send_event);
         }
     }
@@ -39,6 +39,8 @@ class SharedRegion;
 
 namespace Merlin {
 
+class BinaryTrace;
+
 // Class to manage link between NIC and router.  A single NIC can have
 // more than one link_control (and thus link to router).
 class PortControl : public PortInterface {
@@ -59,7 +61,31 @@ class PortControl : public PortInterface {
         {"vn_remap_shm", "Name of shared memory region for vn remapping.  If empty, no remapping is done", ""},
         {"vn_remap_shm_size", "Size of shared memory region for vn remapping.  If empty, no remapping is done", "-1"},
         {"oql_track_port", ""}, {"oql_track_remote", ""},
-        {"output_arb", "Arbitration unit to be used for port output", "merlin.arb.output.basic"})
+        {"source_routing", "Compute the full path of packets entering from an endpoint, if the topology supports it.",
+         "false"},
+        {"input_queueing",
+         "Organization of the input buffers.  fifo keeps one queue per VC.  voq splits each VC into a queue per "
+         "router output port, sharing the VC's credits, so a packet waiting on a busy output doesn't block packets "
+         "behind it that are headed elsewhere.",
+         "fifo"},
+        {"router_ports", "Number of ports on the router.  Set by the router, only used with voq input_queueing.",
+         "0"},
+        {"trace_file",
+         "Prefix of the binary trace files for traced packets.  If empty, traced packets are printed as TRACE lines "
+         "instead.",
+         ""},
+        {"output_arb", "Arbitration unit to be used for port output", "merlin.arb.output.basic"},
+        {"credit_return_flits",
+         "Number of flits of credit to accumulate for a VC before returning them upstream.  1 returns credits for "
+         "every packet.",
+         "1"},
+        {"credit_return_window",
+         "Maximum number of flit cycles returned credits are held before being sent, regardless of "
+         "credit_return_flits.  This bounds how late credits arrive upstream compared to returning them per "
+         "packet.  Defaults to credit_return_flits.",
+         ""},
+        {"credit_piggyback", "Attach held credits to data packets going upstream instead of sending them separately.",
+         "false"})
 
     // SST_ELI_DOCUMENT_STATISTICS(
     //     { "packet_latency",     "Histogram of latencies for received packets", "latency", 1},
@@ -128,6 +154,27 @@ class PortControl : public PortInterface {
     port_queue_t *input_buf;
     port_queue_t *output_buf;
 
+    // Virtual output queueing.  With voq set, the input buffer of
+    // each VC is split into one queue per router output port, indexed
+    // by vc * num_router_ports + port and using the port the packet
+    // is routed to.  The queues of a VC share its credits.
+    // vc_heads[vc] holds the head of one of them, which
+    // selectVOQHeads() moves to a queue whose output can take its
+    // packet, so a blocked packet doesn't hold up the ones behind it.
+    bool voq;
+    int num_router_ports;
+    port_queue_t *voq_buf;
+    // Number of packets in all the queues of each VC
+    int *voq_count;
+    // Queue the head of each VC comes from, and where the round robin
+    // search for the next head starts
+    int *voq_head_port;
+    int *voq_rr;
+
+    // Number of output VC heads whose HopDelays are in CREDIT_STALL,
+    // so credit returns only look for them when there are some
+    int credit_stalled_heads;
+
     // Need an output queue for topology events.  Incoming topology
     // events will be directed right to the topolgy object.
     topo_queue_t topo_queue;
@@ -157,6 +204,11 @@ class PortControl : public PortInterface {
     // from next router.
     bool oql_track_remote;
 
+    // If true, packets from endpoints get their whole path from the
+    // topology when they enter the network and later routers don't
+    // route them.
+    bool source_routing;
+
     // Variables to keep track of credits.  You need to keep track of
     // the credits available for your next buffer, as well as track
     // the credits you need to return to the buffer sending data to
@@ -166,6 +218,18 @@ class PortControl : public PortInterface {
     int *port_ret_credits;
     int *port_out_credits;
 
+    // Credit return coalescing.  Credits for a VC are held in
+    // port_ret_credits until credit_return_flits of them have built
+    // up, or until credit_return_window flit cycles after the first
+    // one was held, whichever comes first.  The window guarantees
+    // held credits always make it back, so a sender waiting on them
+    // can't deadlock.
+    int credit_return_flits;
+    int credit_return_window;
+    bool credit_piggyback;
+    bool credit_flush_scheduled;
+    Link *credit_timing;
+
     // Represents the start of when a port was idle
     // If the buffer was empty we instantiate this to the current time
     SimTime_t idle_start;
@@ -225,6 +289,9 @@ class PortControl : public PortInterface {
 
     SharedRegion *shared_region;
 
+    // Binary trace for traced packets, or nullptr to print them
+    BinaryTrace *trace;
+
   public:
     void sendTopologyEvent(TopologyEvent *ev) override;
     // Returns true if there is space in the output buffer and false
@@ -237,6 +304,7 @@ class PortControl : public PortInterface {
     // the next event.
     internal_router_event *recv(int vc) override;
     internal_router_event **getVCHeads() override { return vc_heads; }
+    void selectVOQHeads(PortInterface **ports, const int *out_port_busy) override;
 
     // time_base is a frequency which represents the bandwidth of the link in flits/second.
     PortControl(ComponentId_t cid, Params &params, Router *rif, int rtr_id, int port_number, Topology *topo);
@@ -268,9 +336,22 @@ class PortControl : public PortInterface {
     void dumpQueueState(port_queue_t &q, std::ostream &stream);
     void dumpQueueState(port_queue_t &q, Output &out);
 
+    void pushInput(int vc, internal_router_event *ev);
+    // Starts the crossbar wait of a packet that just became a VC head
+    inline void startXbarWait(internal_router_event *ev) {
+        HopDelays *delays = ev->getHopDelays();
+        if (delays != nullptr && delays->stage == HopDelays::INPUT_QUEUE)
+            delays->enter(HopDelays::XBAR_WAIT);
+    }
+    void checkCreditStall(int vc);
+    void releaseCreditStalls();
     void handle_input_n2r(Event *ev);
     void handle_input_r2r(Event *ev);
     void handle_output(Event *ev);
+    void handle_credit_flush(Event *ev);
+    void returnCredits(int vc);
+    void attachPiggybackCredits(BaseRtrEvent *ev);
+    void receiveCredits(int vc, int credits);
     void handleSAIWindow(Event *ev);
     void reenablePort(Event *ev);
 
@@ -26,6 +26,9 @@
 #include "hr_router/xbar_arb_age.h"
 #include "hr_router/xbar_arb_rand.h"
 #include "hr_router/xbar_arb_lru_infx.h"
+#include "hr_router/xbar_arb_lru_sparse.h"
+#include "hr_router/xbar_arb_islip.h"
+#include "hr_router/xbar_arb_wavefront.h"
 
 #include "arbitration/single_arb_rr.h"
 #include "arbitration/single_arb_lru.h"
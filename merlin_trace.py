@@ -0,0 +1,114 @@
+#!/usr/bin/env python
+#
+# Copyright 2009-2020 NTESS. Under the terms
+# of Contract DE-NA0003525 with NTESS, the U.S.
+# Government retains certain rights in this software.
+#
+# Copyright (c) 2009-2020, NTESS
+# All rights reserved.
+#
+# Portions are copyright of other developers:
+# See the file CONTRIBUTORS.TXT in the top level directory
+# the distribution for more information.
+#
+# This file is part of the SST software package. For license
+# information, see the LICENSE file in the top level directory of the
+# distribution.
+
+# Decodes the binary packet traces written when trace_file is set on
+# hr_router or LinkControl (see binary_trace.h for the format).  The
+# records from all the files given are merged in time order and
+# written as text, one line per record, or as Chrome trace event JSON
+# that can be loaded into chrome://tracing or Perfetto.
+#
+#   merlin_trace.py [--format text|chrome] [-o out] trace.*.bin
+
+from __future__ import print_function
+
+import argparse
+import json
+import struct
+import sys
+
+HEADER = struct.Struct("<8sIIQII")
+RECORD = struct.Struct("<QiiiihhB3x")
+
+KINDS = ["nic_send", "nic_inject", "port_recv", "xbar", "port_send", "nic_recv", "nic_deliver"]
+NIC_KINDS = set(["nic_send", "nic_inject", "nic_recv", "nic_deliver"])
+
+
+def read_trace(path):
+    with open(path, "rb") as f:
+        header = f.read(HEADER.size)
+        if len(header) != HEADER.size:
+            sys.exit("%s: too short to be a merlin trace" % path)
+        magic, version, record_size, fs_per_cycle, rank, thread = HEADER.unpack(header)
+        if magic.rstrip(b"\0") != b"MRLNTRC" or version != 1 or record_size != RECORD.size:
+            sys.exit("%s: not a version 1 merlin trace" % path)
+        records = []
+        data = f.read()
+        for off in range(0, len(data) - len(data) % RECORD.size, RECORD.size):
+            time, trace_id, location, src, dest, port, vc, kind = RECORD.unpack_from(data, off)
+            records.append((time * fs_per_cycle / 1e6, trace_id, KINDS[kind], location, port, vc, src, dest))
+        return records
+
+
+def write_text(records, out):
+    for ns, trace_id, kind, location, port, vc, src, dest in records:
+        if kind in NIC_KINDS:
+            where = "nic %d vn %d" % (location, vc)
+        else:
+            where = "router %d port %d vc %d" % (location, port, vc)
+        out.write("TRACE(%d): %.3f ns: %s at %s, src %d, dest %d\n" % (trace_id, ns, kind, where, src, dest))
+
+
+def write_chrome(records, out):
+    # Each record is a zero length slice on the port (or NIC) it
+    # happened at, and the records of a packet are chained together
+    # with flow events so the path can be followed across routers.
+    events = []
+    seen = set()
+    for ns, trace_id, kind, location, port, vc, src, dest in records:
+        if kind in NIC_KINDS:
+            pid, tid = "nic %d" % location, "vn %d" % vc
+        else:
+            pid, tid = "router %d" % location, "port %d" % port
+        us = ns / 1000.0
+        events.append({"name": kind, "cat": "packet", "ph": "X", "ts": us, "dur": 0, "pid": pid, "tid": tid,
+                       "args": {"trace_id": trace_id, "src": src, "dest": dest, "vc": vc}})
+        if trace_id in seen:
+            events.append({"name": "packet", "cat": "packet", "ph": "t" if kind != "nic_deliver" else "f",
+                           "bp": "e", "id": trace_id, "ts": us, "pid": pid, "tid": tid})
+        else:
+            events.append({"name": "packet", "cat": "packet", "ph": "s", "id": trace_id, "ts": us, "pid": pid,
+                           "tid": tid})
+        seen.add(trace_id)
+    json.dump({"traceEvents": events, "displayTimeUnit": "ns"}, out)
+    out.write("\n")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Decode merlin binary packet traces")
+    parser.add_argument("files", nargs="+", help="trace files written by merlin")
+    parser.add_argument("--format", choices=["text", "chrome"], default="text")
+    parser.add_argument("-o", "--output", help="output file (default stdout)")
+    args = parser.parse_args()
+
+    records = []
+    for path in args.files:
+        records.extend(read_trace(path))
+    # Stable sort, so records at the same time stay in the order they
+    # were written
+    records.sort(key=lambda r: r[0])
+
+    out = open(args.output, "w") if args.output else sys.stdout
+    if args.format == "text":
+        write_text(records, out)
+    else:
+        write_chrome(records, out)
+    if args.output:
+        out.close()
+
+
+if __name__ == "__main__":
+    main()
@@ -23,7 +23,10 @@
 using namespace SST::Merlin;
 using namespace SST::Interfaces;
 
-OfferedLoad::OfferedLoad(ComponentId_t cid, Params &params) : Component(cid), next_time(0), generation(0), id(-1) {
+OfferedLoad::OfferedLoad(ComponentId_t cid, Params &params)
+    : Component(cid), next_time(0), generation(0), id(-1), search(false), waiting_for_load(false),
+      search_done(false), search_pending(0), search_sum(0), search_count(0), search_backup(0), search_lo(0),
+      search_hi(0), search_hi_saturated(false), base_latency(0) {
 
     out.init(getName() + ": ", 0, 0, Output::STDOUT);
 
@@ -37,6 +40,28 @@ OfferedLoad::OfferedLoad(ComponentId_t cid, Params &params) : Component(cid), ne
         }
     }
 
+    search = params.find<bool>("saturation_search", false);
+    if (search) {
+        search_min = params.find<double>("saturation_search_min", 0.05);
+        search_max = params.find<double>("saturation_search_max", 1.0);
+        if (search_min <= 0 || search_min >= search_max || search_max > 1.0) {
+            out.fatal(CALL_INFO, -1,
+                      "saturation_search_min and saturation_search_max must satisfy 0 < min < max <= 1.0\n");
+        }
+        search_tolerance = params.find<double>("saturation_search_tolerance", 0.01);
+        if (search_tolerance <= 0) {
+            out.fatal(CALL_INFO, -1, "saturation_search_tolerance must be greater than 0\n");
+        }
+        latency_factor = params.find<double>("saturation_latency_factor", 3.0);
+        if (latency_factor <= 1.0) {
+            out.fatal(CALL_INFO, -1, "saturation_latency_factor must be greater than 1\n");
+        }
+        search_hi = search_max;
+        // The rest of the loads are filled in as the search goes
+        offered_load.clear();
+        offered_load.push_back(search_min);
+    }
+
     if (offered_load.empty()) {
         out.fatal(CALL_INFO, -1, "offered_load must be set!\n");
     }
@@ -133,6 +158,9 @@ OfferedLoad::OfferedLoad(ComponentId_t cid, Params &params) : Component(cid), ne
 
     end_link = configureSelfLink("end_link", base_tc, new Event::Handler<OfferedLoad>(this, &OfferedLoad::end_handler));
 
+    control_link = configureSelfLink("control_link", base_tc,
+                                     new Event::Handler<OfferedLoad>(this, &OfferedLoad::control_timing));
+
     complete_event.push_back(new offered_load_complete_event(generation));
 
     // out.output("send_interval = %llu\n",send_interval);
@@ -173,6 +201,15 @@ void OfferedLoad::finish() {
                 out.output("\n");
         }
         out.output("\n");
+
+        if (search) {
+            if (!search_hi_saturated)
+                out.output("Not saturated at the maximum offered load searched, %.4f\n\n", search_max);
+            else if (search_lo == 0)
+                out.output("Saturated at the minimum offered load searched, %.4f\n\n", search_min);
+            else
+                out.output("Saturation point is between offered loads %.4f and %.4f\n\n", search_lo, search_hi);
+        }
     }
 }
 
@@ -199,50 +236,65 @@ void OfferedLoad::init(unsigned int phase) {
         packetDestGen = loadAnonymousSubComponent<TargetGenerator>(pattern, "pattern_gen", 0, ComponentInfo::SHARE_NONE,
                                                                    *pattern_params, id, num_peers);
         delete pattern_params;
+        if (search) {
+            search_tree.init(id, num_peers, 1);
+            start_search_round();
+        }
     }
 }
 
 void OfferedLoad::complete(unsigned int phase) {
     link_if->complete(phase);
 
-    if (id == 0) {
-        SimpleNetwork::Request *req = link_if->recvUntimedData();
-        while (req != nullptr) {
-            auto *ev = static_cast<offered_load_complete_event *>(req->takePayload());
-            int generation = ev->generation;
-            complete_event[generation]->sum += ev->sum;
-            complete_event[generation]->sum_of_squares += ev->sum_of_squares;
-            complete_event[generation]->min =
-                ev->min < complete_event[generation]->min ? ev->min : complete_event[generation]->min;
-            complete_event[generation]->max =
-                ev->max > complete_event[generation]->max ? ev->max : complete_event[generation]->max;
-            complete_event[generation]->count += ev->count;
-            complete_event[generation]->backup += ev->backup;
-
-            req = link_if->recvUntimedData();
-        }
-    } else {
-        if (phase == 0) {
-            for (auto ev : complete_event) {
-                link_if->sendUntimedData(new SimpleNetwork::Request(0, id, 0, true, true, ev));
-            }
+    // Results are reduced to endpoint 0 over a binomial tree, one
+    // payload per generation
+    if (phase == 0)
+        reduction.init(id, num_peers, complete_event.size());
+    bool ready = reduction.progress(
+        link_if, [this](Event *ev) { merge_results(static_cast<offered_load_complete_event *>(ev)); });
+    if (ready && !reduction.isRoot()) {
+        for (auto ev : complete_event) {
+            reduction.send(link_if, ev->clone());
         }
     }
 }
 
+void OfferedLoad::merge_results(offered_load_complete_event *ev) {
+    offered_load_complete_event *local = complete_event[ev->generation];
+    local->sum += ev->sum;
+    local->sum_of_squares += ev->sum_of_squares;
+    local->min = ev->min < local->min ? ev->min : local->min;
+    local->max = ev->max > local->max ? ev->max : local->max;
+    local->count += ev->count;
+    local->backup += ev->backup;
+    delete ev;
+}
+
 bool OfferedLoad::handle_receives(int vn) {
     SimpleNetwork::Request *req = link_if->recv(vn);
     if (req->dest != id) {
         out.fatal(CALL_INFO, -1, "Endpoint %d received a packet intended for %lld\n", id, req->dest);
     }
     if (req != nullptr) {
+        // Every payload is an offered_load_event, control packets
+        // included
+        auto *payload = static_cast<offered_load_event *>(req->inspectPayload());
+        if (payload->control) {
+            auto *ctrl = static_cast<offered_load_search_event *>(payload);
+            if (ctrl->decision)
+                apply_next_load(ctrl->next_load);
+            else
+                add_search_results(ctrl->sum, ctrl->count, ctrl->backup);
+            delete req;
+            return true;
+        }
         SimTime_t current_time = getCurrentSimTime(base_tc);
         // Don't start counting until after warmup.  This is stored in
         // start_time.
         if (start_time <= current_time) {
 
             // Get the latency and add it to the complete_event)
-            SimTime_t latency = current_time - ((offered_load_event *)req->inspectPayload())->start_time;
+            SimTime_t latency = current_time - payload->start_time;
 
             complete_event[generation]->sum += latency;
             complete_event[generation]->sum_of_squares += (latency * latency);
@@ -300,7 +352,7 @@ void OfferedLoad::output_timing(Event * /*ev*/) {
 
 void OfferedLoad::progress_messages(SimTime_t current_time) {
     // TraceFunction trace(CALL_INFO);
-    while ((next_time <= current_time) && link_if->spaceToSend(0, packet_size)) {
+    while (!waiting_for_load && (next_time <= current_time) && link_if->spaceToSend(0, packet_size)) {
         // trace.getOutput().output("loop start: %p, %p\n",packetDestGen, link_if);
         auto *ev = new offered_load_event(next_time);
         // trace.getOutput().output("  loop middle 1\n");
@@ -313,6 +365,8 @@ void OfferedLoad::progress_messages(SimTime_t current_time) {
 }
 
 void OfferedLoad::end_handler(Event * /*ev*/) {
+    if (search_done)
+        return;
 
     // Compute backup metric and put it in event
     SimTime_t current_time = getCurrentSimTime(base_tc);
@@ -323,13 +377,12 @@ void OfferedLoad::end_handler(Event * /*ev*/) {
         complete_event[generation]->backup = current_time - next_time;
     }
 
-    // See if we are done
-    if (complete_event.size() == offered_load.size()) {
-        primaryComponentOKToEndSim();
-    } else {
-
-        // Need to set things up for the next iteration
-        SimTime_t current_time = getCurrentSimTime(base_tc);
+    if (!search) {
+        // See if we are done
+        if (complete_event.size() == offered_load.size()) {
+            primaryComponentOKToEndSim();
+            return;
+        }
 
         // Add a new complete_event entry and increment generation
         // count
@@ -340,19 +393,30 @@ void OfferedLoad::end_handler(Event * /*ev*/) {
         // one packet and dividing by the offered_load
         UnitAlgebra interval = serialization_time / offered_load[generation];
         send_interval = interval.getRoundedValue();
+    }
 
-        // Compute the next time to send a packet.  We'll wait for
-        // the drain_time so the network is empty.
-        next_time = current_time + drain_time;
+    // Need to set things up for the next iteration
 
-        // Compute the new start_time for recording values (after the
-        // warm up period)
-        start_time = next_time + warmup_time;
+    // Compute the next time to send a packet.  We'll wait for
+    // the drain_time so the network is empty.
+    next_time = current_time + drain_time;
 
-        // Need to send the next event to end this round.  The total
-        // time to the next ending is drain_time + warmup_time +
-        // collect_time
-        end_link->send(drain_time + warmup_time + collect_time, nullptr);
+    // Compute the new start_time for recording values (after the
+    // warm up period)
+    start_time = next_time + warmup_time;
+
+    // Need to send the next event to end this round.  The total
+    // time to the next ending is drain_time + warmup_time +
+    // collect_time
+    end_link->send(drain_time + warmup_time + collect_time, nullptr);
+
+    if (search) {
+        // The next load isn't known until the results from every
+        // endpoint have made it to endpoint 0 and the decision has
+        // made it back, which all has to happen during the drain
+        waiting_for_load = true;
+        offered_load_complete_event *results = complete_event[generation];
+        add_search_results(results->sum, results->count, results->backup);
     }
 
     // if ( id == 0 ) {
@@ -364,3 +428,94 @@ void OfferedLoad::end_handler(Event * /*ev*/) {
     //     out.output("  next end is %llu from now\n",drain_time+warmup_time+collect_time);
     // }
 }
+
+void OfferedLoad::start_search_round() {
+    search_pending = search_tree.getChildren().size() + 1;
+    search_sum = 0;
+    search_count = 0;
+    search_backup = 0;
+}
+
+// Adds the results for the round from this endpoint or one of its
+// children.  Once they are all in, they go up the tree, or endpoint 0
+// picks the next load.
+void OfferedLoad::add_search_results(SimTime_t sum, uint64_t count, SimTime_t backup) {
+    search_sum += sum;
+    search_count += count;
+    search_backup += backup;
+    if (--search_pending > 0)
+        return;
+
+    if (search_tree.isRoot())
+        apply_next_load(decide_next_load());
+    else
+        send_control(search_tree.getParent(), new offered_load_search_event(search_sum, search_count, search_backup));
+}
+
+// Returns the next load to run, or 0 if the search is done
+double OfferedLoad::decide_next_load() {
+    double load = offered_load[generation];
+    bool saturated = search_backup > 0 || search_count == 0;
+    double latency = search_count == 0 ? 0 : (double)search_sum / search_count;
+    if (generation == 0)
+        base_latency = latency;
+    else if (latency > latency_factor * base_latency)
+        saturated = true;
+
+    if (saturated) {
+        search_hi = load;
+        search_hi_saturated = true;
+    } else {
+        search_lo = load;
+    }
+
+    if (generation == 0)
+        return saturated ? 0 : search_max;
+    if (!search_hi_saturated || search_hi - search_lo <= search_tolerance)
+        return 0;
+    return (search_lo + search_hi) / 2;
+}
+
+void OfferedLoad::apply_next_load(double next_load) {
+    for (int child : search_tree.getChildren()) {
+        send_control(child, new offered_load_search_event(next_load));
+    }
+
+    if (next_load <= 0) {
+        search_done = true;
+        primaryComponentOKToEndSim();
+        return;
+    }
+
+    if (getCurrentSimTime(base_tc) >= next_time) {
+        out.fatal(CALL_INFO, -1,
+                  "saturation_search: the load for round %d arrived after drain_time was over.  Increase "
+                  "drain_time.\n",
+                  generation + 1);
+    }
+    offered_load.push_back(next_load);
+    complete_event.push_back(new offered_load_complete_event(++generation));
+    UnitAlgebra interval = serialization_time / next_load;
+    send_interval = interval.getRoundedValue();
+    start_search_round();
+    waiting_for_load = false;
+}
+
+void OfferedLoad::send_control(int dest, offered_load_search_event *ev) {
+    control_queue.push(new SimpleNetwork::Request(dest, id, packet_size, true, true, ev));
+    if (control_queue.size() == 1)
+        control_timing(nullptr);
+}
+
+// Sends the queued control packets.  If the LinkControl is full, try
+// again after a packet's worth of serialization time.
+void OfferedLoad::control_timing(Event * /*ev*/) {
+    while (!control_queue.empty() && link_if->spaceToSend(0, packet_size)) {
+        link_if->send(control_queue.front(), 0);
+        control_queue.pop();
+    }
+    if (!control_queue.empty()) {
+        SimTime_t retry = serialization_time.getRoundedValue();
+        control_link->send(retry > 0 ? retry : 1, nullptr);
+    }
+}
@@ -33,6 +33,9 @@
 #include <sst/core/output.h>
 #include "sst/core/interfaces/simpleNetwork.h"
 
+#include <queue>
+
+#include "../reduction_tree.h"
 #include "../target_generator/target_generator.h"
 
 namespace SST {
@@ -41,15 +44,19 @@ namespace Merlin {
 class offered_load_event : public Event {
   public:
     SimTime_t start_time;
+    // Set for offered_load_search_event, so the receiver can tell the
+    // packets apart without a dynamic_cast
+    bool control;
 
-    offered_load_event() : Event() {}
-    offered_load_event(SimTime_t start_time) : Event(), start_time(start_time) {}
+    offered_load_event() : Event(), start_time(0), control(false) {}
+    offered_load_event(SimTime_t start_time) : Event(), start_time(start_time), control(false) {}
 
     ~offered_load_event() override = default;
 
     void serialize_order(SST::Core::Serialization::serializer &ser) override {
         Event::serialize_order(ser);
         ser &start_time;
+        ser &control;
     }
 
   private:
@@ -93,6 +100,46 @@ class offered_load_complete_event : public Event {
     ImplementSerializable(SST::Merlin::offered_load_complete_event)
 };
 
+// Control packet for saturation_search.  Results for a generation go
+// up the ReductionTree to endpoint 0, and the load to run next comes
+// back down it.
+class offered_load_search_event : public offered_load_event {
+  public:
+    bool decision;
+    // Next offered load, or 0 when the search is done
+    double next_load;
+    SimTime_t sum;
+    uint64_t count;
+    SimTime_t backup;
+
+    offered_load_search_event(double next_load)
+        : offered_load_event(), decision(true), next_load(next_load), sum(0), count(0), backup(0) {
+        control = true;
+    }
+    offered_load_search_event(SimTime_t sum, uint64_t count, SimTime_t backup)
+        : offered_load_event(), decision(false), next_load(0), sum(sum), count(count), backup(backup) {
+        control = true;
+    }
+
+    ~offered_load_search_event() override = default;
+
+    offered_load_search_event *clone() override { return new offered_load_search_event(*this); }
+
+    void serialize_order(SST::Core::Serialization::serializer &ser) override {
+        offered_load_event::serialize_order(ser);
+        ser &decision;
+        ser &next_load;
+        ser &sum;
+        ser &count;
+        ser &backup;
+    }
+
+  private:
+    offered_load_search_event() : offered_load_event() {}
+
+    ImplementSerializable(SST::Merlin::offered_load_search_event)
+};
+
 class OfferedLoad : public Component {
 
   public:
@@ -108,10 +155,26 @@ class OfferedLoad : public Component {
                             {"buffer_size", "Size of input and output buffers.", "1kB"},
                             {"packet_size", "Packet size specified in either b or B (can include SI prefix).", "32B"},
                             {"pattern", "Traffic pattern to use.", "merlin.targetgen.uniform"},
-                            {"offered_load", "Load to be offered to network.  Valid range: 0 < offered_load <= 1.0."},
+                            {"offered_load",
+                             "Load to be offered to network.  Valid range: 0 < offered_load <= 1.0.  Not used with "
+                             "saturation_search."},
                             {"warmup_time", "Time to wait before recording latencies", "1us"},
                             {"collect_time", "Time to collect data after warmup", "20us"},
-                            {"drain_time", "Time to drain network before stating next round", "50us"}, )
+                            {"drain_time", "Time to drain network before stating next round", "50us"},
+                            {"saturation_search",
+                             "Bisect on offered load to find the saturation point instead of running the offered_load "
+                             "list.  The first round runs at saturation_search_min, and its latency is the baseline.  "
+                             "A round is saturated if any endpoint backed up or the average latency is more than "
+                             "saturation_latency_factor times the baseline.  The decision for each round is made "
+                             "during drain_time.",
+                             "false"},
+                            {"saturation_search_min", "Lowest offered load searched.  Must not saturate.", "0.05"},
+                            {"saturation_search_max", "Highest offered load searched.", "1.0"},
+                            {"saturation_search_tolerance",
+                             "Stop once the saturation point is bracketed to within this much offered load.", "0.01"},
+                            {"saturation_latency_factor",
+                             "Average latency, relative to the baseline, above which a round counts as saturated.",
+                             "3.0"}, )
 
     SST_ELI_DOCUMENT_PORTS({"rtr", "Port that hooks up to router.", {"merlin.RtrEvent", "merlin.credit_event"}})
 
@@ -161,6 +224,33 @@ class OfferedLoad : public Component {
     // Generator *packetDelayGen;
 
     std::vector<offered_load_complete_event *> complete_event;
+    ReductionTree reduction;
+
+    // Saturation search.  Between the end of a round and the decision
+    // for the next, waiting_for_load holds off sending.
+    bool search;
+    bool waiting_for_load;
+    bool search_done;
+    double search_min;
+    double search_max;
+    double search_tolerance;
+    double latency_factor;
+    ReductionTree search_tree;
+    // Results for the current round, from this endpoint and the part
+    // of the tree below it
+    int search_pending;
+    SimTime_t search_sum;
+    uint64_t search_count;
+    SimTime_t search_backup;
+    // Only used on endpoint 0.  search_lo is the highest load known
+    // not to saturate and search_hi the lowest known to.
+    double search_lo;
+    double search_hi;
+    bool search_hi_saturated;
+    double base_latency;
+    // Control packets waiting for room in the LinkControl
+    std::queue<SST::Interfaces::SimpleNetwork::Request *> control_queue;
+    Link *control_link;
 
   public:
     OfferedLoad(ComponentId_t cid, Params &params);
@@ -179,6 +269,14 @@ class OfferedLoad : public Component {
     void progress_messages(SimTime_t current_time);
 
     void end_handler(Event *ev);
+    void merge_results(offered_load_complete_event *ev);
+
+    void start_search_round();
+    void add_search_results(SimTime_t sum, uint64_t count, SimTime_t backup);
+    double decide_next_load();
+    void apply_next_load(double next_load);
+    void send_control(int dest, offered_load_search_event *ev);
+    void control_timing(Event *ev);
 };
 
 } // namespace Merlin
@@ -239,7 +239,7 @@ class hr_router(RouterTemplate):
     def __init__(self):
         RouterTemplate.__init__(self)
         self._defineRequiredParams(["link_bw","flit_size","xbar_bw","input_latency","output_latency","input_buf_size","output_buf_size"])
-        self._defineOptionalParams(["xbar_arb","network_inspectors","oql_track_port","oql_track_remote","num_vns","vn_remap","vn_remap_shm"])
+        self._defineOptionalParams(["xbar_arb","xbar_mode","network_inspectors","oql_track_port","oql_track_remote","source_routing","input_queueing","trace_file","num_vns","vn_remap","vn_remap_shm"])
     def instanceRouter(self, name):
         rtr = sst.Component(name, "merlin.hr_router")
         rtr.addParams(self._params)
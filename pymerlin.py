@@ -110,7 +110,7 @@ class topoTorus(Topo):
     def __init__(self):
         Topo.__init__(self)
         self.topoKeys.extend(["topology", "debug", "num_ports", "flit_size", "link_bw", "xbar_bw", "torus:shape", "torus:width", "torus:local_ports","input_latency","output_latency","input_buf_size","output_buf_size"])
-        self.topoOptKeys.extend(["xbar_arb","num_vns","vn_remap","vn_remap_shm","portcontrol:output_arb","portcontrol:arbitration:qos_settings","portcontrol:arbitration:arb_vns","portcontrol:arbitration:arb_vcs"])
+        self.topoOptKeys.extend(["xbar_arb","num_vns","vn_remap","vn_remap_shm","portcontrol:output_arb","portcontrol:arbitration:qos_settings","portcontrol:arbitration:arb_vns","portcontrol:arbitration:arb_vcs","torus:algorithm"])
     def getName(self):
         return "Torus"
     def prepParams(self):
@@ -179,7 +179,7 @@ class topoTorus(Topo):
                 links[name] = sst.Link(name)
             return links[name]
 
-        swap_keys = [("torus:shape","shape"),("torus:width","width"),("torus:local_ports","local_ports")]
+        swap_keys = [("torus:shape","shape"),("torus:width","width"),("torus:local_ports","local_ports"),("torus:algorithm","algorithm")]
 
         _topo_params = _params.subsetWithRename(swap_keys);
 
@@ -228,7 +228,7 @@ class topoMesh(Topo):
     def __init__(self):
         Topo.__init__(self)
         self.topoKeys = ["topology", "debug", "num_ports", "flit_size", "link_bw", "xbar_bw", "mesh:shape", "mesh:width", "mesh:local_ports","input_latency","output_latency","input_buf_size","output_buf_size"]
-        self.topoOptKeys = ["xbar_arb","num_vns","vn_remap","vn_remap_shm","portcontrol:output_arb","portcontrol:arbitration:qos_settings","portcontrol:arbitration:arb_vns","portcontrol:arbitration:arb_vcs"]
+        self.topoOptKeys = ["xbar_arb","num_vns","vn_remap","vn_remap_shm","portcontrol:output_arb","portcontrol:arbitration:qos_settings","portcontrol:arbitration:arb_vns","portcontrol:arbitration:arb_vcs","mesh:algorithm"]
     def getName(self):
         return "Mesh"
     def prepParams(self):
@@ -297,7 +297,7 @@ class topoMesh(Topo):
                 links[name] = sst.Link(name)
             return links[name]
 
-        swap_keys = [("mesh:shape","shape"),("mesh:width","width"),("mesh:local_ports","local_ports")]
+        swap_keys = [("mesh:shape","shape"),("mesh:width","width"),("mesh:local_ports","local_ports"),("mesh:algorithm","algorithm")]
 
         _topo_params = _params.subsetWithRename(swap_keys);
 
@@ -795,7 +795,7 @@ class topoDragonFly(Topo):
 
         #########################
 
-        swap_keys = [("dragonfly:hosts_per_router","hosts_per_router"),("dragonfly:routers_per_group","routers_per_group"),("dragonfly:intergroup_links","intergroup_links"),("dragonfly:num_groups","num_groups"),("dragonfly:intergroup_per_router","intergroup_per_router"),("dragonfly:algorithm","algorithm"),("dragonfly:global_route_mode","global_route_mode"),("dragonfly:adaptive_threshold","adaptive_threshold")]
+        swap_keys = [("dragonfly:hosts_per_router","hosts_per_router"),("dragonfly:routers_per_group","routers_per_group"),("dragonfly:intergroup_links","intergroup_links"),("dragonfly:num_groups","num_groups"),("dragonfly:intergroup_per_router","intergroup_per_router"),("dragonfly:algorithm","algorithm"),("dragonfly:global_route_mode","global_route_mode"),("dragonfly:adaptive_threshold","adaptive_threshold"),("dragonfly:routing_table","routing_table"),("dragonfly:gossip_period","gossip_period"),("dragonfly:gossip_flits","gossip_flits")]
 
         _topo_params = _params.subsetWithRename(swap_keys);
 
@@ -1056,7 +1056,7 @@ class topoDragonFly2(Topo):
         #_topo_params["global_route_mode"] = _params["dragonfly:global_route_mode"]
         #_topo_params["adaptive_threshold"] = _params["dragonfly:adaptive_threshold"]
 
-        swap_keys = [("dragonfly:hosts_per_router","hosts_per_router"),("dragonfly:routers_per_group","routers_per_group"),("dragonfly:intergroup_links","intergroup_links"),("dragonfly:num_groups","num_groups"),("dragonfly:intergroup_per_router","intergroup_per_router"),("dragonfly:algorithm","algorithm"),("dragonfly:global_route_mode","global_route_mode"),("dragonfly:adaptive_threshold","adaptive_threshold")]
+        swap_keys = [("dragonfly:hosts_per_router","hosts_per_router"),("dragonfly:routers_per_group","routers_per_group"),("dragonfly:intergroup_links","intergroup_links"),("dragonfly:num_groups","num_groups"),("dragonfly:intergroup_per_router","intergroup_per_router"),("dragonfly:algorithm","algorithm"),("dragonfly:global_route_mode","global_route_mode"),("dragonfly:adaptive_threshold","adaptive_threshold"),("dragonfly:routing_table","routing_table")]
 
         _topo_params = _params.subsetWithRename(swap_keys);
 
@@ -1109,6 +1109,155 @@ class topoDragonFly2(Topo):
 
 
 
+class topoSlimFly(Topo):
+    def __init__(self):
+        Topo.__init__(self)
+        self.topoKeys = ["topology", "debug", "num_ports", "flit_size", "link_bw", "xbar_bw", "slimfly:q", "slimfly:hosts_per_router","input_latency","output_latency","input_buf_size","output_buf_size"]
+        self.topoOptKeys = ["xbar_arb","num_vns","vn_remap","vn_remap_shm","portcontrol:output_arb","portcontrol:arbitration:qos_settings","portcontrol:arbitration:arb_vns","portcontrol:arbitration:arb_vcs"]
+
+    def getName(self):
+        return "Slim Fly"
+
+    def prepParams(self):
+        _params["topology"] = "merlin.slimfly"
+        _params["debug"] = debug
+        _params["slimfly:q"] = int(_params["slimfly:q"])
+        _params["slimfly:hosts_per_router"] = int(_params["slimfly:hosts_per_router"])
+        q = _params["slimfly:q"]
+        if q < 3 or q % 4 == 2:
+            print("Slim Fly needs q to be a prime power of at least 3")
+            sys.exit(1)
+        delta = {1: 1, 3: -1, 0: 0}[q % 4]
+        self.router_ports = (3 * q - delta) // 2
+        _params["router_radix"] = _params["slimfly:hosts_per_router"] + self.router_ports
+        _params["num_ports"] = int(_params["router_radix"])
+        _params["num_peers"] = 2 * q * q * _params["slimfly:hosts_per_router"]
+
+    # Same construction as topo_slimfly in topology/slimfly.cc.  The
+    # two have to agree exactly, since the port a link is on is
+    # determined by the order of the neighbors.  The slimfly benches
+    # in test/bench/merlin_verify.py check that they do.
+    def _buildField(self, q):
+        p = 2
+        while q % p != 0:
+            p = p + 1
+        e = 0
+        t = q
+        while t > 1:
+            if t % p != 0:
+                print("Slim Fly needs q to be a prime power")
+                sys.exit(1)
+            t = t // p
+            e = e + 1
+
+        def digits(a):
+            return [(a // p**i) % p for i in range(e)]
+        def undigits(d):
+            return sum(d[i] * p**i for i in range(e))
+
+        add = [[undigits([(x + y) % p for x, y in zip(digits(a), digits(b))]) for b in range(q)] for a in range(q)]
+        sub = [[undigits([(x - y) % p for x, y in zip(digits(a), digits(b))]) for b in range(q)] for a in range(q)]
+
+        # Search for a primitive element.  For a prime field, try each
+        # element in turn.  Otherwise use x, and try each monic degree
+        # e polynomial as the modulus until x generates the field.
+        powers = None
+        for candidate in range(1, q):
+            pw = [1]
+            val = 1
+            while True:
+                if e == 1:
+                    val = (val * candidate) % p
+                else:
+                    top = val // (q // p)
+                    shifted = digits((val % (q // p)) * p)
+                    c = digits(candidate)
+                    val = undigits([(shifted[i] - top * c[i]) % p for i in range(e)])
+                if val == 1 or len(pw) == q:
+                    break
+                pw.append(val)
+            if len(pw) == q - 1 and val == 1:
+                powers = pw
+                break
+        if powers is None:
+            print("Unable to find a primitive element of GF(%d)"%q)
+            sys.exit(1)
+
+        log = [0] * q
+        for i in range(q - 1):
+            log[powers[i]] = i
+        mul = [[0 if a == 0 or b == 0 else powers[(log[a] + log[b]) % (q - 1)] for b in range(q)] for a in range(q)]
+
+        x = set()
+        x_prime = set()
+        if q % 4 == 1:
+            exps = [(i, i + 1) for i in range(0, q - 2, 2)]
+        elif q % 4 == 3:
+            w = (q + 1) // 4
+            exps = [(i, i + 1) for i in range(0, 2 * w - 1, 2)] + [(i, i + 1) for i in range(2 * w - 1, 4 * w - 2, 2)]
+        else:
+            exps = [(i, i + 1) for i in range(0, q - 1, 2)]
+        for (i, j) in exps:
+            x.add(powers[i % (q - 1)])
+            x_prime.add(powers[j % (q - 1)])
+
+        return (add, sub, mul, x, x_prime)
+
+    def getNeighbors(self, rtr):
+        q = _params["slimfly:q"]
+        (add, sub, mul, x, x_prime) = self.field
+        qq = q * q
+        s = rtr // qq
+        a = (rtr % qq) // q
+        b = rtr % q
+        gen = x if s == 0 else x_prime
+        nbrs = [s * qq + a * q + add[b][g] for g in range(1, q) if g in gen]
+        for i in range(q):
+            if s == 0:
+                nbrs.append(qq + i * q + sub[b][mul[i][a]])
+            else:
+                nbrs.append(i * q + add[mul[a][i]][b])
+        return sorted(nbrs)
+
+    def build(self):
+        q = _params["slimfly:q"]
+        hosts_per_router = _params["slimfly:hosts_per_router"]
+        self.field = self._buildField(q)
+
+        swap_keys = [("slimfly:q","q"),("slimfly:hosts_per_router","hosts_per_router"),("slimfly:algorithm","algorithm"),("slimfly:ugal_threshold","ugal_threshold")]
+        _topo_params = _params.subsetWithRename(swap_keys);
+
+        links = dict()
+        def getLink(a, b):
+            name = "link:r%dr%d"%(min(a, b), max(a, b))
+            if name not in links:
+                links[name] = sst.Link(name)
+            return links[name]
+
+        nic_num = 0
+        for r in range(2 * q * q):
+            rtr = sst.Component("rtr:%d"%r, "merlin.hr_router")
+            rtr.addParams(_params.subset(self.topoKeys, self.topoOptKeys))
+            rtr.addParam("id", r)
+            topology = rtr.setSubComponent("topology","merlin.slimfly")
+            topology.addParams(_topo_params)
+
+            port = 0
+            for p in range(hosts_per_router):
+                ep = self._getEndPoint(nic_num).build(nic_num, {})
+                if ep:
+                    link = sst.Link("link:r%dh%d"%(r, p))
+                    if self.bundleEndpoints:
+                        link.setNoCut()
+                    link.connect(ep, (rtr, "port%d"%port, _params["link_lat"]) )
+                nic_num = nic_num + 1
+                port = port + 1
+
+            for n in self.getNeighbors(r):
+                rtr.addLink(getLink(r, n), "port%d"%port, _params["link_lat"])
+                port = port + 1
+
+
 ############################################################################
 
 class EndPoint(object):
@@ -1392,7 +1541,7 @@ class TrafficGenEndPoint(EndPoint):
 
 
 if __name__ == "__main__":
-    topos = dict([(1,topoTorus()), (2,topoFatTree()), (3,topoDragonFly()), (4,topoSimple())])
+    topos = dict([(1,topoTorus()), (2,topoFatTree()), (3,topoDragonFly()), (4,topoSimple()), (5,topoSlimFly())])
     endpoints = dict([(1,TestEndPoint()), (2, TrafficGenEndPoint()), (3, BisectionEndPoint())])
 
 
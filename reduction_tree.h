@@ -0,0 +1,97 @@
+// -*- mode: c++ -*-
+
+// Copyright 2009-2020 NTESS. Under the terms
+// of Contract DE-NA0003525 with NTESS, the U.S.
+// Government retains certain rights in this software.
+//
+// Copyright (c) 2009-2020, NTESS
+// All rights reserved.
+//
+// Portions are copyright of other developers:
+// See the file CONTRIBUTORS.TXT in the top level directory
+// the distribution for more information.
+//
+// This file is part of the SST software package. For license
+// information, see the LICENSE file in the top level directory of the
+// distribution.
+
+#ifndef COMPONENTS_MERLIN_REDUCTION_TREE_H
+#define COMPONENTS_MERLIN_REDUCTION_TREE_H
+
+#include <sst/core/event.h>
+#include <sst/core/interfaces/simpleNetwork.h>
+
+#include <vector>
+
+namespace SST {
+namespace Merlin {
+
+// Reduces results from every endpoint to endpoint 0 with untimed
+// data during complete(), over a binomial tree of endpoint ids.  The
+// parent of endpoint i is i with its lowest set bit cleared, so its
+// children are i + 2^k for every 2^k below that bit, and the tree is
+// log2(num_peers) levels deep whatever the topology.  Each endpoint
+// contributes the same number of payloads.  An endpoint merges what
+// its children send into its own results, then sends those to its
+// parent, so no endpoint receives more than
+// log2(num_peers) * values payloads.
+//
+// Call progress() from every complete() phase, after the
+// SimpleNetwork's complete().  Once it returns true, a non-root
+// endpoint sends its results with send().  On endpoint 0 it means
+// the reduction is finished.
+class ReductionTree {
+  public:
+    ReductionTree() : id(-1), parent(-1), pending(0), done(false) {}
+
+    // values is the number of payloads each endpoint sends
+    void init(int id_s, int num_peers, int values) {
+        id = id_s;
+        done = false;
+        int lowbit = id & -id;
+        parent = id - lowbit;
+        children.clear();
+        for (int step = 1; (id == 0 || step < lowbit) && id + step < num_peers; step <<= 1) {
+            children.push_back(id + step);
+        }
+        pending = children.size() * values;
+    }
+
+    inline bool isRoot() const { return id == 0; }
+    inline int getParent() const { return parent; }
+    // The same tree can be walked from the root down to broadcast
+    inline const std::vector<int> &getChildren() const { return children; }
+
+    // Hands each payload that has arrived to merge, which takes
+    // ownership of it.  Returns true, once, when the payloads from
+    // all the children are in.
+    template <typename F> bool progress(SST::Interfaces::SimpleNetwork *link_if, F merge) {
+        SST::Interfaces::SimpleNetwork::Request *req;
+        while ((req = link_if->recvUntimedData()) != nullptr) {
+            merge(req->takePayload());
+            delete req;
+            pending--;
+        }
+        if (done || pending > 0)
+            return false;
+        done = true;
+        return true;
+    }
+
+    void send(SST::Interfaces::SimpleNetwork *link_if, Event *payload) {
+        link_if->sendUntimedData(new SST::Interfaces::SimpleNetwork::Request(parent, id, 0, true, true, payload));
+    }
+
+  private:
+    int id;
+    int parent;
+    std::vector<int> children;
+    // Payloads still to come from the children
+    int pending;
+    bool done;
+};
+
+} // namespace Merlin
+} // namespace SST
+
+#endif // COMPONENTS_MERLIN_REDUCTION_TREE_H
@@ -0,0 +1,113 @@
+// -*- mode: c++ -*-
+
+// Copyright 2009-2020 NTESS. Under the terms
+// of Contract DE-NA0003525 with NTESS, the U.S.
+// Government retains certain rights in this software.
+//
+// Copyright (c) 2009-2020, NTESS
+// All rights reserved.
+//
+// Portions are copyright of other developers:
+// See the file CONTRIBUTORS.TXT in the top level directory
+// the distribution for more information.
+//
+// This file is part of the SST software package. For license
+// information, see the LICENSE file in the top level directory of the
+// distribution.
+
+#ifndef COMPONENTS_MERLIN_RING_BUFFER_H
+#define COMPONENTS_MERLIN_RING_BUFFER_H
+
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+namespace SST {
+namespace Merlin {
+
+// FIFO stored in a single power of two sized array.
+// Merlin's buffers are bounded by credits, so the capacity is set
+// once with reserve() when the credit count is known and the buffer
+// never allocates after that.  If a push is ever made to a full
+// buffer, the storage is doubled rather than dropping the entry.
+// Storage is aligned to a cache line.  The interface matches the
+// subset of std::queue used by the router and NIC code.
+template <typename T> class RingBuffer {
+  public:
+    static const size_t cache_line_size = 64;
+
+    RingBuffer() = default;
+    RingBuffer(const RingBuffer &) = delete;
+    RingBuffer &operator=(const RingBuffer &) = delete;
+
+    ~RingBuffer() { free(data); }
+
+    // Make sure the buffer can hold at least entries items without
+    // reallocating.
+    void reserve(size_t entries) {
+        size_t cap = 1;
+        while (cap < entries)
+            cap <<= 1;
+        if (cap > mask + 1 || data == nullptr)
+            resize(cap);
+    }
+
+    inline void push(const T &item) {
+        if (count == mask + 1 || data == nullptr)
+            resize(data == nullptr ? 4 : (mask + 1) * 2);
+        data[(head + count) & mask] = item;
+        count++;
+    }
+
+    // Puts item ahead of the current front
+    inline void push_front(const T &item) {
+        if (count == mask + 1 || data == nullptr)
+            resize(data == nullptr ? 4 : (mask + 1) * 2);
+        head = (head - 1) & mask;
+        data[head] = item;
+        count++;
+    }
+
+    inline void pop() {
+        head = (head + 1) & mask;
+        count--;
+    }
+
+    inline T &front() { return data[head]; }
+    inline const T &front() const { return data[head]; }
+
+    // Index is relative to the front of the queue
+    inline T &operator[](size_t index) { return data[(head + index) & mask]; }
+
+    inline bool empty() const { return count == 0; }
+    inline size_t size() const { return count; }
+    inline size_t capacity() const { return data == nullptr ? 0 : mask + 1; }
+
+  private:
+    void resize(size_t cap) {
+        void *mem = nullptr;
+        size_t bytes = cap * sizeof(T);
+        if (bytes < cache_line_size)
+            bytes = cache_line_size;
+        if (posix_memalign(&mem, cache_line_size, bytes) != 0)
+            throw std::bad_alloc();
+        T *new_data = static_cast<T *>(mem);
+        for (size_t i = 0; i < count; i++) {
+            new_data[i] = data[(head + i) & mask];
+        }
+        free(data);
+        data = new_data;
+        head = 0;
+        mask = cap - 1;
+    }
+
+    T *data{nullptr};
+    size_t head{0};
+    size_t count{0};
+    size_t mask{0};
+};
+
+} // namespace Merlin
+} // namespace SST
+
+#endif // COMPONENTS_MERLIN_RING_BUFFER_H
@@ -26,8 +26,14 @@
 #include <sst/core/unitAlgebra.h>
 #include <sst/core/interfaces/simpleNetwork.h>
 
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <queue>
 
+#include "ring_buffer.h"
+
 namespace SST {
 namespace Merlin {
 
@@ -37,9 +43,89 @@ const int INIT_BROADCAST_ADDR = -1;
 
 class TopologyEvent;
 
+// Occupancy bitmap for the router's VC heads.  Bit index is port *
+// num_vcs + vc, which matches the layout of the vc_heads array, so
+// walking the set bits with next() visits the non-empty heads in the
+// same order as a full scan of vc_heads would.  The PortControl
+// blocks keep it up to date as VC heads are filled and drained.
+class ActiveVCMap {
+  public:
+    ActiveVCMap() = default;
+    ActiveVCMap(const ActiveVCMap &) = delete;
+    ActiveVCMap &operator=(const ActiveVCMap &) = delete;
+
+    ~ActiveVCMap() {
+        delete[] bits;
+        delete[] port_count;
+    }
+
+    void init(int num_ports_in, int num_vcs_in) {
+        num_ports = num_ports_in;
+        num_vcs = num_vcs_in;
+        total_entries = num_ports * num_vcs;
+        num_words = (total_entries + 63) / 64;
+
+        delete[] bits;
+        delete[] port_count;
+        bits = new uint64_t[num_words];
+        port_count = new int[num_ports];
+        memset(bits, 0, num_words * sizeof(uint64_t));
+        memset(port_count, 0, num_ports * sizeof(int));
+        count = 0;
+    }
+
+    inline void set(int port, int vc) {
+        int index = port * num_vcs + vc;
+        bits[index >> 6] |= (uint64_t)1 << (index & 63);
+        port_count[port]++;
+        count++;
+    }
+
+    inline void clear(int port, int vc) {
+        int index = port * num_vcs + vc;
+        bits[index >> 6] &= ~((uint64_t)1 << (index & 63));
+        port_count[port]--;
+        count--;
+    }
+
+    inline bool test(int port, int vc) const {
+        int index = port * num_vcs + vc;
+        return (bits[index >> 6] >> (index & 63)) & 1;
+    }
+
+    // Returns the first active index >= start, or -1 if there are no
+    // more active entries.
+    inline int next(int start) const {
+        if (start >= total_entries)
+            return -1;
+        int word = start >> 6;
+        uint64_t val = bits[word] & (~(uint64_t)0 << (start & 63));
+        while (val == 0) {
+            if (++word == num_words)
+                return -1;
+            val = bits[word];
+        }
+        return (word << 6) + __builtin_ctzll(val);
+    }
+
+    inline int getCount() const { return count; }
+    inline int getPortCount(int port) const { return port_count[port]; }
+    inline int getNumVCs() const { return num_vcs; }
+
+  private:
+    uint64_t *bits{nullptr};
+    int *port_count{nullptr};
+    int num_ports{0};
+    int num_vcs{0};
+    int total_entries{0};
+    int num_words{0};
+    int count{0};
+};
+
 class Router : public Component {
   private:
     bool requestNotifyOnEvent{false};
+    bool requestNotifyOnCredits{false};
 
     Router()
         : Component()
@@ -48,8 +134,12 @@ class Router : public Component {
 
   protected:
     inline void setRequestNotifyOnEvent(bool state) { requestNotifyOnEvent = state; }
+    // Also call notifyEvent() when an output buffer returns credits
+    // to the crossbar
+    inline void setRequestNotifyOnCredits(bool state) { requestNotifyOnCredits = state; }
 
     int vcs_with_data{0};
+    ActiveVCMap active_vcs;
 
   public:
     Router(ComponentId_t id)
@@ -60,11 +150,18 @@ class Router : public Component {
     ~Router() override = default;
 
     inline bool getRequestNotifyOnEvent() { return requestNotifyOnEvent; }
+    inline bool getRequestNotifyOnCredits() { return requestNotifyOnCredits; }
 
     virtual void notifyEvent() {}
 
-    inline void inc_vcs_with_data() { vcs_with_data++; }
-    inline void dec_vcs_with_data() { vcs_with_data--; }
+    inline void inc_vcs_with_data(int port, int vc) {
+        vcs_with_data++;
+        active_vcs.set(port, vc);
+    }
+    inline void dec_vcs_with_data(int port, int vc) {
+        vcs_with_data--;
+        active_vcs.clear(port, vc);
+    }
     inline int get_vcs_with_data() { return vcs_with_data; }
 
     virtual int const *getOutputBufferCredits() = 0;
@@ -81,9 +178,21 @@ class BaseRtrEvent : public Event {
 
     inline RtrEventType getType() const { return type; }
 
+    // Credits can ride along on data events going the other way
+    // across a link instead of being sent as separate credit_events.
+    // A piggyback VC of -1 means no credits are attached.
+    inline void setPiggybackCredits(int vc, int credits) {
+        piggyback_vc = vc;
+        piggyback_credits = credits;
+    }
+    inline int getPiggybackVC() const { return piggyback_vc; }
+    inline int getPiggybackCredits() const { return piggyback_credits; }
+
     void serialize_order(SST::Core::Serialization::serializer &ser) override {
         Event::serialize_order(ser);
         ser &type;
+        ser &piggyback_vc;
+        ser &piggyback_credits;
     }
 
   protected:
@@ -92,10 +201,33 @@ class BaseRtrEvent : public Event {
   private:
     BaseRtrEvent() = default; // For Serialization only
     RtrEventType type;
+    int piggyback_vc{-1};
+    int piggyback_credits{0};
 
     ImplementSerializable(SST::Merlin::BaseRtrEvent);
 };
 
+// Time a packet has spent in each stage of the routers it has passed
+// through, summed over all hops, in core cycles.  Only packets sent
+// by a LinkControl with delay_breakdown on carry one.  Each stamp
+// charges the time since the previous one to the stage the packet was
+// in and moves it to the next.
+struct HopDelays {
+    enum Stage { INPUT_QUEUE = 0, XBAR_WAIT, OUTPUT_QUEUE, CREDIT_STALL, NUM_STAGES, IN_FLIGHT = NUM_STAGES };
+
+    SimTime_t total[NUM_STAGES]{};
+    SimTime_t stamp{0};
+    int stage{IN_FLIGHT};
+
+    inline void enter(int next) {
+        SimTime_t now = Simulation::getSimulation()->getCurrentSimCycle();
+        if (stage != IN_FLIGHT)
+            total[stage] += now - stamp;
+        stamp = now;
+        stage = next;
+    }
+};
+
 class RtrEvent : public BaseRtrEvent {
 
     friend class internal_router_event;
@@ -115,6 +247,7 @@ class RtrEvent : public BaseRtrEvent {
     ~RtrEvent() override {
         if (request)
             delete request;
+        delete delays;
     }
 
     inline void setInjectionTime(SimTime_t time) { injectionTime = time; }
@@ -123,9 +256,14 @@ class RtrEvent : public BaseRtrEvent {
     RtrEvent *clone() override {
         auto *ret = new RtrEvent(*this);
         ret->request = this->request->clone();
+        if (delays != nullptr)
+            ret->delays = new HopDelays(*delays);
         return ret;
     }
 
+    inline void enableHopDelays() { delays = new HopDelays(); }
+    inline HopDelays *getHopDelays() { return delays; }
+
     inline SimTime_t getInjectionTime() const { return injectionTime; }
     inline SST::Interfaces::SimpleNetwork::Request::TraceType getTraceType() const { return request->getTraceType(); }
     inline int getTraceID() const { return request->getTraceID(); }
@@ -162,6 +300,17 @@ class RtrEvent : public BaseRtrEvent {
         ser &route_vn;
         ser &size_in_flits;
         ser &injectionTime;
+        bool has_delays = delays != nullptr;
+        ser &has_delays;
+        if (has_delays) {
+            if (ser.mode() == SST::Core::Serialization::serializer::UNPACK)
+                delays = new HopDelays();
+            for (int i = 0; i < HopDelays::NUM_STAGES; i++) {
+                ser &delays->total[i];
+            }
+            ser &delays->stamp;
+            ser &delays->stage;
+        }
     }
 
   private:
@@ -171,6 +320,7 @@ class RtrEvent : public BaseRtrEvent {
     int route_vn;
     SimTime_t injectionTime{0};
     int size_in_flits;
+    HopDelays *delays{nullptr};
 
     ImplementSerializable(SST::Merlin::RtrEvent)
 };
@@ -259,6 +409,128 @@ class RtrInitEvent : public BaseRtrEvent {
     ImplementSerializable(SST::Merlin::RtrInitEvent)
 };
 
+// Per-thread free list used to recycle the events that are created
+// and destroyed on every router hop.  A class opts in with
+// MERLIN_POOLED_EVENT(class), which gives it class specific operator
+// new/delete.  Blocks are never handed back to the system.  Derived
+// classes that don't opt in themselves are a different size and fall
+// through to the global allocator.
+//
+// Each block remembers the pool it came from.  Events sent over links
+// between threads are freed on a different thread than the one that
+// allocated them, so those blocks are pushed onto a lock-free list
+// owned by the allocating pool, which takes the whole list back the
+// next time its own free list runs dry.  Otherwise blocks would pile
+// up on the receiving thread and the sending thread would keep
+// allocating new ones.
+template <typename T> class EventPool {
+  private:
+    struct FreeBlock {
+        FreeBlock *next;
+    };
+
+    struct ThreadPool {
+        FreeBlock *free_list{nullptr};
+        // Blocks from this pool freed by other threads
+        std::atomic<FreeBlock *> remote_free{nullptr};
+    };
+
+    // Sits in front of every pooled block.  Padded so the object
+    // after it keeps the alignment of ::operator new.
+    union BlockHeader {
+        ThreadPool *owner;
+        std::max_align_t align;
+    };
+
+    static ThreadPool *local() {
+        // Never deleted, other threads can still be handing blocks
+        // back after this one is done
+        static thread_local ThreadPool *pool = new ThreadPool();
+        return pool;
+    }
+
+  public:
+    static void *allocate(size_t size) {
+        if (size != sizeof(T))
+            return ::operator new(size);
+        ThreadPool *pool = local();
+        if (pool->free_list == nullptr)
+            pool->free_list = pool->remote_free.exchange(nullptr, std::memory_order_acquire);
+
+        BlockHeader *header;
+        if (pool->free_list == nullptr) {
+            header = static_cast<BlockHeader *>(::operator new(sizeof(BlockHeader) + size));
+        } else {
+            FreeBlock *block = pool->free_list;
+            pool->free_list = block->next;
+            header = reinterpret_cast<BlockHeader *>(block);
+        }
+        header->owner = pool;
+        return header + 1;
+    }
+
+    static void release(void *ptr, size_t size) {
+        if (size != sizeof(T)) {
+            ::operator delete(ptr);
+            return;
+        }
+        BlockHeader *header = static_cast<BlockHeader *>(ptr) - 1;
+        ThreadPool *owner = header->owner;
+        auto *block = reinterpret_cast<FreeBlock *>(header);
+        if (owner == local()) {
+            block->next = owner->free_list;
+            owner->free_list = block;
+            return;
+        }
+        // Blocks are only ever taken off this list all at once, so a
+        // plain push is safe from ABA
+        block->next = owner->remote_free.load(std::memory_order_relaxed);
+        while (!owner->remote_free.compare_exchange_weak(block->next, block, std::memory_order_release,
+                                                         std::memory_order_relaxed)) {
+        }
+    }
+};
+
+#define MERLIN_POOLED_EVENT(cls)                                                                                       \
+    static void *operator new(size_t size) { return SST::Merlin::EventPool<cls>::allocate(size); }                     \
+    static void operator delete(void *ptr, size_t size) { SST::Merlin::EventPool<cls>::release(ptr, size); }
+
+// Maximum number of dimensions supported by the coordinate based
+// topologies (torus, mesh, hyperx).  Coordinates are stored inline
+// in the topology events, so this sets the size of those arrays.
+#ifndef MERLIN_MAX_DIMENSIONS
+#define MERLIN_MAX_DIMENSIONS 8
+#endif
+
+// Maximum number of routers a source routed packet can pass through.
+// Paths that are longer are routed hop by hop instead.
+#ifndef MERLIN_MAX_SOURCE_ROUTE_HOPS
+#define MERLIN_MAX_SOURCE_ROUTE_HOPS 16
+#endif
+
+// Output port and VC to use at each router on a source routed path,
+// filled in by the topology when the packet enters the network.
+// Events only point to one when the packet is source routed, so
+// packets routed hop by hop don't carry the arrays.
+struct SourceRoute {
+    uint8_t length{0};
+    uint8_t next{0};
+    uint16_t port[MERLIN_MAX_SOURCE_ROUTE_HOPS];
+    uint8_t vc[MERLIN_MAX_SOURCE_ROUTE_HOPS];
+
+    // Returns false if the path is too long to source route
+    inline bool addHop(int port_in, int vc_in) {
+        if (length == MERLIN_MAX_SOURCE_ROUTE_HOPS)
+            return false;
+        port[length] = port_in;
+        vc[length] = vc_in;
+        length++;
+        return true;
+    }
+
+    MERLIN_POOLED_EVENT(SourceRoute)
+};
+
 class internal_router_event : public BaseRtrEvent {
     int next_port;
     int next_vc;
@@ -266,15 +538,29 @@ class internal_router_event : public BaseRtrEvent {
     int credit_return_vc;
     RtrEvent *encap_ev;
 
+    // Source route, or nullptr if the packet is routed hop by hop.
+    // Each router takes the next hop instead of calling route().
+    SourceRoute *source_route{nullptr};
+
   public:
     internal_router_event() : BaseRtrEvent(BaseRtrEvent::INTERNAL) { encap_ev = nullptr; }
     internal_router_event(RtrEvent *ev) : BaseRtrEvent(BaseRtrEvent::INTERNAL) { encap_ev = ev; }
+    // Copies share the encapsulated event, as before, but get their
+    // own source route
+    internal_router_event(const internal_router_event &ev)
+        : BaseRtrEvent(ev), next_port(ev.next_port), next_vc(ev.next_vc), vc(ev.vc),
+          credit_return_vc(ev.credit_return_vc), encap_ev(ev.encap_ev),
+          source_route(ev.source_route != nullptr ? new SourceRoute(*ev.source_route) : nullptr) {}
+    internal_router_event &operator=(const internal_router_event &) = delete;
 
     ~internal_router_event() override {
         if (encap_ev != nullptr)
             delete encap_ev;
+        delete source_route;
     }
 
+    MERLIN_POOLED_EVENT(internal_router_event)
+
     internal_router_event *clone() override { return new internal_router_event(*this); };
 
     inline void setCreditReturnVC(int vc) {
@@ -289,6 +575,19 @@ class internal_router_event : public BaseRtrEvent {
     }
     inline int getNextPort() { return next_port; }
 
+    // Takes a copy of a complete path from the topology
+    inline void setSourceRoute(const SourceRoute &route) {
+        delete source_route;
+        source_route = new SourceRoute(route);
+    }
+    inline bool isSourceRouted() const { return source_route != nullptr; }
+    // Sets the next port and VC for this router from the source route
+    inline void popSourceRoute() {
+        next_port = source_route->port[source_route->next];
+        vc = source_route->vc[source_route->next];
+        source_route->next++;
+    }
+
     // inline void setNextVC(int vc) {next_vc = vc; return;}
     // inline int getNextVC() {return next_vc;}
 
@@ -302,6 +601,7 @@ class internal_router_event : public BaseRtrEvent {
     inline int getVN() { return encap_ev->route_vn; }
 
     inline int getFlitCount() { return encap_ev->getSizeInFlits(); }
+    inline HopDelays *getHopDelays() { return encap_ev->delays; }
 
     inline void setEncapsulatedEvent(RtrEvent *ev) { encap_ev = ev; }
     inline RtrEvent *getEncapsulatedEvent() { return encap_ev; }
@@ -328,6 +628,18 @@ class internal_router_event : public BaseRtrEvent {
         ser &vc;
         ser &credit_return_vc;
         ser &encap_ev;
+        bool has_route = source_route != nullptr;
+        ser &has_route;
+        if (has_route) {
+            if (ser.mode() == SST::Core::Serialization::serializer::UNPACK)
+                source_route = new SourceRoute();
+            ser &source_route->length;
+            ser &source_route->next;
+            for (int i = 0; i < source_route->length; i++) {
+                ser &source_route->port[i];
+                ser &source_route->vc[i];
+            }
+        }
     }
 
   private:
@@ -347,6 +659,14 @@ class Topology : public SubComponent {
     virtual void reroute(int port, int vc, internal_router_event *ev) { route(port, vc, ev); }
     virtual internal_router_event *process_input(RtrEvent *ev) = 0;
 
+    // Sets the source route for a packet that just entered the
+    // network from the endpoint on port, using the same port and VC
+    // choices route() would make at each router along the way.  Only
+    // topologies with deterministic routing can do this.  Returns
+    // false if the packet has to be routed hop by hop, in which case
+    // no source route is set.
+    virtual bool computeSourceRoute(int /*port*/, int /*vc*/, internal_router_event * /*ev*/) { return false; }
+
     // Returns whether the port is a router to router, router to nic, or unconnected
     virtual PortState getPortState(int port) const = 0;
     inline bool isHostPort(int port) const { return getPortState(port) == R2N; }
@@ -375,8 +695,14 @@ class Topology : public SubComponent {
     // topology object for the router
     virtual void recvTopologyEvent(int port, TopologyEvent *ev){};
 
+    // Set by the router after the topology is loaded.  Topologies use
+    // it to send TopologyEvents.  Stays NULL when the topology isn't
+    // owned by a router.
+    void setRouter(Router *rtr) { router = rtr; }
+
   protected:
     Output &output;
+    Router *router{nullptr};
 };
 
 // Class to manage link between NIC and router.  A single NIC can have
@@ -387,7 +713,7 @@ class PortInterface : public SubComponent {
     // params are: parent router, router id, port number, topology object
     SST_ELI_REGISTER_SUBCOMPONENT_API(SST::Merlin::PortInterface, Router *, int, int, Topology *)
 
-    typedef std::queue<internal_router_event *> port_queue_t;
+    typedef RingBuffer<internal_router_event *> port_queue_t;
     using topo_queue_t = std::queue<TopologyEvent *>;
 
     virtual void sendTopologyEvent(TopologyEvent *ev) = 0;
@@ -401,6 +727,11 @@ class PortInterface : public SubComponent {
     // the next event.
     virtual internal_router_event *recv(int vc) = 0;
     virtual internal_router_event **getVCHeads() = 0;
+    // Called by the router before arbitration on ports with buffered
+    // data and a free crossbar input.  Ports that keep more than one
+    // queue per VC use it to pick which packet each VC presents in
+    // getVCHeads().
+    virtual void selectVOQHeads(PortInterface ** /*ports*/, const int * /*out_port_busy*/) {}
 
     // time_base is a frequency which represents the bandwidth of the link in flits/second.
     PortInterface(ComponentId_t cid) : SubComponent(cid) {}
@@ -454,9 +785,22 @@ class XbarArbitration : public SubComponent {
     virtual void arbitrate(PortInterface **ports, int *port_busy, int *out_port_busy, int *progress_vc) = 0;
 #endif
     virtual void setPorts(int num_ports, int num_vcs) = 0;
+    // Gives the arbiter the router's VC occupancy map so it only has
+    // to look at VC heads that actually hold an event.
+    virtual void setActiveVCs(ActiveVCMap const *map) { active_vcs = map; }
     virtual bool isOkayToPauseClock() { return true; }
+    // Cycles on which the router's clock was paused and arbitrate()
+    // was not called
     virtual void reportSkippedCycles(Cycle_t cycles){};
+    // Cycles the event driven crossbar skipped while VCs held data
+    // that couldn't move.  A clocked router would have called
+    // arbitrate() on each of them without making a grant.
+    // in_port_busy holds the busy counts left by the last arbitration.
+    virtual void reportStalledCycles(Cycle_t cycles, int const * /*in_port_busy*/) { reportSkippedCycles(cycles); }
     virtual void dumpState(std::ostream &stream){};
+
+  protected:
+    ActiveVCMap const *active_vcs{nullptr};
 };
 
 } // namespace Merlin
@@ -0,0 +1,1111 @@
+// Copyright 2009-2020 NTESS. Under the terms
+// of Contract DE-NA0003525 with NTESS, the U.S.
+// Government retains certain rights in this software.
+//
+// Copyright (c) 2009-2020, NTESS
+// All rights reserved.
+//
+// Portions are copyright of other developers:
+// See the file CONTRIBUTORS.TXT in the top level directory
+// the distribution for more information.
+//
+// This file is part of the SST software package. For license
+// information, see the LICENSE file in the top level directory of the
+// distribution.
+//
+
+#include <sst/core/sst_config.h>
+#include "merlin_bench.h"
+
+#include "../../topology/dragonfly.h"
+
+#include <sst/core/interfaces/simpleNetwork.h>
+#include <sst/core/params.h>
+#include <sst/core/rng/xorshift.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <tuple>
+
+using namespace SST::Merlin;
+using SST::Interfaces::SimpleNetwork;
+
+// Number of distinct packets each topology is timed with
+static const size_t bench_events = 1024;
+
+// Cycles between the old VC heads asked for with old_fraction and
+// the rest
+static const SimTime_t old_gap = 1 << 20;
+
+// Dragonfly the dragonfly_walks run on: 2 hosts and 2 global links on
+// each router, 4 routers in each of 9 groups.  Global link i of a
+// group, on router i / 2, goes to the i-th other group.
+static const int walk_p = 2;
+static const int walk_a = 4;
+static const int walk_h = 2;
+static const int walk_g = 9;
+static const int walk_ports = walk_p + walk_a - 1 + walk_h;
+static const int walk_global_start = walk_p + walk_a - 1;
+// VNs every walk routes packets on
+static const int walk_vns = 2;
+// Routers on the longest path: two in the source group when par
+// diverts a packet, then one or two in each of the other groups
+static const int max_dragonfly_routers = 7;
+
+merlin_bench::merlin_bench(ComponentId_t cid, Params &params)
+    : Component(cid), out("", 0, 0, Output::STDOUT), topo_slot(0), arb_slot(0), port_slot(0) {
+    route_iterations = params.find<uint64_t>("route_iterations", 1000000);
+    arb_iterations = params.find<uint64_t>("arb_iterations", 100000);
+    occupancy = params.find<double>("occupancy", 0.5);
+    seed = params.find<uint32_t>("seed", 1);
+    verify_cycles = params.find<uint64_t>("verify_cycles", 10000);
+    reference_params = params.find_prefix_params("reference:");
+    age_range = params.find<uint32_t>("age_range", 4096);
+    if (age_range == 0) {
+        merlin_abort.fatal(CALL_INFO, -1, "merlin.bench: age_range must be at least 1\n");
+    }
+    old_fraction = params.find<double>("old_fraction", 0.0);
+    walk_rounds = params.find<uint64_t>("walk_rounds", 20);
+
+    rng = new RNG::XORShiftRNG(seed);
+
+    std::vector<std::string> topologies;
+    params.find_array<std::string>("topologies", topologies);
+    if (topologies.empty())
+        topologies = {"torus", "mesh", "hyperx", "dragonfly", "fattree"};
+
+    std::vector<std::string> arbiters;
+    params.find_array<std::string>("arbiters", arbiters);
+    if (arbiters.empty()) {
+        arbiters = {"merlin.xbar_arb_rr",       "merlin.xbar_arb_lru", "merlin.xbar_arb_lru_sparse",
+                    "merlin.xbar_arb_lru_infx", "merlin.xbar_arb_age", "merlin.xbar_arb_rand",
+                    "merlin.xbar_arb_islip",    "merlin.xbar_arb_wavefront"};
+    }
+
+    std::vector<int> radices;
+    params.find_array<int>("radices", radices);
+    if (radices.empty())
+        radices = {8, 16, 32, 48, 64, 96, 128};
+
+    std::vector<int> vcs;
+    params.find_array<int>("vcs", vcs);
+    if (vcs.empty())
+        vcs = {2, 4, 8};
+
+    for (int radix : radices) {
+        if (radix < 8 || radix % 4 != 0) {
+            merlin_abort.fatal(CALL_INFO, -1, "merlin.bench: radix %d must be a multiple of 4 and at least 8\n",
+                               radix);
+        }
+    }
+    int max_radix = *std::max_element(radices.begin(), radices.end());
+
+    std::vector<std::string> verify_arbiters;
+    params.find_array<std::string>("verify_arbiters", verify_arbiters);
+    if (verify_arbiters.size() % 2 != 0) {
+        merlin_abort.fatal(CALL_INFO, -1, "merlin.bench: verify_arbiters must list pairs of arbiters\n");
+    }
+    std::vector<std::string> verify_stalls;
+    params.find_array<std::string>("verify_stalls", verify_stalls);
+    std::vector<std::string> dragonfly_walks;
+    params.find_array<std::string>("dragonfly_walks", dragonfly_walks);
+    std::vector<std::string> graph_walks;
+    params.find_array<std::string>("graph_walks", graph_walks);
+    std::string graph_file = params.find<std::string>("graph_file", "");
+    if (!graph_walks.empty() && graph_file.empty()) {
+        merlin_abort.fatal(CALL_INFO, -1, "merlin.bench: graph_walks needs a graph_file\n");
+    }
+    std::vector<std::string> slimfly_walks;
+    params.find_array<std::string>("slimfly_walks", slimfly_walks);
+    std::vector<int> slimfly_neighbors;
+    params.find_array<int>("slimfly_neighbors", slimfly_neighbors);
+    int slimfly_q = params.find<int>("slimfly_q", 5);
+    int slimfly_hosts = params.find<int>("slimfly_hosts_per_router", 2);
+    Params empty_params;
+    if (!verify_arbiters.empty() || !verify_stalls.empty() || !dragonfly_walks.empty() || !graph_walks.empty() ||
+        !slimfly_walks.empty()) {
+        for (size_t i = 0; i < verify_arbiters.size(); i += 2) {
+            for (int radix : radices) {
+                for (int vc : vcs)
+                    addVerifyCase(verify_arbiters[i], verify_arbiters[i + 1], reference_params, radix, vc, false);
+            }
+        }
+        for (auto &name : verify_stalls) {
+            for (int radix : radices) {
+                for (int vc : vcs)
+                    addVerifyCase(name, name, empty_params, radix, vc, true);
+            }
+        }
+        for (auto &algorithm : dragonfly_walks)
+            addDragonflyWalk(algorithm);
+        for (auto &algorithm : graph_walks)
+            addGraphWalk(graph_file, algorithm);
+        for (auto &algorithm : slimfly_walks)
+            addSlimFlyWalk(slimfly_q, slimfly_hosts, slimfly_neighbors, algorithm);
+        // Pins the end of simulation to 1 ns
+        registerClock("1GHz", new Clock::Handler<merlin_bench>(this, &merlin_bench::end_handler));
+        return;
+    }
+
+    for (auto &name : topologies) {
+        if (name == "dragonfly") {
+            addTopology(name, max_radix, false);
+            addTopology(name, max_radix, true);
+            continue;
+        }
+        for (int radix : radices) {
+            addTopology(name, radix, false);
+        }
+    }
+
+    for (auto &name : arbiters) {
+        for (int radix : radices) {
+            for (int vc : vcs) {
+                ArbCase ac;
+                ac.name = name;
+                ac.radix = radix;
+                ac.vcs = vc;
+                ac.port_set = getPortSet(radix, vc);
+                ac.arb = loadArbiter(name, empty_params);
+                arb_cases.push_back(ac);
+            }
+        }
+    }
+}
+
+merlin_bench::~merlin_bench() {
+    for (auto &tc : topo_cases) {
+        for (auto *ev : tc.events)
+            delete ev;
+        delete tc.topo;
+    }
+    for (auto &ac : arb_cases)
+        delete ac.arb;
+    for (auto &vcase : verify_cases) {
+        delete vcase.ref;
+        delete vcase.cand;
+    }
+    for (auto &wc : walk_cases) {
+        for (auto *topo : wc.routers)
+            delete topo;
+    }
+    for (auto *ps : port_sets) {
+        for (auto *ev : ps->heads)
+            delete ev;
+        for (auto *port : ps->ports)
+            delete port;
+        delete ps;
+    }
+    delete rng;
+}
+
+void merlin_bench::addTopology(const std::string &name, int radix, bool precomputed) {
+    Params tp;
+    std::string type = "merlin." + name;
+    std::string label = name;
+    int num_ports = radix;
+    int num_peers = 0;
+
+    if (name == "torus" || name == "mesh") {
+        // 4x4 with one link per direction leaves radix - 4 host ports
+        tp.insert("shape", "4x4");
+        tp.insert("width", "1x1");
+        tp.insert("local_ports", std::to_string(radix - 4));
+        num_peers = 16 * (radix - 4);
+    } else if (name == "hyperx") {
+        // Half the ports go to the network, split across two
+        // dimensions
+        int size = radix / 4 + 1;
+        tp.insert("shape", std::to_string(size) + "x" + std::to_string(size));
+        tp.insert("width", "1x1");
+        tp.insert("local_ports", std::to_string(radix / 2));
+        tp.insert("algorithm", "DOAL");
+        num_peers = size * size * (radix / 2);
+    } else if (name == "dragonfly") {
+        // Balanced dragonfly: p = h = a/2 and the maximum number of
+        // groups for a single link between each pair
+        int p = radix / 4;
+        int a = radix / 2;
+        int h = radix / 4;
+        int g = a * h + 1;
+        num_ports = p + a - 1 + h;
+        num_peers = p * a * g;
+
+        std::string map = "[";
+        for (int i = 0; i < a * h; i++) {
+            map += std::to_string(i);
+            map += (i == a * h - 1) ? "]" : ",";
+        }
+        tp.insert("hosts_per_router", std::to_string(p));
+        tp.insert("routers_per_group", std::to_string(a));
+        tp.insert("intergroup_per_router", std::to_string(h));
+        tp.insert("intergroup_links", "1");
+        tp.insert("num_groups", std::to_string(g));
+        tp.insert("algorithm", "adaptive-local");
+        tp.insert("global_link_map", map);
+        tp.insert("routing_table", precomputed ? "precomputed" : "computed");
+        label = precomputed ? "dragonfly(precomputed)" : "dragonfly(computed)";
+    } else if (name == "fattree") {
+        tp.insert("shape", std::to_string(radix / 2) + "," + std::to_string(radix / 2) + ":" + std::to_string(radix));
+        tp.insert("routing_alg", "adaptive");
+        num_peers = (radix / 2) * radix;
+    } else {
+        merlin_abort.fatal(CALL_INFO, -1, "merlin.bench: unknown topology %s\n", name.c_str());
+    }
+
+    TopoCase tc;
+    tc.name = label;
+    tc.radix = radix;
+    tc.topo = loadAnonymousSubComponent<Topology>(type, "topology", topo_slot++, ComponentInfo::SHARE_NONE, tp,
+                                                  num_ports, 0);
+    if (tc.topo == nullptr) {
+        merlin_abort.fatal(CALL_INFO, -1, "merlin.bench: unable to load topology %s\n", type.c_str());
+    }
+
+    int num_vcs = tc.topo->computeNumVCs(1);
+    tc.credits.resize(num_ports * num_vcs);
+    tc.queue_lengths.resize(num_ports * num_vcs);
+    for (size_t i = 0; i < tc.credits.size(); i++) {
+        tc.credits[i] = rng->generateNextUInt32() % 33;
+        tc.queue_lengths[i] = 32 - tc.credits[i];
+    }
+    tc.topo->setOutputBufferCreditArray(tc.credits.data(), num_vcs);
+    tc.topo->setOutputQueueLengthsArray(tc.queue_lengths.data(), num_vcs);
+
+    // Packets come in on any connected port, host or network
+    std::vector<int> connected;
+    for (int i = 0; i < num_ports; i++) {
+        if (tc.topo->getPortState(i) != Topology::UNCONNECTED)
+            connected.push_back(i);
+    }
+
+    for (size_t i = 0; i < bench_events; i++) {
+        int dest = rng->generateNextUInt32() % num_peers;
+        auto *req = new SimpleNetwork::Request(dest, 0, 64, true, true);
+        auto *rtr_ev = new RtrEvent(req, 0, 0);
+        rtr_ev->computeSizeInFlits(64);
+        internal_router_event *ev = tc.topo->process_input(rtr_ev);
+        tc.events.push_back(ev);
+        tc.start_vcs.push_back(ev->getVC());
+        tc.in_ports.push_back(connected[rng->generateNextUInt32() % connected.size()]);
+    }
+
+    topo_cases.push_back(std::move(tc));
+}
+
+XbarArbitration *merlin_bench::loadArbiter(const std::string &name, Params &arb_params) {
+    XbarArbitration *arb = loadAnonymousSubComponent<XbarArbitration>(name, "arbiter", arb_slot++,
+                                                                      ComponentInfo::SHARE_NONE, arb_params);
+    if (arb == nullptr) {
+        merlin_abort.fatal(CALL_INFO, -1, "merlin.bench: unable to load arbiter %s\n", name.c_str());
+    }
+    return arb;
+}
+
+void merlin_bench::addVerifyCase(const std::string &ref_name, const std::string &cand_name, Params &ref_params,
+                                 int radix, int vcs, bool stalls) {
+    Params empty_params;
+    VerifyCase vcase;
+    vcase.ref_name = ref_name;
+    vcase.cand_name = cand_name;
+    vcase.ref = loadArbiter(ref_name, ref_params);
+    vcase.cand = loadArbiter(cand_name, empty_params);
+    vcase.stalls = stalls;
+    vcase.port_set = getPortSet(radix, vcs);
+    verify_cases.push_back(vcase);
+}
+
+// VC head headed for a random output port and VC.  It was injected
+// in one of the last age_range cycles of a 1 GHz clock.  The default
+// of 4096 gives the age based arbiters a realistic mix of distinct and
+// equal ages.  An old_fraction of the heads were injected old_gap
+// cycles earlier.
+internal_router_event *merlin_bench::makeHead(int radix, int vcs, int flits) {
+    auto *req = new SimpleNetwork::Request(0, 0, 64 * flits, true, true);
+    auto *rtr_ev = new RtrEvent(req, 0, 0);
+    rtr_ev->computeSizeInFlits(64);
+    SimTime_t cycle = rng->generateNextUInt32() % age_range;
+    if (old_fraction == 0.0 || rng->nextUniform() >= old_fraction)
+        cycle += old_gap;
+    rtr_ev->setInjectionTime(cycle * 1000);
+    auto *ev = new internal_router_event(rtr_ev);
+    ev->setNextPort(rng->generateNextUInt32() % radix);
+    ev->setVC(rng->generateNextUInt32() % vcs);
+    return ev;
+}
+
+int merlin_bench::getPortSet(int radix, int vcs) {
+    for (size_t i = 0; i < port_sets.size(); i++) {
+        if (port_sets[i]->radix == radix && port_sets[i]->vcs == vcs)
+            return i;
+    }
+
+    auto *ps = new PortSet();
+    ps->radix = radix;
+    ps->vcs = vcs;
+    ps->heads.assign(radix * vcs, nullptr);
+    ps->active.init(radix, vcs);
+
+    for (int port = 0; port < radix; port++) {
+        for (int vc = 0; vc < vcs; vc++) {
+            if (rng->nextUniform() >= occupancy)
+                continue;
+            ps->heads[port * vcs + vc] = makeHead(radix, vcs, 1);
+            ps->active.set(port, vc);
+        }
+    }
+
+    Params empty_params;
+    for (int port = 0; port < radix; port++) {
+        auto *bp = loadAnonymousSubComponent<PortInterface>("merlin.bench_port", "port", port_slot++,
+                                                            ComponentInfo::SHARE_NONE, empty_params,
+                                                            static_cast<Router *>(nullptr), 0, port,
+                                                            static_cast<Topology *>(nullptr));
+        static_cast<bench_port *>(bp)->setVCHeads(&ps->heads[port * vcs]);
+        ps->ports.push_back(bp);
+    }
+
+    port_sets.push_back(ps);
+    return port_sets.size() - 1;
+}
+
+void merlin_bench::setup() {
+    // Routing tables that depend on shared regions can only be built
+    // now
+    for (auto &tc : topo_cases)
+        tc.topo->setup();
+    for (auto &wc : walk_cases) {
+        for (auto *topo : wc.routers)
+            topo->setup();
+    }
+
+    if (!verify_cases.empty() || !walk_cases.empty()) {
+        for (auto &vcase : verify_cases)
+            runVerify(vcase);
+        for (auto &wc : walk_cases)
+            runWalk(wc);
+        return;
+    }
+
+    for (auto &ac : arb_cases) {
+        ac.arb->setPorts(ac.radix, ac.vcs);
+        ac.arb->setActiveVCs(&port_sets[ac.port_set]->active);
+    }
+
+    out.output("%-24s %6s %12s %12s\n", "topology", "radix", "route(ns)", "reroute(ns)");
+    for (auto &tc : topo_cases)
+        runTopology(tc);
+
+    out.output("\n%-24s %6s %6s %12s\n", "arbiter", "radix", "vcs", "arb(ns)");
+    for (auto &ac : arb_cases)
+        runArbiter(ac);
+}
+
+// route() rewrites the events it is handed (next port, VC and any
+// topology specific state), so every batch is timed on fresh copies
+// of the events as they left process_input().  The copies share the
+// template's RtrEvent, which is detached again before they are freed.
+void merlin_bench::copyEvents(TopoCase &tc, std::vector<internal_router_event *> &batch, size_t count) {
+    for (size_t e = 0; e < count; e++)
+        batch[e] = tc.events[e]->clone();
+}
+
+void merlin_bench::freeEvents(std::vector<internal_router_event *> &batch, size_t count) {
+    for (size_t e = 0; e < count; e++) {
+        batch[e]->setEncapsulatedEvent(nullptr);
+        delete batch[e];
+    }
+}
+
+void merlin_bench::runTopology(TopoCase &tc) {
+    std::vector<internal_router_event *> batch(bench_events);
+    std::chrono::steady_clock::duration route_time{0};
+    std::chrono::steady_clock::duration reroute_time{0};
+
+    for (uint64_t done = 0; done < route_iterations;) {
+        size_t count = std::min<uint64_t>(bench_events, route_iterations - done);
+
+        copyEvents(tc, batch, count);
+        auto start = std::chrono::steady_clock::now();
+        for (size_t e = 0; e < count; e++)
+            tc.topo->route(tc.in_ports[e], tc.start_vcs[e], batch[e]);
+        route_time += std::chrono::steady_clock::now() - start;
+        freeEvents(batch, count);
+
+        // reroute() is called on packets that have been routed once,
+        // as they are when they reach the head of a VC
+        copyEvents(tc, batch, count);
+        for (size_t e = 0; e < count; e++)
+            tc.topo->route(tc.in_ports[e], tc.start_vcs[e], batch[e]);
+        start = std::chrono::steady_clock::now();
+        for (size_t e = 0; e < count; e++)
+            tc.topo->reroute(tc.in_ports[e], tc.start_vcs[e], batch[e]);
+        reroute_time += std::chrono::steady_clock::now() - start;
+        freeEvents(batch, count);
+
+        done += count;
+    }
+
+    double route_ns = std::chrono::duration<double, std::nano>(route_time).count() / route_iterations;
+    double reroute_ns = std::chrono::duration<double, std::nano>(reroute_time).count() / route_iterations;
+    out.output("%-24s %6d %12.2f %12.2f\n", tc.name.c_str(), tc.radix, route_ns, reroute_ns);
+}
+
+void merlin_bench::runArbiter(ArbCase &ac) {
+    PortSet *ps = port_sets[ac.port_set];
+    std::vector<int> in_port_busy(ac.radix);
+    std::vector<int> out_port_busy(ac.radix);
+    std::vector<int> progress_vcs(ac.radix);
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < arb_iterations; i++) {
+        // Ports never stay busy, so every call sees every request
+        std::fill(in_port_busy.begin(), in_port_busy.end(), 0);
+        std::fill(out_port_busy.begin(), out_port_busy.end(), 0);
+#if VERIFY_DECLOCKING
+        ac.arb->arbitrate(ps->ports.data(), in_port_busy.data(), out_port_busy.data(), progress_vcs.data(), true);
+#else
+        ac.arb->arbitrate(ps->ports.data(), in_port_busy.data(), out_port_busy.data(), progress_vcs.data());
+#endif
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    double arb_ns = std::chrono::duration<double, std::nano>(end - start).count() / arb_iterations;
+    out.output("%-24s %6d %6d %12.2f\n", ac.name.c_str(), ac.radix, ac.vcs, arb_ns);
+}
+
+void merlin_bench::runVerify(VerifyCase &vcase) {
+    PortSet *ps = port_sets[vcase.port_set];
+    int radix = ps->radix;
+    int vcs = ps->vcs;
+
+    // Start from empty VCs, the occupancy is built up cycle by cycle
+    for (auto *&ev : ps->heads) {
+        delete ev;
+        ev = nullptr;
+    }
+    ps->active.init(radix, vcs);
+
+    vcase.ref->setPorts(radix, vcs);
+    vcase.ref->setActiveVCs(&ps->active);
+    vcase.cand->setPorts(radix, vcs);
+    vcase.cand->setActiveVCs(&ps->active);
+
+    std::vector<int> ref_in(radix), ref_out(radix), ref_progress(radix);
+    std::vector<int> cand_in(radix), cand_out(radix), cand_progress(radix);
+    uint64_t grants = 0;
+
+    for (uint64_t cycle = 0; cycle < verify_cycles; cycle++) {
+        // Each cycle about a fifth of the VCs are refilled or drained
+        // so the fraction holding data tends towards occupancy
+        for (int index = 0; index < radix * vcs; index++) {
+            if (rng->nextUniform() >= 0.2)
+                continue;
+            bool fill = rng->nextUniform() < occupancy;
+            internal_router_event *&ev = ps->heads[index];
+            if (fill && ev == nullptr) {
+                ev = makeHead(radix, vcs, 1 + rng->generateNextUInt32() % 3);
+                ps->active.set(index / vcs, index % vcs);
+            } else if (!fill && ev != nullptr) {
+                delete ev;
+                ev = nullptr;
+                ps->active.clear(index / vcs, index % vcs);
+            }
+        }
+
+        // Some outputs have no credits and some xbar ports are still
+        // busy with an earlier packet
+        for (int port = 0; port < radix; port++) {
+            static_cast<bench_port *>(ps->ports[port])->setSpaceToSend(rng->nextUniform() >= 0.2);
+            int busy = rng->nextUniform() < 0.3 ? 1 + rng->generateNextUInt32() % 2 : 0;
+            ref_in[port] = cand_in[port] = busy;
+            busy = rng->nextUniform() < 0.3 ? 1 + rng->generateNextUInt32() % 2 : 0;
+            ref_out[port] = cand_out[port] = busy;
+        }
+
+#if VERIFY_DECLOCKING
+        vcase.ref->arbitrate(ps->ports.data(), ref_in.data(), ref_out.data(), ref_progress.data(), true);
+        vcase.cand->arbitrate(ps->ports.data(), cand_in.data(), cand_out.data(), cand_progress.data(), true);
+#else
+        vcase.ref->arbitrate(ps->ports.data(), ref_in.data(), ref_out.data(), ref_progress.data());
+        vcase.cand->arbitrate(ps->ports.data(), cand_in.data(), cand_out.data(), cand_progress.data());
+#endif
+
+        for (int port = 0; port < radix; port++) {
+            if (ref_progress[port] != cand_progress[port] || ref_in[port] != cand_in[port] ||
+                ref_out[port] != cand_out[port]) {
+                merlin_abort.fatal(CALL_INFO, -1,
+                                   "merlin.bench: %s and %s differ at radix %d, vcs %d, cycle %" PRIu64
+                                   ", port %d: progress_vc %d/%d, in_port_busy %d/%d, out_port_busy %d/%d\n",
+                                   vcase.ref_name.c_str(), vcase.cand_name.c_str(), radix, vcs, cycle, port,
+                                   ref_progress[port], cand_progress[port], ref_in[port], cand_in[port],
+                                   ref_out[port], cand_out[port]);
+            }
+        }
+
+        // Half of the granted packets leave their VC.  The rest ask
+        // again next cycle, which keeps reordering the LRU lists.
+        for (int port = 0; port < radix; port++) {
+            if (ref_progress[port] < 0)
+                continue;
+            grants++;
+            if (rng->nextUniform() < 0.5) {
+                int index = port * vcs + ref_progress[port];
+                delete ps->heads[index];
+                ps->heads[index] = nullptr;
+                ps->active.clear(port, ref_progress[port]);
+            }
+        }
+
+        // Now and then nothing can move for a while
+        if (vcase.stalls && rng->nextUniform() < 0.2)
+            runStall(vcase, ref_in, ref_out);
+    }
+
+    if (grants == 0) {
+        merlin_abort.fatal(CALL_INFO, -1, "merlin.bench: no grants verifying %s at radix %d, vcs %d, raise occupancy\n",
+                           vcase.cand_name.c_str(), radix, vcs);
+    }
+    if (vcase.stalls) {
+        out.output("%s matches itself across stalled cycles: radix %d, vcs %d, %" PRIu64 " cycles\n",
+                   vcase.cand_name.c_str(), radix, vcs, verify_cycles);
+    } else {
+        out.output("%s matches %s: radix %d, vcs %d, %" PRIu64 " cycles\n", vcase.cand_name.c_str(),
+                   vcase.ref_name.c_str(), radix, vcs, verify_cycles);
+    }
+}
+
+// Runs a stretch of cycles in which no output has credits, starting
+// from the busy counts the last arbitration left.  The reference is
+// arbitrated every cycle, counting the busy values down the way
+// hr_router does.  The candidate is only told about the stretch
+// afterwards, as the event driven xbar would.
+void merlin_bench::runStall(VerifyCase &vcase, std::vector<int> &in_port_busy, std::vector<int> &out_port_busy) {
+    PortSet *ps = port_sets[vcase.port_set];
+    int radix = ps->radix;
+    Cycle_t cycles = 1 + rng->generateNextUInt32() % (4 * ps->vcs);
+
+    std::vector<int> in(radix), out_busy(radix), progress(radix);
+    for (int port = 0; port < radix; port++) {
+        static_cast<bench_port *>(ps->ports[port])->setSpaceToSend(false);
+        in_port_busy[port] = std::max(in_port_busy[port] - 1, 0);
+        out_port_busy[port] = std::max(out_port_busy[port] - 1, 0);
+    }
+
+    for (Cycle_t cycle = 0; cycle < cycles; cycle++) {
+        for (int port = 0; port < radix; port++) {
+            in[port] = std::max(in_port_busy[port] - (int)cycle, 0);
+            out_busy[port] = std::max(out_port_busy[port] - (int)cycle, 0);
+        }
+#if VERIFY_DECLOCKING
+        vcase.ref->arbitrate(ps->ports.data(), in.data(), out_busy.data(), progress.data(), true);
+#else
+        vcase.ref->arbitrate(ps->ports.data(), in.data(), out_busy.data(), progress.data());
+#endif
+        for (int port = 0; port < radix; port++) {
+            if (progress[port] >= 0) {
+                merlin_abort.fatal(CALL_INFO, -1, "merlin.bench: %s granted port %d with no credits anywhere\n",
+                                   vcase.ref_name.c_str(), port);
+            }
+        }
+    }
+
+    vcase.cand->reportStalledCycles(cycles, in_port_busy.data());
+}
+
+void merlin_bench::addDragonflyWalk(const std::string &algorithm) {
+    Params tp;
+    std::string map = "[";
+    for (int i = 0; i < walk_a * walk_h; i++) {
+        map += std::to_string(i);
+        map += (i == walk_a * walk_h - 1) ? "]" : ",";
+    }
+    tp.insert("hosts_per_router", std::to_string(walk_p));
+    tp.insert("routers_per_group", std::to_string(walk_a));
+    tp.insert("intergroup_per_router", std::to_string(walk_h));
+    tp.insert("intergroup_links", "1");
+    tp.insert("num_groups", std::to_string(walk_g));
+    tp.insert("algorithm", algorithm);
+    tp.insert("global_link_map", map);
+
+    WalkCase wc;
+    wc.algorithm = algorithm;
+    wc.name = "dragonfly " + algorithm;
+    wc.ports = walk_ports;
+    wc.vcs_count_down = false;
+    wc.gossip = algorithm == "ugal-g" || algorithm == "par";
+    wc.minimal = algorithm == "minimal";
+    wc.max_routers = max_dragonfly_routers;
+    wc.far_end.assign(walk_a * walk_g * walk_ports, std::make_pair(-1, -1));
+    for (int rtr = 0; rtr < walk_a * walk_g; rtr++) {
+        auto *topo = loadAnonymousSubComponent<Topology>("merlin.dragonfly", "topology", topo_slot++,
+                                                         ComponentInfo::SHARE_NONE, tp, walk_ports, rtr);
+        if (topo == nullptr) {
+            merlin_abort.fatal(CALL_INFO, -1, "merlin.bench: unable to load merlin.dragonfly\n");
+        }
+        wc.routers.push_back(topo);
+
+        // Local ports go to the other routers of the group in order
+        int group = rtr / walk_a;
+        int local = rtr % walk_a;
+        for (int other = 0; other < walk_a; other++) {
+            if (other == local)
+                continue;
+            int port = walk_p + other - (other > local ? 1 : 0);
+            wc.far_end[rtr * walk_ports + port] =
+                std::make_pair(group * walk_a + other, walk_p + local - (local > other ? 1 : 0));
+        }
+        // Global link numbers skip the group itself when counting the
+        // other groups
+        for (int i = 0; i < walk_h; i++) {
+            int link = local * walk_h + i;
+            int other_group = link >= group ? link + 1 : link;
+            int back = group > other_group ? group - 1 : group;
+            wc.far_end[rtr * walk_ports + walk_global_start + i] =
+                std::make_pair(other_group * walk_a + back / walk_h, walk_global_start + back % walk_h);
+        }
+    }
+
+    addWalkCase(wc);
+}
+
+void merlin_bench::addGraphWalk(const std::string &file, const std::string &algorithm) {
+    std::ifstream in(file);
+    if (!in.is_open()) {
+        merlin_abort.fatal(CALL_INFO, -1, "merlin.bench: unable to open %s\n", file.c_str());
+    }
+
+    // Only the size and the links are needed here.  merlin.graph
+    // checks the rest of the file.
+    int num_routers = 0;
+    int ports = 0;
+    std::vector<std::vector<int>> links;
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream ss(line.substr(0, line.find('#')));
+        std::string keyword;
+        ss >> keyword;
+        if (keyword == "routers") {
+            ss >> num_routers;
+        } else if (keyword == "link") {
+            std::vector<int> link(4);
+            ss >> link[0] >> link[1] >> link[2] >> link[3];
+            ports = std::max(ports, std::max(link[1], link[3]) + 1);
+            links.push_back(link);
+        } else if (keyword == "endpoint") {
+            int id, rtr, port;
+            ss >> id >> rtr >> port;
+            ports = std::max(ports, port + 1);
+        }
+    }
+
+    Params tp;
+    tp.insert("file", file);
+    tp.insert("algorithm", algorithm);
+
+    WalkCase wc;
+    wc.algorithm = algorithm;
+    wc.name = "graph " + algorithm;
+    wc.ports = ports;
+    wc.vcs_count_down = true;
+    wc.gossip = false;
+    wc.minimal = true;
+    for (int rtr = 0; rtr < num_routers; rtr++) {
+        auto *topo = loadAnonymousSubComponent<Topology>("merlin.graph", "topology", topo_slot++,
+                                                         ComponentInfo::SHARE_NONE, tp, ports, rtr);
+        if (topo == nullptr) {
+            merlin_abort.fatal(CALL_INFO, -1, "merlin.bench: unable to load merlin.graph\n");
+        }
+        wc.routers.push_back(topo);
+    }
+    wc.far_end.assign(num_routers * ports, std::make_pair(-1, -1));
+    for (auto &link : links) {
+        wc.far_end[link[0] * ports + link[1]] = std::make_pair(link[2], link[3]);
+        wc.far_end[link[2] * ports + link[3]] = std::make_pair(link[0], link[1]);
+    }
+
+    addWalkCase(wc);
+}
+
+// The links come from slimfly_neighbors rather than from
+// merlin.slimfly, so the two have to agree on which router is on
+// each port
+void merlin_bench::addSlimFlyWalk(int q, int hosts_per_router, const std::vector<int> &neighbors,
+                                  const std::string &algorithm) {
+    int num_routers = 2 * q * q;
+    if (neighbors.empty() || neighbors.size() % num_routers != 0) {
+        merlin_abort.fatal(CALL_INFO, -1, "merlin.bench: slimfly_neighbors has %zu entries for %d routers\n",
+                           neighbors.size(), num_routers);
+    }
+    int router_ports = neighbors.size() / num_routers;
+    int ports = hosts_per_router + router_ports;
+
+    Params tp;
+    tp.insert("q", std::to_string(q));
+    tp.insert("hosts_per_router", std::to_string(hosts_per_router));
+    tp.insert("algorithm", algorithm);
+
+    WalkCase wc;
+    wc.algorithm = algorithm;
+    wc.name = "slimfly q=" + std::to_string(q) + " " + algorithm;
+    wc.ports = ports;
+    wc.vcs_count_down = false;
+    wc.gossip = false;
+    wc.minimal = algorithm == "minimal";
+    // Valiant routes are two minimal routes
+    wc.max_routers = 5;
+    wc.far_end.assign(num_routers * ports, std::make_pair(-1, -1));
+    for (int rtr = 0; rtr < num_routers; rtr++) {
+        auto *topo = loadAnonymousSubComponent<Topology>("merlin.slimfly", "topology", topo_slot++,
+                                                         ComponentInfo::SHARE_NONE, tp, ports, rtr);
+        if (topo == nullptr) {
+            merlin_abort.fatal(CALL_INFO, -1, "merlin.bench: unable to load merlin.slimfly\n");
+        }
+        wc.routers.push_back(topo);
+
+        for (int i = 0; i < router_ports; i++) {
+            int other = neighbors[rtr * router_ports + i];
+            auto begin = neighbors.begin() + other * router_ports;
+            auto back = std::find(begin, begin + router_ports, rtr);
+            if (back == begin + router_ports) {
+                merlin_abort.fatal(CALL_INFO, -1,
+                                   "merlin.bench: slimfly_neighbors links router %d to %d but not %d to %d\n", rtr,
+                                   other, other, rtr);
+            }
+            wc.far_end[rtr * ports + hosts_per_router + i] =
+                std::make_pair(other, hosts_per_router + (int)(back - begin));
+        }
+    }
+
+    addWalkCase(wc);
+}
+
+// Sets up what all walks share and adds wc to them
+void merlin_bench::addWalkCase(WalkCase &wc) {
+    wc.vcs = wc.routers[0]->computeNumVCs(walk_vns);
+    wc.vcs_per_vn = wc.vcs / walk_vns;
+    // Each hop of a graph packet uses a lower VC
+    if (wc.vcs_count_down)
+        wc.max_routers = wc.vcs_per_vn + 1;
+
+    size_t per_router = wc.ports * wc.vcs;
+    wc.credits.assign(wc.routers.size() * per_router, 0);
+    wc.queue_lengths.assign(wc.routers.size() * per_router, 0);
+    for (size_t rtr = 0; rtr < wc.routers.size(); rtr++) {
+        Topology *topo = wc.routers[rtr];
+        topo->setOutputBufferCreditArray(&wc.credits[rtr * per_router], wc.vcs);
+        topo->setOutputQueueLengthsArray(&wc.queue_lengths[rtr * per_router], wc.vcs);
+
+        for (int port = 0; port < wc.ports; port++) {
+            if (topo->getPortState(port) != Topology::R2N)
+                continue;
+            size_t id = topo->getEndpointID(port);
+            if (id >= wc.endpoints.size())
+                wc.endpoints.resize(id + 1, std::make_pair(-1, -1));
+            wc.endpoints[id] = std::make_pair(rtr, port);
+        }
+    }
+    for (size_t id = 0; id < wc.endpoints.size(); id++) {
+        if (wc.endpoints[id].first == -1) {
+            merlin_abort.fatal(CALL_INFO, -1, "merlin.bench: %s has no port for endpoint %zu\n", wc.name.c_str(),
+                               id);
+        }
+    }
+
+    walk_cases.push_back(std::move(wc));
+}
+
+void merlin_bench::runWalk(WalkCase &wc) {
+    int num_endpoints = wc.endpoints.size();
+
+    if (wc.gossip)
+        checkGossip(wc);
+    if (wc.minimal)
+        checkLinks(wc);
+    checkInitData(wc);
+
+    // Packets by the highest VC of their VN they reached
+    std::vector<uint64_t> top_vc(wc.vcs_per_vn, 0);
+    for (uint64_t round = 0; round < walk_rounds; round++) {
+        for (size_t i = 0; i < wc.credits.size(); i++) {
+            wc.credits[i] = rng->generateNextUInt32() % 33;
+            wc.queue_lengths[i] = rng->generateNextUInt32() % 65;
+        }
+        // Only some of the routers have gossiped since, so the rest
+        // of their group has an older picture
+        if (wc.gossip) {
+            for (size_t rtr = 0; rtr < wc.routers.size(); rtr++) {
+                if (rng->nextUniform() < 0.5)
+                    sendGossip(wc, rtr);
+            }
+        }
+
+        for (int src = 0; src < num_endpoints; src++) {
+            for (int dest = 0; dest < num_endpoints; dest++) {
+                if (src != dest)
+                    top_vc[walkPacket(wc, src, dest)]++;
+            }
+        }
+    }
+
+    // ugal-g and par send some packets over both global links of a
+    // Valiant route, and par diverts some of those on the way out of
+    // the source group, so between them they use every VC
+    if (wc.gossip && top_vc[wc.vcs_per_vn - 1] == 0) {
+        merlin_abort.fatal(CALL_INFO, -1, "merlin.bench: no %s packet used VC %d of its VN\n", wc.name.c_str(),
+                           wc.vcs_per_vn - 1);
+    }
+
+    out.output("%s routes every pair of %d endpoints, %" PRIu64 " rounds.  Packets by highest VC:", wc.name.c_str(),
+               num_endpoints, walk_rounds);
+    for (int i = 0; i < wc.vcs_per_vn; i++)
+        out.output(" %" PRIu64, top_vc[i]);
+    out.output("\n");
+}
+
+// Routes a packet from endpoint src to endpoint dest the way
+// hr_router would, with route() when it arrives at a router and
+// reroute() on each cycle it waits at the head of its VC.  Credits on
+// the router change between those cycles.  Returns the highest VC of
+// its VN the packet used between routers.
+int merlin_bench::walkPacket(WalkCase &wc, int src, int dest) {
+    int vn = rng->generateNextUInt32() % walk_vns;
+    auto *req = new SimpleNetwork::Request(dest, src, 64, true, true);
+    auto *rtr_ev = new RtrEvent(req, src, vn);
+    rtr_ev->computeSizeInFlits(64);
+
+    int router = wc.endpoints[src].first;
+    int port = wc.endpoints[src].second;
+    internal_router_event *ev = wc.routers[router]->process_input(rtr_ev);
+    int vc = ev->getVC();
+    int last_vc = -1;
+    int top = 0;
+
+    for (int hop = 0;; hop++) {
+        if (hop == wc.max_routers) {
+            merlin_abort.fatal(CALL_INFO, -1, "merlin.bench: %s packet from %d to %d went through more than %d routers\n",
+                               wc.name.c_str(), src, dest, wc.max_routers);
+        }
+
+        Topology *topo = wc.routers[router];
+        topo->route(port, vc, ev);
+        int cycles = 1 + rng->generateNextUInt32() % 3;
+        for (int cycle = 0; cycle < cycles; cycle++) {
+            if (cycle > 0) {
+                size_t index = (router * wc.ports * wc.vcs) + rng->generateNextUInt32() % (wc.ports * wc.vcs);
+                wc.credits[index] = rng->generateNextUInt32() % 33;
+                wc.queue_lengths[index] = rng->generateNextUInt32() % 65;
+            }
+            topo->reroute(port, vc, ev);
+        }
+
+        int next_port = ev->getNextPort();
+        if (topo->getPortState(next_port) == Topology::R2N) {
+            if (router != wc.endpoints[dest].first || next_port != wc.endpoints[dest].second) {
+                merlin_abort.fatal(CALL_INFO, -1, "merlin.bench: %s packet from %d to %d was delivered to %d\n",
+                                   wc.name.c_str(), src, dest, topo->getEndpointID(next_port));
+            }
+            break;
+        }
+
+        int next_vc = ev->getVC();
+        bool wrong_way = last_vc != -1 && (wc.vcs_count_down ? next_vc >= last_vc : next_vc < last_vc);
+        if (wrong_way || next_vc < vn * wc.vcs_per_vn || next_vc >= (vn + 1) * wc.vcs_per_vn) {
+            merlin_abort.fatal(CALL_INFO, -1,
+                               "merlin.bench: %s packet from %d to %d on VN %d went from VC %d to VC %d at router "
+                               "%d\n",
+                               wc.name.c_str(), src, dest, vn, last_vc, next_vc, router);
+        }
+        top = std::max(top, next_vc - vn * wc.vcs_per_vn);
+
+        const std::pair<int, int> &far_end = wc.far_end[router * wc.ports + next_port];
+        if (far_end.first == -1) {
+            merlin_abort.fatal(CALL_INFO, -1, "merlin.bench: %s sent a packet out unconnected port %d of router %d\n",
+                               wc.name.c_str(), next_port, router);
+        }
+        router = far_end.first;
+        port = far_end.second;
+        vc = next_vc;
+        last_vc = next_vc;
+    }
+
+    delete ev;
+    return top;
+}
+
+// Sends init data from each endpoint to every other one, and a
+// broadcast, forwarding it the way hr_router does during init.
+// Unicast data has to take a single path to its endpoint, and a
+// broadcast has to reach every other endpoint exactly once.
+void merlin_bench::checkInitData(WalkCase &wc) {
+    int num_endpoints = wc.endpoints.size();
+    std::vector<int> received(num_endpoints);
+    // Router and port the data arrived on
+    std::vector<std::pair<int, int>> pending;
+    std::vector<int> out_ports;
+    size_t max_hops = wc.routers.size() * wc.ports;
+
+    for (int src = 0; src < num_endpoints; src++) {
+        for (int dest = -1; dest < num_endpoints; dest++) {
+            if (dest == src)
+                continue;
+            bool broadcast = dest == -1;
+            auto *req = new SimpleNetwork::Request(broadcast ? INIT_BROADCAST_ADDR : dest, src, 64, true, true);
+            auto *rtr_ev = new RtrEvent(req, src, 0);
+            internal_router_event *ev = wc.routers[wc.endpoints[src].first]->process_InitData_input(rtr_ev);
+
+            std::fill(received.begin(), received.end(), 0);
+            pending.assign(1, wc.endpoints[src]);
+            for (size_t i = 0; i < pending.size(); i++) {
+                if (i == max_hops) {
+                    merlin_abort.fatal(CALL_INFO, -1, "merlin.bench: %s init data from %d to %d goes around in circles\n",
+                                       wc.name.c_str(), src, dest);
+                }
+                Topology *topo = wc.routers[pending[i].first];
+                out_ports.clear();
+                topo->routeInitData(pending[i].second, ev, out_ports);
+                if (!broadcast && out_ports.size() != 1) {
+                    merlin_abort.fatal(CALL_INFO, -1,
+                                       "merlin.bench: %s sent init data from %d to %d out %zu ports of router %d\n",
+                                       wc.name.c_str(), src, dest, out_ports.size(), pending[i].first);
+                }
+                for (int port : out_ports) {
+                    if (topo->getPortState(port) == Topology::R2N) {
+                        received[topo->getEndpointID(port)]++;
+                        continue;
+                    }
+                    const std::pair<int, int> &far_end = wc.far_end[pending[i].first * wc.ports + port];
+                    if (far_end.first == -1) {
+                        merlin_abort.fatal(CALL_INFO, -1,
+                                           "merlin.bench: %s sent init data out unconnected port %d of router %d\n",
+                                           wc.name.c_str(), port, pending[i].first);
+                    }
+                    pending.push_back(far_end);
+                }
+            }
+            delete ev;
+
+            for (int id = 0; id < num_endpoints; id++) {
+                int expected = (broadcast && id != src) || id == dest ? 1 : 0;
+                if (received[id] != expected) {
+                    merlin_abort.fatal(CALL_INFO, -1, "merlin.bench: %s init data from %d to %d reached %d %d times\n",
+                                       wc.name.c_str(), src, dest, id, received[id]);
+                }
+            }
+        }
+    }
+    out.output("%s delivers init data once to each of %d endpoints\n", wc.name.c_str(), num_endpoints);
+}
+
+// Sends a packet from every router to each of its neighbors and
+// checks it goes out over the link to that neighbor
+void merlin_bench::checkLinks(WalkCase &wc) {
+    // First endpoint on each router
+    std::vector<int> endpoint(wc.routers.size(), -1);
+    for (size_t id = wc.endpoints.size(); id-- > 0;)
+        endpoint[wc.endpoints[id].first] = id;
+
+    for (size_t rtr = 0; rtr < wc.routers.size(); rtr++) {
+        for (int port = 0; port < wc.ports; port++) {
+            int other = wc.far_end[rtr * wc.ports + port].first;
+            if (other == -1 || endpoint[rtr] == -1 || endpoint[other] == -1)
+                continue;
+
+            auto *req = new SimpleNetwork::Request(endpoint[other], endpoint[rtr], 64, true, true);
+            auto *rtr_ev = new RtrEvent(req, endpoint[rtr], 0);
+            rtr_ev->computeSizeInFlits(64);
+            internal_router_event *ev = wc.routers[rtr]->process_input(rtr_ev);
+            wc.routers[rtr]->route(wc.endpoints[endpoint[rtr]].second, ev->getVC(), ev);
+            int next_port = ev->getNextPort();
+            delete ev;
+
+            if (next_port != port) {
+                merlin_abort.fatal(CALL_INFO, -1,
+                                   "merlin.bench: %s sends packets for router %d out port %d of router %zu, but the "
+                                   "link to it is on port %d\n",
+                                   wc.name.c_str(), other, next_port, rtr, port);
+            }
+        }
+    }
+    out.output("%s takes the direct link to every neighboring router\n", wc.name.c_str());
+}
+
+// What router's gossip timer would send the rest of its group: the
+// flits queued on each of its global links
+void merlin_bench::sendGossip(WalkCase &wc, int router) {
+    std::vector<int32_t> occupancy(walk_h, 0);
+    for (int i = 0; i < walk_h; i++) {
+        for (int vc = 0; vc < wc.vcs; vc++)
+            occupancy[i] += wc.queue_lengths[(router * walk_ports + walk_global_start + i) * wc.vcs + vc];
+    }
+
+    int group = router / walk_a;
+    int local = router % walk_a;
+    for (int other = 0; other < walk_a; other++) {
+        if (other == local)
+            continue;
+        int port = walk_p + local - (local > other ? 1 : 0);
+        wc.routers[group * walk_a + other]->recvTopologyEvent(
+            port, new topo_dragonfly_gossip_event(1, local, occupancy));
+    }
+}
+
+// Router 0 of group 0 reaches group 3 over the first global link of
+// router 1, so it only learns that link is backed up from router 1's
+// gossip.  With every other queue empty, a packet from router 0 to
+// group 3 has to go minimally before that gossip arrives and take a
+// Valiant route after.  Router 1 sees its own queue, so par diverts
+// the minimal packet there onto the next VC, while ugal-g sends it
+// out over the global link.
+void merlin_bench::checkGossip(WalkCase &wc) {
+    std::fill(wc.credits.begin(), wc.credits.end(), 32);
+    std::fill(wc.queue_lengths.begin(), wc.queue_lengths.end(), 0);
+    for (size_t rtr = 0; rtr < wc.routers.size(); rtr++)
+        sendGossip(wc, rtr);
+
+    int link_router = 1;
+    int dest_group = link_router * walk_h + 1;
+    wc.queue_lengths[(link_router * walk_ports + walk_global_start) * wc.vcs] = 1000;
+
+    for (int gossiped = 0; gossiped < 2; gossiped++) {
+        if (gossiped)
+            sendGossip(wc, link_router);
+
+        auto *req = new SimpleNetwork::Request(dest_group * walk_a * walk_p, 0, 64, true, true);
+        auto *rtr_ev = new RtrEvent(req, 0, 0);
+        rtr_ev->computeSizeInFlits(64);
+        auto *ev = static_cast<topo_dragonfly_event *>(wc.routers[0]->process_input(rtr_ev));
+        int vc = ev->getVC();
+        wc.routers[0]->route(0, vc, ev);
+        wc.routers[0]->reroute(0, vc, ev);
+        bool valiant = ev->dest.mid_group != ev->dest.group;
+        if (valiant != (gossiped == 1)) {
+            merlin_abort.fatal(CALL_INFO, -1, "merlin.bench: %s took a %s route to group %d %s router %d's gossip\n",
+                               wc.name.c_str(), valiant ? "Valiant" : "minimal", dest_group,
+                               gossiped ? "after" : "before", link_router);
+        }
+
+        if (!gossiped) {
+            int router;
+            int port;
+            std::tie(router, port) = wc.far_end[ev->getNextPort()];
+            wc.routers[router]->route(port, vc, ev);
+            wc.routers[router]->reroute(port, vc, ev);
+            bool diverted = ev->getVC() != vc;
+            if (diverted != (wc.algorithm == "par") || diverted == (ev->dest.mid_group == ev->dest.group)) {
+                merlin_abort.fatal(CALL_INFO, -1, "merlin.bench: %s %s a packet at router %d onto VC %d\n",
+                                   wc.name.c_str(), diverted ? "diverted" : "did not divert", router,
+                                   ev->getVC());
+            }
+        }
+        delete ev;
+    }
+    out.output("%s leaves a global link that only gossip shows is backed up\n", wc.name.c_str());
+}
+
+bool merlin_bench::end_handler(Cycle_t /*cycle*/) {
+    // Nothing left to do, unregister the clock
+    return true;
+}
@@ -0,0 +1,280 @@
+// -*- mode: c++ -*-
+
+// Copyright 2009-2020 NTESS. Under the terms
+// of Contract DE-NA0003525 with NTESS, the U.S.
+// Government retains certain rights in this software.
+//
+// Copyright (c) 2009-2020, NTESS
+// All rights reserved.
+//
+// Portions are copyright of other developers:
+// See the file CONTRIBUTORS.TXT in the top level directory
+// the distribution for more information.
+//
+// This file is part of the SST software package. For license
+// information, see the LICENSE file in the top level directory of the
+// distribution.
+
+#ifndef COMPONENTS_MERLIN_TEST_BENCH_MERLIN_BENCH_H
+#define COMPONENTS_MERLIN_TEST_BENCH_MERLIN_BENCH_H
+
+#include <sst/core/component.h>
+#include <sst/core/output.h>
+#include <sst/core/rng/sstrng.h>
+
+#include <string>
+#include <vector>
+
+#include "../../merlin.h"
+#include "../../router.h"
+
+namespace SST {
+namespace Merlin {
+
+// PortInterface that never changes on its own.  recv() hands back the
+// VC head without removing it and spaceToSend() says yes unless told
+// otherwise, so the arbiter sees the same full set of requests every
+// time it is called.
+class bench_port : public PortInterface {
+  public:
+    SST_ELI_REGISTER_SUBCOMPONENT_DERIVED(bench_port, "merlin", "bench_port", SST_ELI_ELEMENT_VERSION(1, 0, 0),
+                                          "Static port used by merlin.bench to drive xbar arbiters",
+                                          SST::Merlin::PortInterface)
+
+    SST_ELI_DOCUMENT_PARAMS()
+
+    bench_port(ComponentId_t cid, Params & /*params*/, Router * /*rif*/, int /*rtr_id*/, int /*port_number*/,
+               Topology * /*topo*/)
+        : PortInterface(cid) {}
+    ~bench_port() override = default;
+
+    void setVCHeads(internal_router_event **heads) { vc_heads = heads; }
+    // Answer for every VC of this port when spaceToSend() is called
+    void setSpaceToSend(bool space_s) { space = space_s; }
+
+    void sendTopologyEvent(TopologyEvent *ev) override { delete ev; }
+    void send(internal_router_event * /*ev*/, int /*vc*/) override {}
+    bool spaceToSend(int /*vc*/, int /*flits*/) override { return space; }
+    internal_router_event *recv(int vc) override { return vc_heads[vc]; }
+    internal_router_event **getVCHeads() override { return vc_heads; }
+
+    void initVCs(int /*vns*/, int * /*vcs_per_vn*/, internal_router_event ** /*vc_heads*/, int * /*xbar_in_credits*/,
+                 int * /*output_queue_lengths*/) override {}
+
+    void sendInitData(Event *ev) override { delete ev; }
+    Event *recvInitData() override { return nullptr; }
+    void sendUntimedData(Event *ev) override { delete ev; }
+    Event *recvUntimedData() override { return nullptr; }
+
+    bool decreaseLinkWidth() override { return false; }
+    bool increaseLinkWidth() override { return false; }
+
+  private:
+    internal_router_event **vc_heads{nullptr};
+    bool space{true};
+};
+
+// Times the routing and crossbar arbitration kernels outside of a
+// running simulation.  All the objects are loaded in the constructor
+// and the measurements are taken in setup().  The component registers
+// no links, so the simulation ends as soon as setup() is done.
+//
+// With verify_arbiters or verify_stalls set nothing is timed.  Instead
+// each pair of arbiters is driven with the same random VC occupancy,
+// port backpressure and busy inputs and outputs, and the run fails on
+// the first cycle where their grants differ.  The simulation then runs for
+// a single 1 ns cycle so that the output does not depend on the
+// machine.
+class merlin_bench : public Component {
+
+  public:
+    SST_ELI_REGISTER_COMPONENT(merlin_bench, "merlin", "bench", SST_ELI_ELEMENT_VERSION(1, 0, 0),
+                               "Microbenchmark for topology routing and xbar arbitration.",
+                               COMPONENT_CATEGORY_UNCATEGORIZED)
+
+    SST_ELI_DOCUMENT_PARAMS(
+        {"topologies", "Topologies to time route() and reroute() on [torus, mesh, hyperx, dragonfly, fattree].",
+         "[torus, mesh, hyperx, dragonfly, fattree]"},
+        {"arbiters", "Xbar arbiters to time.",
+         "[merlin.xbar_arb_rr, merlin.xbar_arb_lru, merlin.xbar_arb_lru_sparse, merlin.xbar_arb_lru_infx, "
+         "merlin.xbar_arb_age, merlin.xbar_arb_rand, merlin.xbar_arb_islip, merlin.xbar_arb_wavefront]"},
+        {"radices", "Router radices to run at.  The dragonfly is only run at the largest one since all dragonfly "
+                    "instances share one global link map.",
+         "[8, 16, 32, 48, 64, 96, 128]"},
+        {"vcs", "Number of VCs per port to run the arbiters at.", "[2, 4, 8]"},
+        {"occupancy", "Fraction of VC heads that hold an event when timing the arbiters.", "0.5"},
+        {"route_iterations", "Number of route() and reroute() calls to time for each topology.  Each call gets a "
+                             "freshly copied packet.", "1000000"},
+        {"arb_iterations", "Number of arbitrate() calls to time for each arbiter.", "100000"},
+        {"seed", "Seed for the destinations and VC head contents.", "1"},
+        {"verify_arbiters", "Pairs of arbiters that must make identical grants, listed as reference followed by "
+                            "candidate, e.g. [merlin.xbar_arb_lru, merlin.xbar_arb_lru_sparse].  If set, the "
+                            "timing runs are skipped and each pair is checked at every radix and VC count instead.",
+         "[]"},
+        {"verify_cycles", "Number of arbitration cycles to compare for each verify_arbiters pair and size.", "10000"},
+        {"verify_stalls", "Arbiters that must make the same grants when a run of cycles where nothing can move is "
+                          "reported through reportStalledCycles() instead of being arbitrated, as the event driven "
+                          "xbar does.  Each is checked against a copy of itself that arbitrates every cycle.  Runs "
+                          "alongside verify_arbiters and also skips the timing runs.",
+         "[]"},
+        {"reference:*", "Parameters passed to the reference arbiter of each verify_arbiters pair, e.g. "
+                        "reference:sort_requests to check an arbiter against its own heap path.", ""},
+        {"age_range", "VC heads are given an injection time in this many of the most recent cycles.  Small values "
+                      "give the age based arbiters many equal ages.", "4096"},
+        {"old_fraction", "Fraction of VC heads injected about a million cycles before the rest.  A few of these "
+                         "leave the other ages crowded together at one end of the key range.", "0"},
+        {"dragonfly_walks", "Dragonfly routing algorithms to walk packets through, e.g. [ugal-g, par].  Every router "
+                            "of a 72 host dragonfly is loaded and a packet between every pair of hosts is routed "
+                            "hop by hop, under random credits and queue lengths.  The run fails if a packet doesn't "
+                            "reach its host or leaves the VCs of its VN.  Also skips the timing runs.",
+         "[]"},
+        {"graph_file", "File for the graph_walks to load merlin.graph from.", ""},
+        {"graph_walks", "merlin.graph routing algorithms to walk packets through, the same way as dragonfly_walks.  "
+                        "Init data is also sent between every pair of endpoints and broadcast from each one.",
+         "[]"},
+        {"slimfly_walks", "merlin.slimfly routing algorithms to walk packets through, the same way as "
+                          "dragonfly_walks.", "[]"},
+        {"slimfly_q", "q of the Slim Fly for slimfly_walks.", "5"},
+        {"slimfly_hosts_per_router", "Hosts on each router of the Slim Fly for slimfly_walks.", "2"},
+        {"slimfly_neighbors", "Neighbors of each Slim Fly router in port order, as pymerlin's topoSlimFly wires "
+                              "them, one router after another.  The walks run over these links, so they fail "
+                              "if merlin.slimfly numbers its ports differently.", "[]"},
+        {"walk_rounds", "Number of times each walk routes a packet between every pair of hosts, each with new "
+                        "credits and queue lengths.", "20"}, )
+
+    SST_ELI_DOCUMENT_PORTS()
+
+    SST_ELI_DOCUMENT_SUBCOMPONENT_SLOTS({"topology", "Topologies being timed", "SST::Merlin::Topology"},
+                                        {"arbiter", "Arbiters being timed", "SST::Merlin::XbarArbitration"},
+                                        {"port", "Ports feeding the arbiters", "SST::Merlin::PortInterface"})
+
+    merlin_bench(ComponentId_t cid, Params &params);
+    ~merlin_bench() override;
+
+    void setup() override;
+
+  private:
+    struct TopoCase {
+        std::string name;
+        int radix;
+        Topology *topo;
+        std::vector<int> credits;
+        std::vector<int> queue_lengths;
+        // Events as returned by process_input().  Only copies are routed.
+        std::vector<internal_router_event *> events;
+        std::vector<int> start_vcs;
+        std::vector<int> in_ports;
+    };
+
+    struct ArbCase {
+        std::string name;
+        int radix;
+        int vcs;
+        XbarArbitration *arb;
+        // Index into port_sets
+        int port_set;
+    };
+
+    struct VerifyCase {
+        std::string ref_name;
+        std::string cand_name;
+        XbarArbitration *ref;
+        XbarArbitration *cand;
+        // Candidate skips stalled cycles instead of arbitrating them
+        bool stalls;
+        // Index into port_sets
+        int port_set;
+    };
+
+    // Every router of one network, each with its own credits and
+    // queue lengths, indexed by router * ports * vcs
+    struct WalkCase {
+        std::string algorithm;
+        // Topology and algorithm, for messages
+        std::string name;
+        std::vector<Topology *> routers;
+        int ports;
+        int vcs;
+        int vcs_per_vn;
+        // Whether the VC goes down from one link to the next rather
+        // than up
+        bool vcs_count_down;
+        // Whether the routers expect each other's gossip
+        bool gossip;
+        // Whether packets for a neighboring router always take the
+        // link to it
+        bool minimal;
+        int max_routers;
+        std::vector<int> credits;
+        std::vector<int> queue_lengths;
+        // Router and port at the other end of each router port,
+        // indexed by router * ports + port.  -1 for ports without a
+        // router to router link.
+        std::vector<std::pair<int, int>> far_end;
+        // Router and port of each endpoint
+        std::vector<std::pair<int, int>> endpoints;
+    };
+
+    struct PortSet {
+        int radix;
+        int vcs;
+        std::vector<PortInterface *> ports;
+        std::vector<internal_router_event *> heads;
+        ActiveVCMap active;
+    };
+
+    Output out;
+
+    uint64_t route_iterations;
+    uint64_t arb_iterations;
+    double occupancy;
+    uint32_t seed;
+    uint64_t verify_cycles;
+    Params reference_params;
+    uint32_t age_range;
+    double old_fraction;
+    uint64_t walk_rounds;
+    RNG::SSTRandom *rng;
+
+    std::vector<TopoCase> topo_cases;
+    std::vector<ArbCase> arb_cases;
+    std::vector<PortSet *> port_sets;
+    std::vector<VerifyCase> verify_cases;
+    std::vector<WalkCase> walk_cases;
+
+    // Next free index in each of the subcomponent slots
+    int topo_slot;
+    int arb_slot;
+    int port_slot;
+
+    void addTopology(const std::string &name, int radix, bool precomputed);
+    int getPortSet(int radix, int vcs);
+    XbarArbitration *loadArbiter(const std::string &name, Params &arb_params);
+    internal_router_event *makeHead(int radix, int vcs, int flits);
+
+    void copyEvents(TopoCase &tc, std::vector<internal_router_event *> &batch, size_t count);
+    void freeEvents(std::vector<internal_router_event *> &batch, size_t count);
+    void runTopology(TopoCase &tc);
+    void runArbiter(ArbCase &ac);
+    void addVerifyCase(const std::string &ref_name, const std::string &cand_name, Params &ref_params, int radix,
+                       int vcs, bool stalls);
+    void runVerify(VerifyCase &vcase);
+    void runStall(VerifyCase &vcase, std::vector<int> &in_port_busy, std::vector<int> &out_port_busy);
+    void addDragonflyWalk(const std::string &algorithm);
+    void addGraphWalk(const std::string &file, const std::string &algorithm);
+    void addSlimFlyWalk(int q, int hosts_per_router, const std::vector<int> &neighbors, const std::string &algorithm);
+    void addWalkCase(WalkCase &wc);
+    void runWalk(WalkCase &wc);
+    void sendGossip(WalkCase &wc, int router);
+    void checkGossip(WalkCase &wc);
+    void checkInitData(WalkCase &wc);
+    void checkLinks(WalkCase &wc);
+    int walkPacket(WalkCase &wc, int src, int dest);
+
+    bool end_handler(Cycle_t cycle);
+};
+
+} // namespace Merlin
+} // namespace SST
+
+#endif // COMPONENTS_MERLIN_TEST_BENCH_MERLIN_BENCH_H
@@ -0,0 +1,29 @@
+#!/usr/bin/env python
+#
+# Copyright 2009-2020 NTESS. Under the terms
+# of Contract DE-NA0003525 with NTESS, the U.S.
+# Government retains certain rights in this software.
+#
+# Copyright (c) 2009-2020, NTESS
+# All rights reserved.
+#
+# This file is part of the SST software package. For license
+# information, see the LICENSE file in the top level directory of the
+# distribution.
+
+# Runs the routing and arbitration microbenchmark.  Everything is
+# timed during setup, so the simulation itself is empty.  merlin.bench
+# is only built with -DMERLIN_ENABLE_BENCH=ON.
+
+import sst
+
+bench = sst.Component("bench", "merlin.bench")
+bench.addParams({
+    "topologies" : "[torus, mesh, hyperx, dragonfly, fattree]",
+    "arbiters" : "[merlin.xbar_arb_rr, merlin.xbar_arb_lru, merlin.xbar_arb_lru_sparse, merlin.xbar_arb_lru_infx, merlin.xbar_arb_age, merlin.xbar_arb_rand, merlin.xbar_arb_islip, merlin.xbar_arb_wavefront]",
+    "radices" : "[8, 16, 32, 48, 64, 96, 128]",
+    "vcs" : "[2, 4, 8]",
+    "occupancy" : 0.5,
+    "route_iterations" : 1000000,
+    "arb_iterations" : 100000,
+})
@@ -0,0 +1,160 @@
+#!/usr/bin/env python
+#
+# Copyright 2009-2020 NTESS. Under the terms
+# of Contract DE-NA0003525 with NTESS, the U.S.
+# Government retains certain rights in this software.
+#
+# Copyright (c) 2009-2020, NTESS
+# All rights reserved.
+#
+# This file is part of the SST software package. For license
+# information, see the LICENSE file in the top level directory of the
+# distribution.
+
+# Checks that arbiters make the same grants as a reference, either the
+# code they replaced or themselves run a different way.  Each bench
+# aborts on the first cycle where a pair differs, so a clean exit is a
+# pass.  merlin.bench is only built with -DMERLIN_ENABLE_BENCH=ON.
+
+import os
+import sys
+
+import sst
+from sst.merlin import topoSlimFly
+
+# The age and rand arbiters bucket sort their requests.  The reference
+# copy of each is loaded with sorting off, so it grants every cycle
+# from a heap the way std::priority_queue did.
+arb_pairs = "[merlin.xbar_arb_age, merlin.xbar_arb_age, merlin.xbar_arb_rand, merlin.xbar_arb_rand]"
+
+# Ages spread over 4096 cycles, which mostly takes the sorted path
+sorted_bench = sst.Component("sorted", "merlin.bench")
+sorted_bench.addParams({
+    "verify_arbiters" : arb_pairs,
+    "reference:sort_requests" : "false",
+    "radices" : "[8, 16, 32, 64, 128]",
+    "vcs" : "[1, 2, 4, 8]",
+    "occupancy" : 0.5,
+    "verify_cycles" : 3000,
+    "seed" : 1,
+})
+
+# Only two distinct ages, so requests with equal keys regularly share
+# an input or an output and the age arbiter has to fall back to the
+# heap
+ties_bench = sst.Component("ties", "merlin.bench")
+ties_bench.addParams({
+    "verify_arbiters" : arb_pairs,
+    "reference:sort_requests" : "false",
+    "radices" : "[8, 16, 32, 64, 128]",
+    "vcs" : "[1, 2, 4, 8]",
+    "occupancy" : 0.5,
+    "verify_cycles" : 3000,
+    "age_range" : 2,
+    "seed" : 2,
+})
+
+# A few heads are about a million cycles older than the rest, which
+# crowds the other ages into one or two buckets and makes the age
+# arbiter finish its sort with std::sort
+skewed_bench = sst.Component("skewed", "merlin.bench")
+skewed_bench.addParams({
+    "verify_arbiters" : arb_pairs,
+    "reference:sort_requests" : "false",
+    "radices" : "[16, 32, 64, 128]",
+    "vcs" : "[2, 4, 8]",
+    "occupancy" : 0.5,
+    "verify_cycles" : 3000,
+    "old_fraction" : 0.02,
+    "seed" : 4,
+})
+
+# xbar_arb_lru_sparse walks only the VCs that hold data.  It has to
+# keep the same LRU order as xbar_arb_lru, both with about half the
+# VCs full and with most of them empty, which is the case it is
+# meant for.
+lru_pair = "[merlin.xbar_arb_lru, merlin.xbar_arb_lru_sparse]"
+
+lru_bench = sst.Component("lru", "merlin.bench")
+lru_bench.addParams({
+    "verify_arbiters" : lru_pair,
+    "radices" : "[8, 16, 32, 64, 128]",
+    "vcs" : "[1, 2, 4, 8]",
+    "occupancy" : 0.5,
+    "verify_cycles" : 3000,
+    "seed" : 5,
+})
+
+lru_sparse_bench = sst.Component("lru_sparse", "merlin.bench")
+lru_sparse_bench.addParams({
+    "verify_arbiters" : lru_pair,
+    "radices" : "[8, 16, 32, 64, 128]",
+    "vcs" : "[1, 2, 4, 8]",
+    "occupancy" : 0.05,
+    "verify_cycles" : 3000,
+    "seed" : 6,
+})
+
+# The event driven xbar doesn't arbitrate cycles on which nothing can
+# move and reports them to the arbiter afterwards.  Arbiters whose
+# state moves on every clocked cycle have to end up where a clocked
+# router would have left them.  The wavefront arbiter rotates its
+# priority diagonal every cycle.  iSLIP only moves its pointers on a
+# grant, so it has to come out the same with nothing to catch up on.
+stalls_bench = sst.Component("stalls", "merlin.bench")
+stalls_bench.addParams({
+    "verify_stalls" : "[merlin.xbar_arb_rr, merlin.xbar_arb_rand, merlin.xbar_arb_wavefront, merlin.xbar_arb_islip]",
+    "radices" : "[8, 16, 32, 64]",
+    "vcs" : "[1, 2, 3, 4, 8]",
+    "occupancy" : 0.5,
+    "verify_cycles" : 3000,
+    "seed" : 3,
+})
+
+# Routes every host pair of a 72 host dragonfly hop by hop, rerouting
+# packets a few times at each router while the credits change under
+# them.  Packets have to arrive at the right host without their VC
+# ever going down or leaving their VN.  ugal-g and par also have to
+# act on another router's gossip, and between them use every VC par
+# asks for.
+dragonfly_bench = sst.Component("dragonfly", "merlin.bench")
+dragonfly_bench.addParams({
+    "dragonfly_walks" : "[minimal, valiant, adaptive-local, ugal-g, par]",
+    "walk_rounds" : 20,
+    "seed" : 7,
+})
+
+# The same walk through merlin.graph, which takes the VC down on every
+# hop.  Init data, which can't use the routing table, has to follow
+# the BFS tree to its endpoint.
+graph_bench = sst.Component("graph", "merlin.bench")
+graph_bench.addParams({
+    "graph_file" : os.path.join(os.path.dirname(os.path.abspath(sys.argv[0])), "graph_8.txt"),
+    "graph_walks" : "[ecmp, adaptive]",
+    "walk_rounds" : 20,
+    "seed" : 8,
+})
+
+# Slim Fly routers, walked over the links pymerlin's topoSlimFly would
+# wire them with.  merlin.slimfly and topoSlimFly each build GF(q) and
+# the MMS graph from it, and both have to number the ports the same
+# way.  q = 5 is walked with both algorithms.  The other q cover the
+# other cases of the construction: prime q = 3 mod 4, and prime
+# powers.
+for (q, rounds) in [(5, 20), (3, 2), (4, 2), (7, 2), (8, 2), (9, 2)]:
+    sst.merlin._params["slimfly:q"] = q
+    slimfly = topoSlimFly()
+    slimfly.field = slimfly._buildField(q)
+    neighbors = []
+    for r in range(2 * q * q):
+        neighbors.extend(slimfly.getNeighbors(r))
+
+    slimfly_bench = sst.Component("slimfly_%d"%q, "merlin.bench")
+    slimfly_bench.addParams({
+        "slimfly_walks" : "[minimal, ugal]",
+        "slimfly_q" : q,
+        "slimfly_hosts_per_router" : 2,
+        "slimfly_neighbors" : str(neighbors),
+        "walk_rounds" : rounds,
+        "seed" : 9,
+    })
@@ -28,7 +28,8 @@ using namespace SST::Interfaces;
 
 namespace Merlin {
 
-bisection_test::bisection_test(ComponentId_t cid, Params &params) : Component(cid), packets_sent(0), packets_recd(0) {
+bisection_test::bisection_test(ComponentId_t cid, Params &params)
+    : Component(cid), packets_sent(0), packets_recd(0), bw(0), result(nullptr) {
     // id = params.find_integer("id");
     // if ( id == -1 ) {
     // }
@@ -174,6 +175,35 @@ bool bisection_test::receive_handler(int vn) {
 
 void bisection_test::finish() { link_control->finish(); }
 
+void bisection_test::complete(unsigned int phase) {
+    link_control->complete(phase);
+
+    if (phase == 0) {
+        result = new bisection_test_result_event(bw);
+        reduction.init(id, num_peers, 1);
+    }
+    bool ready = reduction.progress(link_control, [this](Event *ev) {
+        auto *child = static_cast<bisection_test_result_event *>(ev);
+        result->sum += child->sum;
+        result->min = child->min < result->min ? child->min : result->min;
+        result->max = child->max > result->max ? child->max : result->max;
+        result->count += child->count;
+        delete child;
+    });
+    if (!ready)
+        return;
+    if (!reduction.isRoot()) {
+        reduction.send(link_control, result);
+    } else {
+        cout << "Bisection BW over " << result->count << " endpoints:" << endl;
+        cout << "  Total BW = " << result->sum << " Gbits/sec" << endl;
+        cout << "  Min BW = " << result->min << " Gbits/sec" << endl;
+        cout << "  Max BW = " << result->max << " Gbits/sec" << endl;
+        delete result;
+    }
+    result = nullptr;
+}
+
 void bisection_test::init(unsigned int phase) { link_control->init(phase); }
 
 void bisection_test::handle_complete(Event *ev) {
@@ -185,7 +215,7 @@ void bisection_test::handle_complete(Event *ev) {
 
     double total_sent = (packet_size * packets_to_send);
     double total_time = (double)end_time - double(start_time);
-    double bw = total_sent / total_time;
+    bw = total_sent / total_time;
 
     cout << id << ":" << endl;
     // cout << "Latency = " << latency << " ns" << endl;
@@ -25,9 +25,13 @@
 
 #include <sst/core/interfaces/simpleNetwork.h>
 
+#include "../../reduction_tree.h"
+
 namespace SST {
 namespace Merlin {
 
+class bisection_test_result_event;
+
 class bisection_test : public Component {
 
   public:
@@ -56,6 +60,10 @@ class bisection_test : public Component {
     int packets_recd;
 
     SimTime_t start_time;
+    // Bandwidth this endpoint measured, in Gbits/sec
+    double bw;
+    ReductionTree reduction;
+    bisection_test_result_event *result;
 
     int packets_to_send;
     int packet_size;
@@ -70,6 +78,7 @@ class bisection_test : public Component {
 
     void init(unsigned int phase) override;
     void setup() override;
+    void complete(unsigned int phase) override;
     void finish() override;
 
   private:
@@ -96,6 +105,32 @@ class bisection_test_event : public Event {
   private:
     ImplementSerializable(SST::Merlin::bisection_test_event)
 };
+
+// Bandwidth results reduced to endpoint 0 at the end of the run
+class bisection_test_result_event : public Event {
+
+  public:
+    double sum;
+    double min;
+    double max;
+    int count;
+
+    bisection_test_result_event() = default;
+    bisection_test_result_event(double bw) : Event(), sum(bw), min(bw), max(bw), count(1) {}
+
+    Event *clone() override { return new bisection_test_result_event(*this); }
+
+    void serialize_order(SST::Core::Serialization::serializer &ser) override {
+        Event::serialize_order(ser);
+        ser &sum;
+        ser &min;
+        ser &max;
+        ser &count;
+    }
+
+  private:
+    ImplementSerializable(SST::Merlin::bisection_test_result_event)
+};
 } // namespace Merlin
 } // namespace SST
 #endif // COMPONENTS_MERLIN_TEST_NIC_H
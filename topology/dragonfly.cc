@@ -20,6 +20,7 @@
 
 #include "dragonfly.h"
 
+#include <algorithm>
 #include <cstdlib>
 #include <sstream>
 
@@ -42,7 +43,9 @@ void RouteToGroup::setRouterPortPair(int group, int route_number, const RouterPo
     region->modifyArray(group * routes + route_number, pair);
 }
 
-topo_dragonfly::topo_dragonfly(ComponentId_t cid, Params &p, int num_ports, int rtr_id) : Topology(cid) {
+topo_dragonfly::topo_dragonfly(ComponentId_t cid, Params &p, int num_ports, int rtr_id)
+    : Topology(cid), output_credits(nullptr), output_queue_lengths(nullptr), num_vcs(0), gossip_timer(nullptr),
+      gossip_scheduled(false), gossip_flits(0) {
     params.p = p.find<uint32_t>("hosts_per_router");
     params.a = p.find<uint32_t>("routers_per_group");
     params.k = num_ports;
@@ -61,6 +64,15 @@ topo_dragonfly::topo_dragonfly(ComponentId_t cid, Params &p, int num_ports, int
 
     std::string route_algo = p.find<std::string>("algorithm", "minimal");
 
+    std::string routing_table = p.find<std::string>("routing_table", "computed");
+    if (routing_table == "computed")
+        use_routing_table = false;
+    else if (routing_table == "precomputed")
+        use_routing_table = true;
+    else {
+        output.fatal(CALL_INFO, -1, "Invalid routing_table specified: %s.\n", routing_table.c_str());
+    }
+
     adaptive_threshold = p.find<double>("adaptive_threshold", 2.0);
 
     // Get the global link map
@@ -122,6 +134,13 @@ topo_dragonfly::topo_dragonfly(ComponentId_t cid, Params &p, int num_ports, int
         }
     } else if (!route_algo.compare("adaptive-local")) {
         algorithm = ADAPTIVE_LOCAL;
+    } else if (!route_algo.compare("ugal-g") || !route_algo.compare("par")) {
+        if (params.g <= 2) {
+            /* 2 or less groups... no valiant routes to choose */
+            algorithm = MINIMAL;
+        } else {
+            algorithm = route_algo == "par" ? PAR : UGAL_GLOBAL;
+        }
     } else {
         algorithm = MINIMAL;
     }
@@ -131,15 +150,49 @@ topo_dragonfly::topo_dragonfly(ComponentId_t cid, Params &p, int num_ports, int
 
     rng = new RNG::XORShiftRNG(rtr_id + 1);
 
+    if (algorithm == UGAL_GLOBAL || algorithm == PAR) {
+        gossip_flits = p.find<int>("gossip_flits", 1);
+        std::string gossip_period = p.find<std::string>("gossip_period", "100ns");
+        gossip_timer = configureSelfLink("gossip_timer", gossip_period,
+                                         new Event::Handler<topo_dragonfly>(this, &topo_dragonfly::handleGossip));
+        last_gossip.assign(params.h, 0);
+        global_occupancy.assign(params.a * params.h, 0);
+    }
+
     output.verbose(CALL_INFO, 1, 1, "%u:%u:  ID: %u   Params:  p = %u  a = %u  k = %u  h = %u  g = %u\n", group_id,
                    router_id, rtr_id, params.p, params.a, params.k, params.h, params.g);
 }
 
 topo_dragonfly::~topo_dragonfly() = default;
 
+void topo_dragonfly::setup() {
+    if (use_routing_table)
+        buildRoutingTable();
+}
+
+void topo_dragonfly::buildRoutingTable() {
+    // Route to our own group is never looked up, so leave it as 0
+    std::vector<uint16_t> table(params.g * params.n, 0);
+    for (uint32_t group = 0; group < params.g; group++) {
+        if (group == group_id)
+            continue;
+        for (uint32_t slice = 0; slice < params.n; slice++) {
+            table[group * params.n + slice] = compute_port_for_group(group, slice);
+        }
+    }
+    group_port_table.swap(table);
+}
+
 void topo_dragonfly::route(int port, int vc, internal_router_event *ev) {
     auto *td_ev = static_cast<topo_dragonfly_event *>(ev);
 
+    // Traffic may be building up on the global links, so make sure
+    // the group hears about it
+    if (gossip_timer != nullptr && !gossip_scheduled && router != nullptr) {
+        gossip_scheduled = true;
+        gossip_timer->send(1, nullptr);
+    }
+
     // Break this up by port type
     uint32_t next_port = 0;
     if ((uint32_t)port < params.p) {
@@ -210,6 +263,10 @@ void topo_dragonfly::route(int port, int vc, internal_router_event *ev) {
 }
 
 void topo_dragonfly::reroute(int port, int vc, internal_router_event *ev) {
+    if (algorithm == UGAL_GLOBAL || algorithm == PAR) {
+        rerouteGlobal(port, vc, static_cast<topo_dragonfly_event *>(ev));
+        return;
+    }
     if (algorithm != ADAPTIVE_LOCAL)
         return;
 
@@ -334,6 +391,199 @@ void topo_dragonfly::reroute(int port, int vc, internal_router_event *ev) {
     // }
 }
 
+// UGAL with global information.  Costs are queued flits on the way to
+// the global link times the hops left, where the queue on a global
+// link that belongs to another router in the group comes from that
+// router's gossip.  The Valiant route is taken when the minimal cost
+// is more than adaptive_threshold times the Valiant cost.
+//
+// With par, a packet the source router sends minimally is looked at
+// again by the router holding its global link.  If the Valiant route
+// looks better from there, the packet is diverted, bumping its VC for
+// the extra hop in the source group.
+void topo_dragonfly::rerouteGlobal(int port, int vc, topo_dragonfly_event *td_ev) {
+    uint32_t global_start = params.p + params.a - 1;
+
+    if (td_ev->dest.group == group_id) {
+        // Only packets from hosts in this group get a choice
+        if ((uint32_t)port >= params.p || td_ev->dest.router == router_id)
+            return;
+
+        int direct_route_port = port_for_router(td_ev->dest.router);
+        int valiant_route_port = port_for_router(td_ev->dest.mid_group);
+        int direct_cost = portQueueLength(direct_route_port);
+        int valiant_cost = 2 * portQueueLength(valiant_route_port);
+        if (direct_cost > (int)((double)valiant_cost * adaptive_threshold)) {
+            td_ev->setNextPort(valiant_route_port);
+        } else {
+            td_ev->setNextPort(direct_route_port);
+        }
+        return;
+    }
+
+    if ((uint32_t)port >= global_start) {
+        // Entering an intermediate group.  Pick the better of two
+        // slices to the destination group.
+        int port1;
+        int port2;
+        int slice1 = td_ev->global_slice_shadow;
+        int slice2 = (td_ev->global_slice_shadow + 1) % params.n;
+        int cost1 = ugalCost(td_ev->dest.group, slice1, 1, port1);
+        int cost2 = ugalCost(td_ev->dest.group, slice2, 1, port2);
+        if (cost2 < cost1) {
+            td_ev->global_slice = slice2;
+            td_ev->setNextPort(port2);
+        } else {
+            td_ev->global_slice = slice1;
+            td_ev->setNextPort(port1);
+        }
+        return;
+    }
+
+    bool at_source = (uint32_t)port < params.p;
+    if (!at_source) {
+        // Only par looks at packets again in the source group, and
+        // only at the router they were first sent to.  A packet that
+        // has been diverted has already moved up a VC.
+        int base_vc = td_ev->getVN() * 4;
+        if (algorithm != PAR || !td_ev->progressive || td_ev->src_group != group_id || vc != base_vc)
+            return;
+    }
+
+    int direct_slice;
+    int direct_route_port;
+    int direct_cost;
+    if (at_source) {
+        int port1;
+        int port2;
+        int slice1 = td_ev->global_slice_shadow;
+        int slice2 = (td_ev->global_slice_shadow + 1) % params.n;
+        int cost1 = ugalCost(td_ev->dest.group, slice1, 1, port1);
+        int cost2 = ugalCost(td_ev->dest.group, slice2, 1, port2);
+        if (cost2 < cost1) {
+            direct_slice = slice2;
+            direct_route_port = port2;
+            direct_cost = cost2;
+        } else {
+            direct_slice = slice1;
+            direct_route_port = port1;
+            direct_cost = cost1;
+        }
+    } else {
+        // The source sent the packet here for one of the minimal
+        // slices with its global link on this router
+        direct_slice = -1;
+        direct_route_port = 0;
+        direct_cost = 0;
+        for (int i = 0; i < 2; i++) {
+            int slice = (td_ev->global_slice_shadow + i) % params.n;
+            if (pair_for_group(td_ev->dest.group, slice).router != router_id)
+                continue;
+            int slice_port;
+            int cost = ugalCost(td_ev->dest.group, slice, 1, slice_port);
+            if (direct_slice == -1 || cost < direct_cost) {
+                direct_slice = slice;
+                direct_route_port = slice_port;
+                direct_cost = cost;
+            }
+        }
+        if (direct_slice == -1)
+            return;
+    }
+
+    int port1;
+    int port2;
+    int slice1 = td_ev->global_slice_shadow;
+    int slice2 = (td_ev->global_slice_shadow + 1) % params.n;
+    int cost1 = ugalCost(td_ev->dest.mid_group_shadow, slice1, 3, port1);
+    int cost2 = ugalCost(td_ev->dest.mid_group_shadow, slice2, 3, port2);
+    int valiant_slice = cost2 < cost1 ? slice2 : slice1;
+    int valiant_route_port = cost2 < cost1 ? port2 : port1;
+    int valiant_cost = cost2 < cost1 ? cost2 : cost1;
+
+    if (direct_cost > (int)((double)valiant_cost * adaptive_threshold)) { // Use valiant route
+        td_ev->dest.mid_group = td_ev->dest.mid_group_shadow;
+        td_ev->setNextPort(valiant_route_port);
+        td_ev->global_slice = valiant_slice;
+        if (at_source)
+            td_ev->progressive = false;
+        else
+            td_ev->setVC(vc + 1);
+    } else { // Use direct route
+        td_ev->dest.mid_group = td_ev->dest.group;
+        td_ev->setNextPort(direct_route_port);
+        td_ev->global_slice = direct_slice;
+        if (at_source)
+            td_ev->progressive = algorithm == PAR;
+        else
+            td_ev->setVC(vc);
+    }
+}
+
+// Total flits queued on all VCs of an output port
+int topo_dragonfly::portQueueLength(int port) const {
+    int total = 0;
+    for (int vc = 0; vc < num_vcs; vc++)
+        total += output_queue_lengths[port * num_vcs + vc];
+    return total;
+}
+
+// Returns the UGAL cost of going to group over global_slice from this
+// router, with hops_after hops left once the packet is over the global
+// link, and sets port to the port to take.
+int topo_dragonfly::ugalCost(uint32_t group, uint32_t global_slice, int hops_after, int &port) {
+    const RouterPortPair &pair = pair_for_group(group, global_slice);
+    int queued;
+    int hops = hops_after + 1;
+    if (pair.router == router_id) {
+        port = pair.port;
+        queued = portQueueLength(port);
+    } else {
+        port = port_for_router(pair.router);
+        queued = portQueueLength(port) +
+                 global_occupancy[pair.router * params.h + (pair.port - (params.p + params.a - 1))];
+        hops++;
+    }
+    return queued * hops;
+}
+
+void topo_dragonfly::handleGossip(Event * /*ev*/) {
+    uint32_t global_start = params.p + params.a - 1;
+    bool changed = false;
+    bool busy = false;
+    for (uint32_t i = 0; i < params.h; i++) {
+        int32_t queued = portQueueLength(global_start + i);
+        if (queued != last_gossip[i])
+            changed = true;
+        if (queued != 0)
+            busy = true;
+        last_gossip[i] = queued;
+    }
+
+    if (changed) {
+        for (uint32_t r = 0; r < params.a; r++) {
+            if (r == router_id)
+                continue;
+            router->sendTopologyEvent(port_for_router(r),
+                                      new topo_dragonfly_gossip_event(gossip_flits, router_id, last_gossip));
+        }
+    }
+
+    // Once the links are idle and the group has been told, wait for
+    // route() to start things up again
+    if (busy)
+        gossip_timer->send(1, nullptr);
+    else
+        gossip_scheduled = false;
+}
+
+void topo_dragonfly::recvTopologyEvent(int /*port*/, TopologyEvent *ev) {
+    auto *gossip = static_cast<topo_dragonfly_gossip_event *>(ev);
+    std::copy(gossip->occupancy.begin(), gossip->occupancy.end(),
+              global_occupancy.begin() + gossip->router * params.h);
+    delete ev;
+}
+
 internal_router_event *topo_dragonfly::process_input(RtrEvent *ev) {
     dgnflyAddr dstAddr = {0, 0, 0, 0};
     idToLocation(ev->getDest(), &dstAddr);
@@ -348,6 +598,8 @@ internal_router_event *topo_dragonfly::process_input(RtrEvent *ev) {
         break;
     case VALIANT:
     case ADAPTIVE_LOCAL:
+    case UGAL_GLOBAL:
+    case PAR:
         if (dstAddr.group == group_id) {
             // staying within group, set mid_group to be an intermediate router within group
             do {
@@ -370,7 +622,7 @@ internal_router_event *topo_dragonfly::process_input(RtrEvent *ev) {
     auto *td_ev = new topo_dragonfly_event(dstAddr);
     td_ev->src_group = group_id;
     td_ev->setEncapsulatedEvent(ev);
-    td_ev->setVC(td_ev->getVN() * 3);
+    td_ev->setVC(td_ev->getVN() * (algorithm == PAR ? 4 : 3));
     td_ev->global_slice = ev->getTrustedSrc() % params.n;
     td_ev->global_slice_shadow = ev->getTrustedSrc() % params.n;
 
@@ -382,6 +634,35 @@ internal_router_event *topo_dragonfly::process_input(RtrEvent *ev) {
     return td_ev;
 }
 
+// Minimal routes take at most one local hop in each group and the
+// global link for the packet's slice in between.  The global link
+// lands on the router in the destination group that holds the link
+// back to this group for the same slice.  The VC goes up by one when
+// the packet arrives over the global link and is unchanged otherwise.
+bool topo_dragonfly::computeSourceRoute(int /*port*/, int vc, internal_router_event *ev) {
+    if (algorithm != MINIMAL)
+        return false;
+
+    auto *td_ev = static_cast<topo_dragonfly_event *>(ev);
+    SourceRoute route;
+    uint32_t at_router = router_id;
+    if (td_ev->dest.group != group_id) {
+        const RouterPortPair &pair = pair_for_group(td_ev->dest.group, td_ev->global_slice);
+        if (pair.router != router_id)
+            route.addHop(port_for_router(pair.router), vc);
+        route.addHop(pair.port, vc);
+
+        vc++;
+        at_router = pair_for_group(td_ev->dest.group, group_id, td_ev->global_slice).router;
+    }
+    if (td_ev->dest.router != at_router)
+        route.addHop(port_for_router(at_router, td_ev->dest.router), vc);
+    route.addHop(td_ev->dest.host, vc);
+
+    ev->setSourceRoute(route);
+    return true;
+}
+
 void topo_dragonfly::routeInitData(int port, internal_router_event *ev, std::vector<int> &outPorts) {
     bool broadcast_to_groups = false;
     auto *td_ev = static_cast<topo_dragonfly_event *>(ev);
@@ -482,6 +763,11 @@ void topo_dragonfly::setOutputBufferCreditArray(int const *array, int vcs) {
     num_vcs = vcs;
 }
 
+void topo_dragonfly::setOutputQueueLengthsArray(int const *array, int vcs) {
+    output_queue_lengths = array;
+    num_vcs = vcs;
+}
+
 void topo_dragonfly::idToLocation(int id, dgnflyAddr *location) {
     if (id == INIT_BROADCAST_ADDR) {
         location->group = (uint32_t)INIT_BROADCAST_ADDR;
@@ -509,36 +795,43 @@ uint32_t topo_dragonfly::router_to_group(uint32_t group) {
 }
 
 /* returns local router port if group can't be reached from this router */
-uint32_t topo_dragonfly::port_for_group(uint32_t group, uint32_t slice, int /*id*/) {
+uint32_t topo_dragonfly::compute_port_for_group(uint32_t group, uint32_t slice, int /*id*/) {
+    const RouterPortPair &pair = pair_for_group(group, slice);
+
+    if (pair.router == router_id) {
+        return pair.port;
+    } else {
+        return port_for_router(pair.router);
+    }
+}
+
+// Router in from_group that holds the global link to group for slice,
+// and the port on it
+const RouterPortPair &topo_dragonfly::pair_for_group(uint32_t from_group, uint32_t group, uint32_t slice) {
     // Look up global port to use
     switch (global_route_mode) {
     case ABSOLUTE:
-        if (group >= group_id)
+        if (group >= from_group)
             group--;
         break;
     case RELATIVE:
-        if (group > group_id) {
-            group = group - group_id - 1;
+        if (group > from_group) {
+            group = group - from_group - 1;
         } else {
-            group = params.g - group_id + group - 1;
+            group = params.g - from_group + group - 1;
         }
         break;
     default:
         break;
     }
 
-    const RouterPortPair &pair = group_to_global_port.getRouterPortPair(group, slice);
-
-    if (pair.router == router_id) {
-        return pair.port;
-    } else {
-        return port_for_router(pair.router);
-    }
+    return group_to_global_port.getRouterPortPair(group, slice);
 }
 
-uint32_t topo_dragonfly::port_for_router(uint32_t router) {
+// Port on from_router that leads to router in the same group
+uint32_t topo_dragonfly::port_for_router(uint32_t from_router, uint32_t router) {
     uint32_t tgt = params.p + router;
-    if (router > router_id)
+    if (router > from_router)
         tgt--;
     return tgt;
 }
@@ -23,6 +23,8 @@
 #include <sst/core/params.h>
 #include <sst/core/rng/sstrng.h>
 
+#include <vector>
+
 #include "../router.h"
 
 namespace SST {
@@ -72,21 +74,44 @@ class topo_dragonfly : public Topology {
         {"dragonfly:intergroup_per_router", "Number of links per router connected to other groups."},
         {"dragonfly:intergroup_links", "Number of links between each pair of groups."},
         {"dragonfly:num_groups", "Number of groups in network."},
-        {"dragonfly:algorithm", "Routing algorithm to use [minmal (default) | valiant].", "minimal"},
+        {"dragonfly:algorithm",
+         "Routing algorithm to use [minmal (default) | valiant | adaptive-local | ugal-g | par].  ugal-g and par "
+         "use the global link occupancy gossiped by the other routers in the group.  par also re-evaluates minimally "
+         "routed packets at the router in the source group that holds the global link.",
+         "minimal"},
         {"dragonfly:adaptive_threshold", "Threshold to use when make adaptive routing decisions.", "2.0"},
+        {"dragonfly:gossip_period", "How often ugal-g and par routers send their global link occupancy to their group.",
+         "100ns"},
+        {"dragonfly:gossip_flits", "Size of a global link occupancy update in flits.  0 means it takes no bandwidth.",
+         "1"},
         {"dragonfly:global_link_map", "Array specifying connectivity of global links in each dragonfly group."},
         {"dragonfly:global_route_mode", "Mode for intepreting global link map [absolute (default) | relative].",
          "absolute"},
+        {"dragonfly:routing_table",
+         "How global ports are looked up when routing [computed (default) | precomputed].  precomputed builds a "
+         "per-router table of global ports at setup.",
+         "computed"},
 
         {"hosts_per_router", "Number of hosts connected to each router."},
         {"routers_per_group", "Number of links used to connect to routers in same group."},
         {"intergroup_per_router", "Number of links per router connected to other groups."},
         {"intergroup_links", "Number of links between each pair of groups."},
         {"num_groups", "Number of groups in network."},
-        {"algorithm", "Routing algorithm to use [minmal (default) | valiant].", "minimal"},
+        {"algorithm",
+         "Routing algorithm to use [minmal (default) | valiant | adaptive-local | ugal-g | par].  ugal-g and par "
+         "use the global link occupancy gossiped by the other routers in the group.  par also re-evaluates minimally "
+         "routed packets at the router in the source group that holds the global link.",
+         "minimal"},
         {"adaptive_threshold", "Threshold to use when make adaptive routing decisions.", "2.0"},
+        {"gossip_period", "How often ugal-g and par routers send their global link occupancy to their group.",
+         "100ns"},
+        {"gossip_flits", "Size of a global link occupancy update in flits.  0 means it takes no bandwidth.", "1"},
         {"global_link_map", "Array specifying connectivity of global links in each dragonfly group."},
-        {"global_route_mode", "Mode for intepreting global link map [absolute (default) | relative].", "absolute"}, )
+        {"global_route_mode", "Mode for intepreting global link map [absolute (default) | relative].", "absolute"},
+        {"routing_table",
+         "How global ports are looked up when routing [computed (default) | precomputed].  precomputed builds a "
+         "per-router table of global ports at setup.",
+         "computed"}, )
 
     /* Assumed connectivity of each router:
      * ports [0, p-1]:      Hosts
@@ -103,7 +128,7 @@ class topo_dragonfly : public Topology {
         uint32_t n; /* # of links between groups in a pair */
     };
 
-    enum RouteAlgo { MINIMAL, VALIANT, ADAPTIVE_LOCAL };
+    enum RouteAlgo { MINIMAL, VALIANT, ADAPTIVE_LOCAL, UGAL_GLOBAL, PAR };
 
     RouteToGroup group_to_global_port;
 
@@ -116,11 +141,30 @@ class topo_dragonfly : public Topology {
     RNG::SSTRandom *rng;
 
     int const *output_credits;
+    int const *output_queue_lengths;
     int num_vcs;
 
+    // Congestion gossip for ugal-g and par.  While its global links
+    // are busy, a router sends their occupancy to the other routers in
+    // its group every gossip period, skipping periods where nothing
+    // changed.  global_occupancy holds the last values heard, indexed
+    // by router * h + global port index.
+    Link *gossip_timer;
+    bool gossip_scheduled;
+    int gossip_flits;
+    std::vector<int32_t> last_gossip;
+    std::vector<int32_t> global_occupancy;
+
     enum global_route_mode_t { ABSOLUTE, RELATIVE };
     global_route_mode_t global_route_mode;
 
+    // Next port for each (group, slice) pair, indexed by group *
+    // params.n + slice.  Only filled in when routing_table is set to
+    // precomputed, and not until setup() since the global link map
+    // isn't available from the shared region before then.
+    bool use_routing_table;
+    std::vector<uint16_t> group_port_table;
+
   public:
     struct dgnflyAddr {
         uint32_t group;
@@ -133,9 +177,12 @@ class topo_dragonfly : public Topology {
     topo_dragonfly(ComponentId_t cid, Params &p, int num_ports, int rtr_id);
     ~topo_dragonfly() override;
 
+    void setup() override;
+
     void route(int port, int vc, internal_router_event *ev) override;
     void reroute(int port, int vc, internal_router_event *ev) override;
     internal_router_event *process_input(RtrEvent *ev) override;
+    bool computeSourceRoute(int port, int vc, internal_router_event *ev) override;
 
     PortState getPortState(int port) const override;
     std::string getPortLogicalGroup(int port) const override;
@@ -143,16 +190,36 @@ class topo_dragonfly : public Topology {
     void routeInitData(int port, internal_router_event *ev, std::vector<int> &outPorts) override;
     internal_router_event *process_InitData_input(RtrEvent *ev) override;
 
-    int computeNumVCs(int vns) override { return vns * 3; }
+    // par needs an extra VC for packets it diverts in the source group
+    int computeNumVCs(int vns) override { return vns * (algorithm == PAR ? 4 : 3); }
     int getEndpointID(int port) override;
 
     void setOutputBufferCreditArray(int const *array, int vcs) override;
+    void setOutputQueueLengthsArray(int const *array, int vcs) override;
+
+    void recvTopologyEvent(int port, TopologyEvent *ev) override;
 
   private:
     void idToLocation(int id, dgnflyAddr *location);
     uint32_t router_to_group(uint32_t group);
-    uint32_t port_for_router(uint32_t router);
-    uint32_t port_for_group(uint32_t group, uint32_t global_slice, int id = -1);
+    uint32_t port_for_router(uint32_t router) { return port_for_router(router_id, router); }
+    uint32_t port_for_router(uint32_t from_router, uint32_t router);
+    inline uint32_t port_for_group(uint32_t group, uint32_t global_slice, int id = -1) {
+        if (!group_port_table.empty())
+            return group_port_table[group * params.n + global_slice];
+        return compute_port_for_group(group, global_slice, id);
+    }
+    uint32_t compute_port_for_group(uint32_t group, uint32_t global_slice, int id = -1);
+    const RouterPortPair &pair_for_group(uint32_t group, uint32_t global_slice) {
+        return pair_for_group(group_id, group, global_slice);
+    }
+    const RouterPortPair &pair_for_group(uint32_t from_group, uint32_t group, uint32_t global_slice);
+    void buildRoutingTable();
+
+    void rerouteGlobal(int port, int vc, topo_dragonfly_event *ev);
+    int portQueueLength(int port) const;
+    int ugalCost(uint32_t group, uint32_t global_slice, int hops_after, int &port);
+    void handleGossip(Event *ev);
 };
 
 class topo_dragonfly_event : public internal_router_event {
@@ -162,11 +229,16 @@ class topo_dragonfly_event : public internal_router_event {
     topo_dragonfly::dgnflyAddr dest;
     uint16_t global_slice;
     uint16_t global_slice_shadow;
+    // Set for par when the source router picks the minimal route, so
+    // the next router in the source group can still divert the packet
+    bool progressive;
 
     topo_dragonfly_event() = default;
-    topo_dragonfly_event(const topo_dragonfly::dgnflyAddr &dest) : dest(dest), global_slice(0) {}
+    topo_dragonfly_event(const topo_dragonfly::dgnflyAddr &dest) : dest(dest), global_slice(0), progressive(false) {}
     ~topo_dragonfly_event() override = default;
 
+    MERLIN_POOLED_EVENT(topo_dragonfly_event)
+
     internal_router_event *clone() override { return new topo_dragonfly_event(*this); }
 
     void serialize_order(SST::Core::Serialization::serializer &ser) override {
@@ -179,12 +251,35 @@ class topo_dragonfly_event : public internal_router_event {
         ser &dest.host;
         ser &global_slice;
         ser &global_slice_shadow;
+        ser &progressive;
     }
 
   private:
     ImplementSerializable(SST::Merlin::topo_dragonfly_event)
 };
 
+// Occupancy of the global links of one router, sent to the other
+// routers in its group
+class topo_dragonfly_gossip_event : public TopologyEvent {
+
+  public:
+    uint32_t router;
+    std::vector<int32_t> occupancy;
+
+    topo_dragonfly_gossip_event() = default;
+    topo_dragonfly_gossip_event(int size_in_flits, uint32_t router, const std::vector<int32_t> &occupancy)
+        : TopologyEvent(size_in_flits), router(router), occupancy(occupancy) {}
+
+    void serialize_order(SST::Core::Serialization::serializer &ser) override {
+        TopologyEvent::serialize_order(ser);
+        ser &router;
+        ser &occupancy;
+    }
+
+  private:
+    ImplementSerializable(SST::Merlin::topo_dragonfly_gossip_event)
+};
+
 } // namespace Merlin
 } // namespace SST
 
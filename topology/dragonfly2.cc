@@ -67,6 +67,15 @@ topo_dragonfly2::topo_dragonfly2(ComponentId_t cid, Params &p, int num_ports, in
 
     std::string route_algo = p.find<std::string>("algorithm", "minimal");
 
+    std::string routing_table = p.find<std::string>("routing_table", "computed");
+    if (routing_table == "computed")
+        use_routing_table = false;
+    else if (routing_table == "precomputed")
+        use_routing_table = true;
+    else {
+        output.fatal(CALL_INFO, -1, "Invalid routing_table specified: %s.\n", routing_table.c_str());
+    }
+
     adaptive_threshold = p.find<double>("adaptive_threshold", 2.0);
 
     // Get the global link map
@@ -143,6 +152,24 @@ topo_dragonfly2::topo_dragonfly2(ComponentId_t cid, Params &p, int num_ports, in
 
 topo_dragonfly2::~topo_dragonfly2() = default;
 
+void topo_dragonfly2::setup() {
+    if (use_routing_table)
+        buildRoutingTable();
+}
+
+void topo_dragonfly2::buildRoutingTable() {
+    // Route to our own group is never looked up, so leave it as 0
+    std::vector<uint16_t> table(params.g * params.n, 0);
+    for (uint32_t group = 0; group < params.g; group++) {
+        if (group == group_id)
+            continue;
+        for (uint32_t slice = 0; slice < params.n; slice++) {
+            table[group * params.n + slice] = compute_port_for_group(group, slice);
+        }
+    }
+    group_port_table.swap(table);
+}
+
 void topo_dragonfly2::route(int port, int vc, internal_router_event *ev) {
     auto *td_ev = static_cast<topo_dragonfly2_event *>(ev);
 
@@ -515,7 +542,7 @@ uint32_t topo_dragonfly2::router_to_group(uint32_t group) {
 }
 
 /* returns local router port if group can't be reached from this router */
-uint32_t topo_dragonfly2::port_for_group(uint32_t group, uint32_t slice, int /*id*/) {
+uint32_t topo_dragonfly2::compute_port_for_group(uint32_t group, uint32_t slice, int /*id*/) {
     // Look up global port to use
     switch (global_route_mode) {
     case ABSOLUTE:
@@ -77,6 +77,10 @@ class topo_dragonfly2 : public Topology {
         {"dragonfly:global_link_map", "Array specifying connectivity of global links in each dragonfly group."},
         {"dragonfly:global_route_mode", "Mode for intepreting global link map [absolute (default) | relative].",
          "absolute"},
+        {"dragonfly:routing_table",
+         "How global ports are looked up when routing [computed (default) | precomputed].  precomputed builds a "
+         "per-router table of global ports at setup.",
+         "computed"},
 
         {"hosts_per_router", "Number of hosts connected to each router."},
         {"routers_per_group", "Number of links used to connect to routers in same group."},
@@ -86,7 +90,11 @@ class topo_dragonfly2 : public Topology {
         {"algorithm", "Routing algorithm to use [minmal (default) | valiant].", "minimal"},
         {"adaptive_threshold", "Threshold to use when make adaptive routing decisions.", "2.0"},
         {"global_link_map", "Array specifying connectivity of global links in each dragonfly group."},
-        {"global_route_mode", "Mode for intepreting global link map [absolute (default) | relative].", "absolute"}, )
+        {"global_route_mode", "Mode for intepreting global link map [absolute (default) | relative].", "absolute"},
+        {"routing_table",
+         "How global ports are looked up when routing [computed (default) | precomputed].  precomputed builds a "
+         "per-router table of global ports at setup.",
+         "computed"}, )
 
     /* Assumed connectivity of each router:
      * ports [0, p-1]:      Hosts
@@ -121,6 +129,13 @@ class topo_dragonfly2 : public Topology {
     enum global_route_mode_t { ABSOLUTE, RELATIVE };
     global_route_mode_t global_route_mode;
 
+    // Next port for each (group, slice) pair, indexed by group *
+    // params.n + slice.  Only filled in when routing_table is set to
+    // precomputed, and not until setup() since the global link map
+    // isn't available from the shared region before then.
+    bool use_routing_table;
+    std::vector<uint16_t> group_port_table;
+
   public:
     struct dgnfly2Addr {
         uint32_t group;
@@ -133,6 +148,8 @@ class topo_dragonfly2 : public Topology {
     topo_dragonfly2(ComponentId_t cid, Params &p, int num_ports, int rtr_id);
     ~topo_dragonfly2() override;
 
+    void setup() override;
+
     void route(int port, int vc, internal_router_event *ev) override;
     void reroute(int port, int vc, internal_router_event *ev) override;
     internal_router_event *process_input(RtrEvent *ev) override;
@@ -152,7 +169,13 @@ class topo_dragonfly2 : public Topology {
     void idToLocation(int id, dgnfly2Addr *location);
     uint32_t router_to_group(uint32_t group);
     uint32_t port_for_router(uint32_t router);
-    uint32_t port_for_group(uint32_t group, uint32_t global_slice, int id = -1);
+    inline uint32_t port_for_group(uint32_t group, uint32_t global_slice, int id = -1) {
+        if (!group_port_table.empty())
+            return group_port_table[group * params.n + global_slice];
+        return compute_port_for_group(group, global_slice, id);
+    }
+    uint32_t compute_port_for_group(uint32_t group, uint32_t global_slice, int id = -1);
+    void buildRoutingTable();
 };
 
 class topo_dragonfly2_event : public internal_router_event {
@@ -167,6 +190,8 @@ class topo_dragonfly2_event : public internal_router_event {
     topo_dragonfly2_event(const topo_dragonfly2::dgnfly2Addr &dest) : dest(dest), global_slice(0) {}
     ~topo_dragonfly2_event() override = default;
 
+    MERLIN_POOLED_EVENT(topo_dragonfly2_event)
+
     internal_router_event *clone() override { return new topo_dragonfly2_event(*this); }
 
     void serialize_order(SST::Core::Serialization::serializer &ser) override {
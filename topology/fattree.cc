@@ -74,6 +74,8 @@ topo_fattree::topo_fattree(ComponentId_t cid, Params &params, int num_ports, int
     // cout << "shape: " << shape << endl;
     // cout << "levels: " << levels << endl;
     parseShape(shape, downs, ups);
+    level_downs.assign(downs, downs + levels);
+    level_ups.assign(ups, ups + levels);
     // for ( int i = 0; i < levels; i++ ) {
     //     cout << "Level " << i << ": down = " << downs[i] << ", up = " << ups[i] << endl;
     // }
@@ -205,6 +207,44 @@ internal_router_event *topo_fattree::process_input(RtrEvent *ev) {
     return ire;
 }
 
+// Deterministic routing only depends on the range of hosts below a
+// router, which is the same for every router in a level group.  The
+// group above is the one whose range contains this one, so the path
+// can be walked from the ranges alone.  The VC never changes.
+bool topo_fattree::computeSourceRoute(int /*port*/, int vc, internal_router_event *ev) {
+    if (allow_adaptive)
+        return false;
+
+    int dest = ev->getDest();
+    int level = rtr_level;
+    int low = low_host;
+    int reach = high_host - low_host + 1;
+    SourceRoute route;
+    while (true) {
+        int factor = reach / level_downs[level];
+        if (dest >= low && dest < low + reach) {
+            // Down routes
+            int out_port = (dest - low) / factor;
+            if (!route.addHop(out_port, vc))
+                return false;
+            if (level == 0)
+                break;
+            low += out_port * factor;
+            reach = factor;
+            level--;
+        } else {
+            // Up routes
+            if (!route.addHop(level_downs[level] + ((dest / factor) % level_ups[level]), vc))
+                return false;
+            level++;
+            reach *= level_downs[level];
+            low = low / reach * reach;
+        }
+    }
+    ev->setSourceRoute(route);
+    return true;
+}
+
 void topo_fattree::routeInitData(int inPort, internal_router_event *ev, std::vector<int> &outPorts) {
 
     if (ev->getDest() == INIT_BROADCAST_ADDR) {
@@ -22,6 +22,8 @@
 #include <sst/core/link.h>
 #include <sst/core/params.h>
 
+#include <vector>
+
 #include "../router.h"
 
 namespace SST {
@@ -60,6 +62,11 @@ class topo_fattree : public Topology {
     int num_ports;
     int num_vcs;
 
+    // Down and up ports of the routers at each level, so the path can
+    // be followed past this router
+    std::vector<int> level_downs;
+    std::vector<int> level_ups;
+
     int const *outputCredits;
     int *thresholds;
     bool allow_adaptive;
@@ -74,6 +81,7 @@ class topo_fattree : public Topology {
     void route(int port, int vc, internal_router_event *ev) override;
     void reroute(int port, int vc, internal_router_event *ev) override;
     internal_router_event *process_input(RtrEvent *ev) override;
+    bool computeSourceRoute(int port, int vc, internal_router_event *ev) override;
 
     void routeInitData(int port, internal_router_event *ev, std::vector<int> &outPorts) override;
     internal_router_event *process_InitData_input(RtrEvent *ev) override;
@@ -0,0 +1,435 @@
+// Copyright 2009-2020 NTESS. Under the terms
+// of Contract DE-NA0003525 with NTESS, the U.S.
+// Government retains certain rights in this software.
+//
+// Copyright (c) 2009-2020, NTESS
+// All rights reserved.
+//
+// Portions are copyright of other developers:
+// See the file CONTRIBUTORS.TXT in the top level directory
+// the distribution for more information.
+//
+// This file is part of the SST software package. For license
+// information, see the LICENSE file in the top level directory of the
+// distribution.
+//
+
+#include <sst/core/sst_config.h>
+#include <sst/core/sharedRegion.h>
+
+#include "graph.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <tuple>
+
+using namespace SST::Merlin;
+
+namespace {
+
+// Mixes the flow and router id so routers don't all make the same
+// choice for a flow (splitmix64 finalizer)
+inline uint64_t flowHash(uint32_t src, uint32_t dest, uint32_t rtr) {
+    uint64_t h = ((uint64_t)src << 32 | dest) ^ ((uint64_t)rtr * 0x9e3779b97f4a7c15ULL);
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+    return h ^ (h >> 31);
+}
+
+} // namespace
+
+std::map<std::string, std::shared_ptr<const topo_graph::graph_t>> topo_graph::graph_cache;
+std::mutex topo_graph::graph_cache_lock;
+
+topo_graph::topo_graph(ComponentId_t cid, Params &params, int num_ports, int rtr_id)
+    : Topology(cid), router_id(rtr_id), num_ports(num_ports), region(nullptr), masks(nullptr), endpoints(nullptr),
+      dist(nullptr), output_queue_lengths(nullptr), num_vcs(0) {
+
+    std::string file = params.find<std::string>("file", "");
+    if (file == "") {
+        output.fatal(CALL_INFO, -1, "graph requires file to be specified\n");
+    }
+
+    std::string route_algo = params.find<std::string>("algorithm", "ecmp");
+    if (route_algo == "ecmp")
+        algorithm = ECMP;
+    else if (route_algo == "adaptive")
+        algorithm = ADAPTIVE;
+    else {
+        output.fatal(CALL_INFO, -1, "Invalid algorithm specified for graph: %s.\n", route_algo.c_str());
+    }
+
+    graph = getGraph(file);
+    const std::vector<int> &row = graph->row;
+    const std::vector<int> &nbr = graph->nbr;
+    const std::vector<int> &port = graph->port;
+    const std::vector<int> &remote_port = graph->remote_port;
+    const std::vector<uint32_t> &endpoint_map = graph->endpoint_map;
+    const std::vector<int> &root_distance = graph->root_distance;
+    num_routers = graph->num_routers;
+    num_endpoints = graph->num_endpoints;
+
+    if (router_id >= num_routers) {
+        output.fatal(CALL_INFO, -1, "graph: router id %d is not in %s, which has %d routers\n", router_id,
+                     file.c_str(), num_routers);
+    }
+
+    // Ports of this router
+    port_state.assign(num_ports, UNCONNECTED);
+    port_endpoint.assign(num_ports, -1);
+    for (int j = row[router_id]; j < row[router_id + 1]; j++) {
+        if (port[j] >= num_ports) {
+            output.fatal(CALL_INFO, -1, "graph: link on port %d of router %d, which only has %d ports\n", port[j],
+                         router_id, num_ports);
+        }
+        link_port.push_back(port[j]);
+        port_state[port[j]] = R2R;
+    }
+    for (int ep = 0; ep < num_endpoints; ep++) {
+        if ((int)endpoint_map[2 * ep] != router_id)
+            continue;
+        int p = endpoint_map[2 * ep + 1];
+        if (p >= num_ports) {
+            output.fatal(CALL_INFO, -1, "graph: endpoint %d is on port %d of router %d, which only has %d ports\n",
+                         ep, p, router_id, num_ports);
+        }
+        if (port_state[p] == R2R) {
+            output.fatal(CALL_INFO, -1, "graph: port %d of router %d has both a link and an endpoint\n", p,
+                         router_id);
+        }
+        port_endpoint[p] = ep;
+        port_state[p] = R2N;
+    }
+
+    // Distances to this router
+    std::vector<int> distance;
+    bfs(router_id, *graph, distance);
+    int eccentricity = 0;
+    for (int s = 0; s < num_routers; s++) {
+        if (distance[s] < 0) {
+            output.fatal(CALL_INFO, -1, "graph: router %d can't reach router %d in %s\n", s, router_id, file.c_str());
+        }
+        eccentricity = std::max(eccentricity, distance[s]);
+    }
+    if (eccentricity > 255) {
+        output.fatal(CALL_INFO, -1, "graph: paths longer than 255 hops are not supported\n");
+    }
+
+    // Everyone has to agree on the number of VCs, so the default is
+    // based on router 0.  Each router checks the distances to itself,
+    // which between them covers the diameter.
+    int root_eccentricity = *std::max_element(root_distance.begin(), root_distance.end());
+
+    vcs_per_vn = params.find<int>("vcs_per_vn", std::max(1, 2 * root_eccentricity));
+    if (vcs_per_vn < eccentricity) {
+        output.fatal(CALL_INFO, -1,
+                     "graph: vcs_per_vn is %d, but some packets take %d hops to reach router %d.  vcs_per_vn needs "
+                     "to be at least the diameter of the graph.\n",
+                     vcs_per_vn, eccentricity, router_id);
+    }
+
+    // Init data is broadcast along the BFS tree from router 0
+    for (int s = 1; s < num_routers; s++) {
+        int j = graph->tree_link[s];
+        if (s == router_id)
+            tree_ports.push_back(port[j]);
+        else if (nbr[j] == router_id)
+            tree_ports.push_back(remote_port[j]);
+    }
+
+    // Lay out the shared region
+    std::vector<size_t> offsets(num_routers + 1, 0);
+    for (int s = 0; s < num_routers; s++) {
+        offsets[s + 1] = offsets[s] + (row[s + 1] - row[s] + 63) / 64;
+    }
+    mask_words_total = offsets[num_routers];
+    mask_offset = offsets[router_id];
+    mask_words = offsets[router_id + 1] - offsets[router_id];
+
+    endpoint_start = mask_words_total * num_routers * sizeof(uint64_t);
+    dist_start = endpoint_start + num_endpoints * 2 * sizeof(uint32_t);
+    size_t region_size = dist_start + (size_t)num_routers * num_routers;
+
+    // Fill in the part of the table for packets headed to this router
+    std::vector<uint64_t> dest_masks(mask_words_total, 0);
+    std::vector<uint8_t> dest_dist(num_routers);
+    for (int s = 0; s < num_routers; s++) {
+        dest_dist[s] = distance[s];
+        for (int j = row[s]; j < row[s + 1]; j++) {
+            if (distance[nbr[j]] == distance[s] - 1) {
+                int bit = j - row[s];
+                dest_masks[offsets[s] + bit / 64] |= (uint64_t)1 << (bit % 64);
+            }
+        }
+    }
+
+    region = Simulation::getSharedRegionManager()->getGlobalSharedRegion("merlin.graph:" + file, region_size,
+                                                                         new SharedRegionMerger());
+    region->modifyRegion(router_id * mask_words_total * sizeof(uint64_t), mask_words_total * sizeof(uint64_t),
+                         dest_masks.data());
+    region->modifyRegion(dist_start + (size_t)router_id * num_routers, num_routers, dest_dist.data());
+    for (int p = 0; p < num_ports; p++) {
+        if (port_endpoint[p] == -1)
+            continue;
+        region->modifyRegion(endpoint_start + port_endpoint[p] * 2 * sizeof(uint32_t), 2 * sizeof(uint32_t),
+                             &endpoint_map[2 * port_endpoint[p]]);
+    }
+    region->publish();
+
+    candidates.reserve(link_port.size());
+
+    output.verbose(CALL_INFO, 1, 1, "graph: router %d has %d links, %d VCs per VN\n", router_id,
+                   (int)link_port.size(), vcs_per_vn);
+}
+
+topo_graph::~topo_graph() = default;
+
+void topo_graph::setup() {
+    const uint8_t *base = region->getPtr<const uint8_t *>();
+    masks = reinterpret_cast<const uint64_t *>(base);
+    endpoints = reinterpret_cast<const uint32_t *>(base + endpoint_start);
+    dist = base + dist_start;
+}
+
+// Returns the parsed graph for file, reading it on first use
+std::shared_ptr<const topo_graph::graph_t> topo_graph::getGraph(const std::string &file) {
+    std::lock_guard<std::mutex> lock(graph_cache_lock);
+    std::shared_ptr<const graph_t> &entry = graph_cache[file];
+    if (!entry) {
+        auto graph = std::make_shared<graph_t>();
+        loadGraph(file, *graph);
+        bfs(0, *graph, graph->root_distance);
+
+        // The tree link of each router is its first link toward
+        // router 0
+        graph->tree_link.assign(graph->num_routers, -1);
+        for (int s = 1; s < graph->num_routers; s++) {
+            for (int j = graph->row[s]; j < graph->row[s + 1]; j++) {
+                if (graph->root_distance[graph->nbr[j]] == graph->root_distance[s] - 1) {
+                    graph->tree_link[s] = j;
+                    break;
+                }
+            }
+        }
+        entry = graph;
+    }
+    return entry;
+}
+
+void topo_graph::loadGraph(const std::string &file, graph_t &graph) {
+    std::ifstream in(file);
+    if (!in.is_open()) {
+        output.fatal(CALL_INFO, -1, "graph: unable to open %s\n", file.c_str());
+    }
+
+    int routers = -1;
+    // (router, port, neighbor, neighbor port) for both ends of each link
+    std::vector<std::tuple<int, int, int, int>> links;
+    std::vector<std::pair<int, int>> eps;
+
+    std::string line;
+    int line_num = 0;
+    while (std::getline(in, line)) {
+        line_num++;
+        size_t comment = line.find('#');
+        if (comment != std::string::npos)
+            line.erase(comment);
+
+        std::istringstream ss(line);
+        std::string keyword;
+        if (!(ss >> keyword))
+            continue;
+
+        if (keyword == "routers") {
+            if (!(ss >> routers) || routers <= 0) {
+                output.fatal(CALL_INFO, -1, "graph: bad router count on line %d of %s\n", line_num, file.c_str());
+            }
+        } else if (keyword == "link") {
+            int ra, pa, rb, pb;
+            if (!(ss >> ra >> pa >> rb >> pb) || ra < 0 || pa < 0 || rb < 0 || pb < 0 || ra == rb) {
+                output.fatal(CALL_INFO, -1, "graph: bad link on line %d of %s\n", line_num, file.c_str());
+            }
+            links.emplace_back(ra, pa, rb, pb);
+            links.emplace_back(rb, pb, ra, pa);
+        } else if (keyword == "endpoint") {
+            int id, rtr, p;
+            if (!(ss >> id >> rtr >> p) || id < 0 || rtr < 0 || p < 0) {
+                output.fatal(CALL_INFO, -1, "graph: bad endpoint on line %d of %s\n", line_num, file.c_str());
+            }
+            if (id >= (int)eps.size())
+                eps.resize(id + 1, std::make_pair(-1, -1));
+            if (eps[id].first != -1) {
+                output.fatal(CALL_INFO, -1, "graph: endpoint %d is listed twice in %s\n", id, file.c_str());
+            }
+            eps[id] = std::make_pair(rtr, p);
+        } else {
+            output.fatal(CALL_INFO, -1, "graph: unknown keyword %s on line %d of %s\n", keyword.c_str(), line_num,
+                         file.c_str());
+        }
+    }
+
+    if (routers == -1) {
+        output.fatal(CALL_INFO, -1, "graph: %s doesn't give the number of routers\n", file.c_str());
+    }
+    graph.num_routers = routers;
+
+    // Sort by router, then port, to build the CSR
+    std::sort(links.begin(), links.end());
+    graph.row.assign(routers + 1, 0);
+    for (const auto &l : links) {
+        int rtr = std::get<0>(l);
+        if (rtr >= routers || std::get<2>(l) >= routers) {
+            output.fatal(CALL_INFO, -1, "graph: link to router %d, but %s has %d routers\n",
+                         std::max(rtr, std::get<2>(l)), file.c_str(), routers);
+        }
+        graph.row[rtr + 1]++;
+        graph.nbr.push_back(std::get<2>(l));
+        graph.port.push_back(std::get<1>(l));
+        graph.remote_port.push_back(std::get<3>(l));
+    }
+    for (int r = 0; r < routers; r++) {
+        graph.row[r + 1] += graph.row[r];
+    }
+    for (size_t j = 1; j < links.size(); j++) {
+        if (std::get<0>(links[j]) == std::get<0>(links[j - 1]) && std::get<1>(links[j]) == std::get<1>(links[j - 1])) {
+            output.fatal(CALL_INFO, -1, "graph: port %d of router %d has more than one link\n",
+                         std::get<1>(links[j]), std::get<0>(links[j]));
+        }
+    }
+
+    graph.num_endpoints = eps.size();
+    graph.endpoint_map.resize(2 * graph.num_endpoints);
+    for (int id = 0; id < graph.num_endpoints; id++) {
+        int rtr = eps[id].first;
+        if (rtr == -1) {
+            output.fatal(CALL_INFO, -1, "graph: endpoint %d is missing from %s\n", id, file.c_str());
+        }
+        if (rtr >= routers) {
+            output.fatal(CALL_INFO, -1, "graph: endpoint %d is on router %d, but %s has %d routers\n", id, rtr,
+                         file.c_str(), routers);
+        }
+        graph.endpoint_map[2 * id] = rtr;
+        graph.endpoint_map[2 * id + 1] = eps[id].second;
+    }
+}
+
+void topo_graph::bfs(int root, const graph_t &graph, std::vector<int> &distance) const {
+    distance.assign(graph.num_routers, -1);
+    std::vector<int> frontier;
+    frontier.reserve(graph.num_routers);
+    frontier.push_back(root);
+    distance[root] = 0;
+    for (size_t head = 0; head < frontier.size(); head++) {
+        int r = frontier[head];
+        for (int j = graph.row[r]; j < graph.row[r + 1]; j++) {
+            if (distance[graph.nbr[j]] == -1) {
+                distance[graph.nbr[j]] = distance[r] + 1;
+                frontier.push_back(graph.nbr[j]);
+            }
+        }
+    }
+}
+
+void topo_graph::route(int /*port*/, int /*vc*/, internal_router_event *ev) {
+    int dest = ev->getDest();
+    int dest_router = endpoints[2 * dest];
+    if (dest_router == router_id) {
+        ev->setNextPort(endpoints[2 * dest + 1]);
+        return;
+    }
+
+    // The VC counts down to 0 on the last hop
+    int next_vc = ev->getVN() * vcs_per_vn + dist[(size_t)dest_router * num_routers + router_id] - 1;
+    ev->setVC(next_vc);
+
+    const uint64_t *mask = &masks[dest_router * mask_words_total + mask_offset];
+    candidates.clear();
+    for (int w = 0; w < mask_words; w++) {
+        uint64_t bits = mask[w];
+        while (bits) {
+            candidates.push_back(link_port[w * 64 + __builtin_ctzll(bits)]);
+            bits &= bits - 1;
+        }
+    }
+
+    int num_candidates = candidates.size();
+    int choice = flowHash(ev->getSrc(), dest, router_id) % num_candidates;
+    if (algorithm == ADAPTIVE) {
+        // Shortest output queue, with ties going to the ECMP choice
+        int best = candidates[choice];
+        int best_weight = output_queue_lengths[best * num_vcs + next_vc];
+        for (int i = 1; i < num_candidates; i++) {
+            int p = candidates[(choice + i) % num_candidates];
+            int weight = output_queue_lengths[p * num_vcs + next_vc];
+            if (weight < best_weight) {
+                best = p;
+                best_weight = weight;
+            }
+        }
+        ev->setNextPort(best);
+    } else {
+        ev->setNextPort(candidates[choice]);
+    }
+}
+
+void topo_graph::reroute(int port, int vc, internal_router_event *ev) {
+    // ECMP always picks the same port
+    if (algorithm == ECMP)
+        return;
+    route(port, vc, ev);
+}
+
+internal_router_event *topo_graph::process_input(RtrEvent *ev) {
+    auto *ire = new internal_router_event(ev);
+    ire->setVC(ire->getVN() * vcs_per_vn);
+    return ire;
+}
+
+void topo_graph::routeInitData(int port, internal_router_event *ev, std::vector<int> &outPorts) {
+    // The routing table isn't available until setup, so init data
+    // uses the BFS tree
+    int dest = ev->getDest();
+    if (dest != INIT_BROADCAST_ADDR) {
+        int dest_router = graph->endpoint_map[2 * dest];
+        if (dest_router == router_id) {
+            outPorts.push_back(graph->endpoint_map[2 * dest + 1]);
+            return;
+        }
+
+        // Down the tree if the destination is below this router, up
+        // toward router 0 otherwise
+        for (int r = dest_router; r != 0;) {
+            int j = graph->tree_link[r];
+            if (graph->nbr[j] == router_id) {
+                outPorts.push_back(graph->remote_port[j]);
+                return;
+            }
+            r = graph->nbr[j];
+        }
+        outPorts.push_back(graph->port[graph->tree_link[router_id]]);
+        return;
+    }
+
+    for (int p : tree_ports) {
+        if (p != port)
+            outPorts.push_back(p);
+    }
+    for (int p = 0; p < num_ports; p++) {
+        if (port_endpoint[p] != -1 && p != port)
+            outPorts.push_back(p);
+    }
+}
+
+internal_router_event *topo_graph::process_InitData_input(RtrEvent *ev) { return new internal_router_event(ev); }
+
+Topology::PortState topo_graph::getPortState(int port) const { return port_state[port]; }
+
+int topo_graph::computeNumVCs(int vns) { return vns * vcs_per_vn; }
+
+int topo_graph::getEndpointID(int port) { return port_endpoint[port]; }
+
+void topo_graph::setOutputQueueLengthsArray(int const *array, int vcs) {
+    output_queue_lengths = array;
+    num_vcs = vcs;
+}
@@ -0,0 +1,195 @@
+// -*- mode: c++ -*-
+
+// Copyright 2009-2020 NTESS. Under the terms
+// of Contract DE-NA0003525 with NTESS, the U.S.
+// Government retains certain rights in this software.
+//
+// Copyright (c) 2009-2020, NTESS
+// All rights reserved.
+//
+// Portions are copyright of other developers:
+// See the file CONTRIBUTORS.TXT in the top level directory
+// the distribution for more information.
+//
+// This file is part of the SST software package. For license
+// information, see the LICENSE file in the top level directory of the
+// distribution.
+
+#ifndef COMPONENTS_MERLIN_TOPOLOGY_GRAPH_H
+#define COMPONENTS_MERLIN_TOPOLOGY_GRAPH_H
+
+#include <sst/core/event.h>
+#include <sst/core/link.h>
+#include <sst/core/params.h>
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "../router.h"
+
+namespace SST {
+class SharedRegion;
+
+namespace Merlin {
+
+// Arbitrary topology read from a file.  The file lists the routers,
+// the router to router links and where each endpoint attaches:
+//
+//   # comment
+//   routers <num_routers>
+//   link <router_a> <port_a> <router_b> <port_b>
+//   endpoint <endpoint_id> <router> <port>
+//
+// Links are bidirectional.  Endpoint ids have to run from 0 to the
+// number of endpoints - 1.
+//
+// The file is parsed once per rank, the first time a router asks for
+// it, and the result is shared by all the routers that use it.
+//
+// Packets only take minimal paths.  The next hop table is built at
+// construction time: each router runs one BFS from itself and fills
+// in the part of the table for packets headed to it, so the work is
+// spread across all the routers (and ranks).  The table lives in a
+// SharedRegion so there is one copy per rank.  For each destination
+// router d and router s, it holds a bitmask over s's links (in the
+// order of s's row of the adjacency CSR) marking the links that are
+// on a shortest path to d, along with the distance from s to d.
+//
+// That makes the region grow with the square of the number of
+// routers: 8 bytes of mask for every pair of routers (more where a
+// router has over 64 links) and a byte of distance.  1,000 routers
+// need about 9MB on each rank, 10,000 about 900MB, so much larger
+// graphs need a table that only keeps each router's own rows.
+//
+// Init data, which is sent before the table is ready, goes over the
+// BFS tree from router 0.  Broadcasts go to every router on it, and
+// unicast data takes the tree path to the destination router.
+//
+// Deadlock is avoided by picking the VC from the distance left to the
+// destination, so a packet always moves to a lower VC.  This needs as
+// many VCs per VN as the diameter of the graph.
+class topo_graph : public Topology {
+
+  public:
+    SST_ELI_REGISTER_SUBCOMPONENT_DERIVED(topo_graph, "merlin", "graph", SST_ELI_ELEMENT_VERSION(1, 0, 0),
+                                          "Arbitrary topology loaded from an adjacency file, with minimal multipath "
+                                          "routing",
+                                          SST::Merlin::Topology)
+
+    SST_ELI_DOCUMENT_PARAMS(
+        {"file", "File holding the router links and endpoint attachments.  See topology/graph.h for the format."},
+        {"algorithm",
+         "Routing algorithm to use.  ecmp hashes the source, destination and router id to pick one of the minimal "
+         "ports, so a flow always takes the same path.  adaptive takes the minimal port with the shortest output "
+         "queue.",
+         "ecmp"},
+        {"vcs_per_vn",
+         "Number of VCs to use for each VN.  Has to be at least the diameter of the graph.  Defaults to twice the "
+         "largest distance from router 0, which is never less than the diameter.",
+         ""})
+
+    enum RouteAlgo { ECMP, ADAPTIVE };
+
+  private:
+    // Contents of a graph file
+    struct graph_t {
+        int num_routers;
+        int num_endpoints;
+        // Adjacency CSR over all the routers, sorted by router and then
+        // port.  For link j out of router s, nbr[j] is the router at the
+        // other end, port[j] the port on s and remote_port[j] the port
+        // on nbr[j].
+        std::vector<int> row;
+        std::vector<int> nbr;
+        std::vector<int> port;
+        std::vector<int> remote_port;
+        // Router and port of each endpoint
+        std::vector<uint32_t> endpoint_map;
+        // Distance from router 0, for the broadcast tree and the
+        // default VC count
+        std::vector<int> root_distance;
+        // Link from each router to its parent in the broadcast tree,
+        // as an index into the CSR.  -1 for router 0.
+        std::vector<int> tree_link;
+    };
+
+    // Parsed files by name.  They are kept for the whole run, since
+    // routers are constructed one at a time and each needs the graph.
+    static std::map<std::string, std::shared_ptr<const graph_t>> graph_cache;
+    static std::mutex graph_cache_lock;
+
+    // Init data is routed from the parsed graph
+    std::shared_ptr<const graph_t> graph;
+
+    int router_id;
+    int num_ports;
+    int num_routers;
+    int num_endpoints;
+
+    RouteAlgo algorithm;
+    int vcs_per_vn;
+
+    // This router's row of the adjacency CSR: the local port of each
+    // link to another router
+    std::vector<int> link_port;
+    std::vector<PortState> port_state;
+    // Endpoint attached to each port, or -1
+    std::vector<int> port_endpoint;
+    // Ports that are part of the broadcast tree for init data
+    std::vector<int> tree_ports;
+
+    // Layout of the shared region.  The masks come first, with the
+    // ones for destination router d and this router at word d *
+    // mask_words_total + mask_offset.  Then the router and port of
+    // each endpoint as pairs of uint32_t, starting at byte
+    // endpoint_start.  Last are the distances, with the distance from
+    // router s to d at byte dist_start + d * num_routers + s.
+    SharedRegion *region;
+    int mask_words;
+    size_t mask_offset;
+    size_t mask_words_total;
+    size_t endpoint_start;
+    size_t dist_start;
+
+    const uint64_t *masks;
+    const uint32_t *endpoints;
+    const uint8_t *dist;
+
+    int const *output_queue_lengths;
+    int num_vcs;
+
+    // Minimal ports for the packet being routed
+    std::vector<int> candidates;
+
+  public:
+    topo_graph(ComponentId_t cid, Params &params, int num_ports, int rtr_id);
+    ~topo_graph() override;
+
+    void setup() override;
+
+    void route(int port, int vc, internal_router_event *ev) override;
+    void reroute(int port, int vc, internal_router_event *ev) override;
+    internal_router_event *process_input(RtrEvent *ev) override;
+
+    void routeInitData(int port, internal_router_event *ev, std::vector<int> &outPorts) override;
+    internal_router_event *process_InitData_input(RtrEvent *ev) override;
+
+    PortState getPortState(int port) const override;
+    int computeNumVCs(int vns) override;
+    int getEndpointID(int port) override;
+
+    void setOutputQueueLengthsArray(int const *array, int vcs) override;
+
+  private:
+    std::shared_ptr<const graph_t> getGraph(const std::string &file);
+    void loadGraph(const std::string &file, graph_t &graph);
+    void bfs(int root, const graph_t &graph, std::vector<int> &distance) const;
+};
+
+} // namespace Merlin
+} // namespace SST
+
+#endif // COMPONENTS_MERLIN_TOPOLOGY_GRAPH_H
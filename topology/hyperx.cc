@@ -33,6 +33,10 @@ topo_hyperx::topo_hyperx(ComponentId_t cid, Params &params, int num_ports, int r
     // Need to parse the shape string to get the number of dimensions
     // and the size of each dimension
     dimensions = std::count(shape.begin(), shape.end(), 'x') + 1;
+    if (dimensions > MERLIN_MAX_DIMENSIONS) {
+        output.fatal(CALL_INFO, -1, "hyperx: number of dimensions (%d) exceeds MERLIN_MAX_DIMENSIONS (%d)\n", dimensions,
+                     MERLIN_MAX_DIMENSIONS);
+    }
 
     dim_size = new int[dimensions];
     dim_width = new int[dimensions];
@@ -23,7 +23,6 @@
 #include <sst/core/params.h>
 #include <sst/core/rng/sstrng.h>
 
-#include <cstring>
 #include <vector>
 
 #include "../router.h"
@@ -36,29 +35,22 @@ class topo_hyperx_event : public internal_router_event {
     int dimensions;
     // First non aligned dimension
     int last_routing_dim;
-    int *dest_loc;
+    int dest_loc[MERLIN_MAX_DIMENSIONS];
     bool val_route_dest;
-    int *val_loc;
+    int val_loc[MERLIN_MAX_DIMENSIONS];
 
     id_type id;
     bool rerouted;
 
     topo_hyperx_event() : internal_router_event() {}
     topo_hyperx_event(int dim) : internal_router_event(), dimensions(dim), last_routing_dim(-1), val_route_dest(false) {
-        dest_loc = new int[dim];
-        val_loc = new int[dim];
         id = generateUniqueId();
     }
-    ~topo_hyperx_event() override {
-        delete[] dest_loc;
-        delete[] val_loc;
-    }
-    internal_router_event *clone() override {
-        auto *tte = new topo_hyperx_event(*this);
-        tte->dest_loc = new int[dimensions];
-        memcpy(tte->dest_loc, dest_loc, dimensions * sizeof(int));
-        return tte;
-    }
+    ~topo_hyperx_event() override = default;
+
+    MERLIN_POOLED_EVENT(topo_hyperx_event)
+
+    internal_router_event *clone() override { return new topo_hyperx_event(*this); }
 
     void getUnalignedDimensions(int *curr_loc, std::vector<int> &dims) {
         for (int i = 0; i < dimensions; ++i) {
@@ -72,18 +64,10 @@ class topo_hyperx_event : public internal_router_event {
         ser &dimensions;
         ser &last_routing_dim;
 
-        if (ser.mode() == SST::Core::Serialization::serializer::UNPACK) {
-            dest_loc = new int[dimensions];
-        }
-
         for (int i = 0; i < dimensions; i++) {
             ser &dest_loc[i];
         }
 
-        if (ser.mode() == SST::Core::Serialization::serializer::UNPACK) {
-            val_loc = new int[dimensions];
-        }
-
         for (int i = 0; i < dimensions; i++) {
             ser &val_loc[i];
         }
@@ -105,13 +89,7 @@ class topo_hyperx_init_event : public topo_hyperx_event {
     topo_hyperx_init_event() : topo_hyperx_event() {}
     topo_hyperx_init_event(int dim) : topo_hyperx_event(dim), phase(0) {}
     ~topo_hyperx_init_event() override = default;
-    internal_router_event *clone() override {
-        auto *tte = new topo_hyperx_init_event(*this);
-        tte->dest_loc = new int[dimensions];
-        tte->val_loc = new int[dimensions];
-        memcpy(tte->dest_loc, dest_loc, dimensions * sizeof(int));
-        return tte;
-    }
+    internal_router_event *clone() override { return new topo_hyperx_init_event(*this); }
 
     void serialize_order(SST::Core::Serialization::serializer &ser) override {
         topo_hyperx_event::serialize_order(ser);
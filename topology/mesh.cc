@@ -20,7 +20,8 @@
 
 using namespace SST::Merlin;
 
-topo_mesh::topo_mesh(ComponentId_t cid, Params &params, int num_ports, int rtr_id) : Topology(cid), router_id(rtr_id) {
+topo_mesh::topo_mesh(ComponentId_t cid, Params &params, int num_ports, int rtr_id)
+    : Topology(cid), router_id(rtr_id), output_credits(nullptr), output_queue_lengths(nullptr), num_vcs(0) {
 
     // Get the various parameters
     std::string shape;
@@ -31,6 +32,10 @@ topo_mesh::topo_mesh(ComponentId_t cid, Params &params, int num_ports, int rtr_i
     // Need to parse the shape string to get the number of dimensions
     // and the size of each dimension
     dimensions = std::count(shape.begin(), shape.end(), 'x') + 1;
+    if (dimensions > MERLIN_MAX_DIMENSIONS) {
+        output.fatal(CALL_INFO, -1, "mesh: number of dimensions (%d) exceeds MERLIN_MAX_DIMENSIONS (%d)\n", dimensions,
+                     MERLIN_MAX_DIMENSIONS);
+    }
 
     dim_size = new int[dimensions];
     dim_width = new int[dimensions];
@@ -56,6 +61,28 @@ topo_mesh::topo_mesh(ComponentId_t cid, Params &params, int num_ports, int rtr_i
 
     num_local_ports = params.find<int>("local_ports", 1);
 
+    std::string route_algo = params.find<std::string>("algorithm", "dor");
+    if (route_algo == "dor") {
+        algorithm = DOR;
+    } else if (route_algo == "west_first") {
+        algorithm = WEST_FIRST;
+    } else if (route_algo == "negative_first") {
+        algorithm = NEGATIVE_FIRST;
+    } else if (route_algo == "odd_even") {
+        algorithm = ODD_EVEN;
+    } else if (route_algo == "planar_adaptive") {
+        algorithm = PLANAR_ADAPTIVE;
+    } else {
+        output.fatal(CALL_INFO, -1, "Invalid algorithm specified for mesh: %s.\n", route_algo.c_str());
+    }
+
+    vcs_per_vn = algorithm == PLANAR_ADAPTIVE ? 3 : 2;
+
+    if ((algorithm == WEST_FIRST || algorithm == ODD_EVEN) && dimensions > 2) {
+        output.fatal(CALL_INFO, -1, "mesh: %s routing is only deadlock free in 1D and 2D meshes\n",
+                     route_algo.c_str());
+    }
+
     int needed_ports = 0;
     for (int i = 0; i < dimensions; i++) {
         needed_ports += 2 * dim_width[i];
@@ -80,34 +107,233 @@ topo_mesh::~topo_mesh() {
 }
 
 void topo_mesh::route(int port, int vc, internal_router_event *ev) {
+    if (algorithm == DOR) {
+        routeDOR(port, vc, ev);
+    } else if (get_dest_router(ev->getDest()) == router_id) {
+        ev->setNextPort(get_dest_local_port(ev->getDest()));
+    } else {
+        routeTurnModel(static_cast<topo_mesh_event *>(ev));
+    }
+}
+
+void topo_mesh::reroute(int port, int vc, internal_router_event *ev) {
+    // Dimension order routing always picks the same port
+    if (algorithm == DOR)
+        return;
+    route(port, vc, ev);
+}
+
+void topo_mesh::routeDOR(int port, int vc, internal_router_event *ev) {
     int dest_router = get_dest_router(ev->getDest());
     if (dest_router == router_id) {
         ev->setNextPort(get_dest_local_port(ev->getDest()));
     } else {
-        auto *tt_ev = static_cast<topo_mesh_event *>(ev);
+        routeFrom(id_loc, port, vc, static_cast<topo_mesh_event *>(ev));
+    }
+}
 
-        for (int dim = tt_ev->routing_dim; dim < dimensions; dim++) {
-            if (tt_ev->dest_loc[dim] != id_loc[dim]) {
+// Dimension order routing step for a packet at the router at loc,
+// which is not the destination router
+void topo_mesh::routeFrom(const int *loc, int port, int vc, topo_mesh_event *tt_ev) {
+    for (int dim = tt_ev->routing_dim; dim < dimensions; dim++) {
+        if (tt_ev->dest_loc[dim] != loc[dim]) {
 
-                int go_pos = (id_loc[dim] < tt_ev->dest_loc[dim]);
+            int go_pos = (loc[dim] < tt_ev->dest_loc[dim]);
 
-                int p = choose_multipath(port_start[dim][(go_pos) ? 0 : 1], dim_width[dim],
-                                         abs(id_loc[dim] - tt_ev->dest_loc[dim]));
+            int p = choose_multipath(port_start[dim][(go_pos) ? 0 : 1], dim_width[dim],
+                                     abs(loc[dim] - tt_ev->dest_loc[dim]));
 
-                tt_ev->setNextPort(p);
+            tt_ev->setNextPort(p);
 
-                if (id_loc[dim] == 0 && port < local_port_start) { // Crossing dateline
-                    int new_vc = vc ^ 1;
-                    tt_ev->setVC(new_vc); // Toggle VC
-                    output.verbose(CALL_INFO, 1, 1, "Crossing dateline.  Changing from VC %d to %d\n", vc, new_vc);
-                }
+            if (loc[dim] == 0 && port < local_port_start) { // Crossing dateline
+                int new_vc = vc ^ 1;
+                tt_ev->setVC(new_vc); // Toggle VC
+                output.verbose(CALL_INFO, 1, 1, "Crossing dateline.  Changing from VC %d to %d\n", vc, new_vc);
+            }
 
-                break;
+            break;
+
+        } else {
+            // Time to change direction
+            tt_ev->routing_dim++;
+            tt_ev->setVC(vc & (~1)); // Reset the VC
+        }
+    }
+}
 
+// Partially adaptive routing step.  The turn models forbid enough
+// turns to break every cycle in the channel dependency graph:
+//
+//   west_first:      no turns into the negative direction of dim 0,
+//                    so any westward hops come first
+//   negative_first:  no turns from a positive direction into a
+//                    negative one, so all negative hops come first
+//   odd_even:        no east to north/south turns in even columns of
+//                    dim 0 and no north/south to west turns in odd
+//                    columns (Chiu's ROUTE function)
+//
+// planar_adaptive routes adaptively in the plane of the lowest two
+// unfinished dimensions, a and a+1, until a is done (Chien and Kim).
+// Hops in dim a use VC 2.  Hops in dim a+1 use VC 0 if the packet is
+// moving in the positive direction of dim a and VC 1 otherwise, which
+// splits the plane into two networks that can't form a cycle.  Each
+// dimension keeps VCs 0 and 1 for being the second dimension of one
+// plane and VC 2 for being the first of the next, so the planes
+// share no channels.
+void topo_mesh::routeTurnModel(topo_mesh_event *tt_ev) {
+    int base_vc = tt_ev->getVN() * vcs_per_vn;
+
+    int offset[MERLIN_MAX_DIMENSIONS];
+    for (int dim = 0; dim < dimensions; dim++)
+        offset[dim] = tt_ev->dest_loc[dim] - id_loc[dim];
+
+    // Allowed (dimension, direction, vc) choices
+    int cand_dim[2 * MERLIN_MAX_DIMENSIONS];
+    int cand_dir[2 * MERLIN_MAX_DIMENSIONS];
+    int cand_vc[2 * MERLIN_MAX_DIMENSIONS];
+    int num_cand = 0;
+    auto add = [&](int dim, int vc) {
+        cand_dim[num_cand] = dim;
+        cand_dir[num_cand] = offset[dim] > 0 ? 0 : 1;
+        cand_vc[num_cand] = vc;
+        num_cand++;
+    };
+
+    switch (algorithm) {
+    case WEST_FIRST:
+        if (offset[0] < 0) {
+            add(0, base_vc);
+            break;
+        }
+        for (int dim = 0; dim < dimensions; dim++) {
+            if (offset[dim] != 0)
+                add(dim, base_vc);
+        }
+        break;
+    case NEGATIVE_FIRST: {
+        bool negative = false;
+        for (int dim = 0; dim < dimensions; dim++) {
+            if (offset[dim] < 0) {
+                add(dim, base_vc);
+                negative = true;
+            }
+        }
+        if (negative)
+            break;
+        for (int dim = 0; dim < dimensions; dim++) {
+            if (offset[dim] > 0)
+                add(dim, base_vc);
+        }
+        break;
+    }
+    case ODD_EVEN: {
+        int y_offset = dimensions > 1 ? offset[1] : 0;
+        int src_x = get_dest_router(tt_ev->getSrc()) % dim_size[0];
+        if (offset[0] == 0) {
+            add(1, base_vc);
+        } else if (offset[0] > 0) {
+            if (y_offset == 0) {
+                add(0, base_vc);
             } else {
-                // Time to change direction
-                tt_ev->routing_dim++;
-                tt_ev->setVC(vc & (~1)); // Reset the VC
+                if ((id_loc[0] & 1) || id_loc[0] == src_x)
+                    add(1, base_vc);
+                if ((tt_ev->dest_loc[0] & 1) || offset[0] != 1)
+                    add(0, base_vc);
+            }
+        } else {
+            add(0, base_vc);
+            if (y_offset != 0 && !(id_loc[0] & 1))
+                add(1, base_vc);
+        }
+        break;
+    }
+    case PLANAR_ADAPTIVE: {
+        int a = 0;
+        while (offset[a] == 0)
+            a++;
+        add(a, base_vc + 2);
+        if (a + 1 < dimensions && offset[a + 1] != 0)
+            add(a + 1, base_vc + (offset[a] > 0 ? 0 : 1));
+        break;
+    }
+    default:
+        break;
+    }
+
+    int best_port = -1;
+    int best_vc = base_vc;
+    int best_credits = 0;
+    int best_length = 0;
+    for (int c = 0; c < num_cand; c++) {
+        for (int i = 0; i < dim_width[cand_dim[c]]; i++) {
+            int p = port_start[cand_dim[c]][cand_dir[c]] + i;
+            int index = p * num_vcs + cand_vc[c];
+            int credits = output_credits[index];
+            int length = output_queue_lengths[index];
+            if (best_port == -1 || credits > best_credits || (credits == best_credits && length < best_length)) {
+                best_port = p;
+                best_vc = cand_vc[c];
+                best_credits = credits;
+                best_length = length;
+            }
+        }
+    }
+
+    tt_ev->setNextPort(best_port);
+    tt_ev->setVC(best_vc);
+}
+
+// Walks the path route() would take from this router to the
+// destination.  A packet leaving on the positive port k of a
+// dimension arrives on the negative port k of the next router, and
+// vice versa.
+bool topo_mesh::computeSourceRoute(int port, int vc, internal_router_event *ev) {
+    if (algorithm != DOR)
+        return false;
+
+    // Scratch copy so the routing state in the event isn't touched
+    topo_mesh_event scratch(*static_cast<topo_mesh_event *>(ev));
+    scratch.setEncapsulatedEvent(nullptr);
+
+    int loc[MERLIN_MAX_DIMENSIONS];
+    for (int i = 0; i < dimensions; i++)
+        loc[i] = id_loc[i];
+
+    SourceRoute route;
+    while (true) {
+        bool at_dest = true;
+        for (int i = 0; i < dimensions; i++) {
+            if (loc[i] != scratch.dest_loc[i]) {
+                at_dest = false;
+                break;
+            }
+        }
+        if (at_dest) {
+            if (!route.addHop(get_dest_local_port(ev->getDest()), vc))
+                return false;
+            ev->setSourceRoute(route);
+            return true;
+        }
+
+        routeFrom(loc, port, vc, &scratch);
+        int out_port = scratch.getNextPort();
+        vc = scratch.getVC();
+        if (!route.addHop(out_port, vc))
+            return false;
+
+        // Move to the next router
+        for (int dim = 0; dim < dimensions; dim++) {
+            int offset = out_port - port_start[dim][0];
+            if (offset >= 0 && offset < dim_width[dim]) {
+                loc[dim] = (loc[dim] + 1) % dim_size[dim];
+                port = port_start[dim][1] + offset;
+                break;
+            }
+            offset = out_port - port_start[dim][1];
+            if (offset >= 0 && offset < dim_width[dim]) {
+                loc[dim] = (loc[dim] + dim_size[dim] - 1) % dim_size[dim];
+                port = port_start[dim][0] + offset;
+                break;
             }
         }
     }
@@ -116,7 +342,7 @@ void topo_mesh::route(int port, int vc, internal_router_event *ev) {
 internal_router_event *topo_mesh::process_input(RtrEvent *ev) {
     auto *tt_ev = new topo_mesh_event(dimensions);
     tt_ev->setEncapsulatedEvent(ev);
-    tt_ev->setVC(tt_ev->getVN() * 2);
+    tt_ev->setVC(tt_ev->getVN() * vcs_per_vn);
 
     // Need to figure out what the mesh address is for easier
     // routing.
@@ -133,7 +359,7 @@ void topo_mesh::routeInitData(int port, internal_router_event *ev, std::vector<i
             /* Broadcast has arrived at 0.  Switch Phases */
             tt_ev->phase = 1;
         } else {
-            route(port, 0, ev);
+            routeDOR(port, 0, ev);
             outPorts.push_back(ev->getNextPort());
             return;
         }
@@ -246,10 +472,20 @@ int topo_mesh::choose_multipath(int start_port, int num_ports, int dest_dist) {
     }
 }
 
-int topo_mesh::computeNumVCs(int vns) { return 2 * vns; }
+int topo_mesh::computeNumVCs(int vns) { return vcs_per_vn * vns; }
 
 int topo_mesh::getEndpointID(int port) {
     if (!isHostPort(port))
         return -1;
     return (router_id * num_local_ports) + (port - local_port_start);
 }
+
+void topo_mesh::setOutputBufferCreditArray(int const *array, int vcs) {
+    output_credits = array;
+    num_vcs = vcs;
+}
+
+void topo_mesh::setOutputQueueLengthsArray(int const *array, int vcs) {
+    output_queue_lengths = array;
+    num_vcs = vcs;
+}
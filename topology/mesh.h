@@ -22,8 +22,6 @@
 #include <sst/core/link.h>
 #include <sst/core/params.h>
 
-#include <cstring>
-
 #include "../router.h"
 
 namespace SST {
@@ -33,31 +31,24 @@ class topo_mesh_event : public internal_router_event {
   public:
     int dimensions;
     int routing_dim;
-    int *dest_loc;
+    int dest_loc[MERLIN_MAX_DIMENSIONS];
 
     topo_mesh_event() = default;
     topo_mesh_event(int dim) {
         dimensions = dim;
         routing_dim = 0;
-        dest_loc = new int[dim];
-    }
-    ~topo_mesh_event() override { delete[] dest_loc; }
-    internal_router_event *clone() override {
-        auto *tte = new topo_mesh_event(*this);
-        tte->dest_loc = new int[dimensions];
-        memcpy(tte->dest_loc, dest_loc, dimensions * sizeof(int));
-        return tte;
     }
+    ~topo_mesh_event() override = default;
+
+    MERLIN_POOLED_EVENT(topo_mesh_event)
+
+    internal_router_event *clone() override { return new topo_mesh_event(*this); }
 
     void serialize_order(SST::Core::Serialization::serializer &ser) override {
         internal_router_event::serialize_order(ser);
         ser &dimensions;
         ser &routing_dim;
 
-        if (ser.mode() == SST::Core::Serialization::serializer::UNPACK) {
-            dest_loc = new int[dimensions];
-        }
-
         for (int i = 0; i < dimensions; i++) {
             ser &dest_loc[i];
         }
@@ -75,12 +66,7 @@ class topo_mesh_init_event : public topo_mesh_event {
     topo_mesh_init_event() = default;
     topo_mesh_init_event(int dim) : topo_mesh_event(dim), phase(0) {}
     ~topo_mesh_init_event() override = default;
-    internal_router_event *clone() override {
-        auto *tte = new topo_mesh_init_event(*this);
-        tte->dest_loc = new int[dimensions];
-        memcpy(tte->dest_loc, dest_loc, dimensions * sizeof(int));
-        return tte;
-    }
+    internal_router_event *clone() override { return new topo_mesh_init_event(*this); }
 
     void serialize_order(SST::Core::Serialization::serializer &ser) override {
         topo_mesh_event::serialize_order(ser);
@@ -103,12 +89,24 @@ class topo_mesh : public Topology {
         {"mesh:width", "Number of links between routers in each dimension, specified in same manner as for shape.  For "
                        "example, 2x2x1 denotes 2 links in the x and y dimensions and one in the z dimension."},
         {"mesh:local_ports", "Number of endpoints attached to each router."},
+        {"mesh:algorithm",
+         "Routing algorithm to use [dor (default) | west_first | negative_first | odd_even | planar_adaptive].  "
+         "west_first and odd_even are for 1D and 2D meshes only.  planar_adaptive uses three VCs per VN, the "
+         "others two.",
+         "dor"},
 
         {"shape", "Shape of the mesh specified as the number of routers in each dimension, where each dimension is "
                   "separated by a colon.  For example, 4x4x2x2.  Any number of dimensions is supported."},
         {"width", "Number of links between routers in each dimension, specified in same manner as for shape.  For "
                   "example, 2x2x1 denotes 2 links in the x and y dimensions and one in the z dimension."},
-        {"local_ports", "Number of endpoints attached to each router."})
+        {"local_ports", "Number of endpoints attached to each router."},
+        {"algorithm",
+         "Routing algorithm to use [dor (default) | west_first | negative_first | odd_even | planar_adaptive].  "
+         "west_first and odd_even are for 1D and 2D meshes only.  planar_adaptive uses three VCs per VN, the "
+         "others two.",
+         "dor"})
+
+    enum RouteAlgo { DOR, WEST_FIRST, NEGATIVE_FIRST, ODD_EVEN, PLANAR_ADAPTIVE };
 
   private:
     int router_id;
@@ -123,12 +121,25 @@ class topo_mesh : public Topology {
     int num_local_ports;
     int local_port_start;
 
+    // Everything but dor is partially adaptive.  The routing function
+    // gives the productive ports the algorithm allows and the one with
+    // the most credits for the packet's VC is taken, with ties going
+    // to the shorter output queue.  planar_adaptive takes three VCs
+    // per VN, everything else the two dor already uses.
+    RouteAlgo algorithm;
+    int vcs_per_vn;
+    int const *output_credits;
+    int const *output_queue_lengths;
+    int num_vcs;
+
   public:
     topo_mesh(ComponentId_t cid, Params &params, int num_ports, int rtr_id);
     ~topo_mesh() override;
 
     void route(int port, int vc, internal_router_event *ev) override;
+    void reroute(int port, int vc, internal_router_event *ev) override;
     internal_router_event *process_input(RtrEvent *ev) override;
+    bool computeSourceRoute(int port, int vc, internal_router_event *ev) override;
 
     void routeInitData(int port, internal_router_event *ev, std::vector<int> &outPorts) override;
     internal_router_event *process_InitData_input(RtrEvent *ev) override;
@@ -137,10 +148,16 @@ class topo_mesh : public Topology {
     int computeNumVCs(int vns) override;
     int getEndpointID(int port) override;
 
+    void setOutputBufferCreditArray(int const *array, int vcs) override;
+    void setOutputQueueLengthsArray(int const *array, int vcs) override;
+
   protected:
     virtual int choose_multipath(int start_port, int num_ports, int dest_dist);
 
   private:
+    void routeDOR(int port, int vc, internal_router_event *ev);
+    void routeFrom(const int *loc, int port, int vc, topo_mesh_event *ev);
+    void routeTurnModel(topo_mesh_event *ev);
     void idToLocation(int id, int *location) const;
     void parseDimString(const std::string &shape, int *output) const;
     int get_dest_router(int dest_id) const;
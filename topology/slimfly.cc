@@ -0,0 +1,404 @@
+// Copyright 2009-2020 NTESS. Under the terms
+// of Contract DE-NA0003525 with NTESS, the U.S.
+// Government retains certain rights in this software.
+//
+// Copyright (c) 2009-2020, NTESS
+// All rights reserved.
+//
+// Portions are copyright of other developers:
+// See the file CONTRIBUTORS.TXT in the top level directory
+// the distribution for more information.
+//
+// This file is part of the SST software package. For license
+// information, see the LICENSE file in the top level directory of the
+// distribution.
+//
+
+#include <sst/core/sst_config.h>
+#include "sst/core/rng/xorshift.h"
+
+#include "slimfly.h"
+
+#include <algorithm>
+
+using namespace SST::Merlin;
+
+topo_slimfly::topo_slimfly(ComponentId_t cid, Params &params, int num_ports, int rtr_id)
+    : Topology(cid), router_id(rtr_id), num_ports(num_ports), output_queue_lengths(nullptr), num_vcs(0) {
+
+    q = params.find<int>("q", 0);
+    // q = 2 would need delta = 2
+    if (q < 3 || q % 4 == 2) {
+        output.fatal(CALL_INFO, -1, "slimfly: q must be a prime power of at least 3, got %d\n", q);
+    }
+    hosts_per_router = params.find<int>("hosts_per_router", -1);
+    if (hosts_per_router <= 0) {
+        output.fatal(CALL_INFO, -1, "slimfly requires hosts_per_router to be specified and greater than 0\n");
+    }
+
+    std::string route_algo = params.find<std::string>("algorithm", "minimal");
+    if (route_algo == "minimal")
+        algorithm = MINIMAL;
+    else if (route_algo == "ugal")
+        algorithm = UGAL;
+    else {
+        output.fatal(CALL_INFO, -1, "Invalid algorithm specified for slimfly: %s.\n", route_algo.c_str());
+    }
+    ugal_threshold = params.find<int>("ugal_threshold", 0);
+    vcs_per_vn = (algorithm == UGAL) ? 4 : 2;
+
+    num_routers = 2 * q * q;
+    if (router_id >= num_routers) {
+        output.fatal(CALL_INFO, -1, "slimfly: router id %d is too large for q = %d (%d routers)\n", router_id, q,
+                     num_routers);
+    }
+
+    std::vector<int> powers;
+    buildField(powers);
+    buildGeneratorSets(powers);
+
+    int delta = (q % 4 == 1) ? 1 : ((q % 4 == 3) ? -1 : 0);
+    num_router_ports = (3 * q - delta) / 2;
+    getNeighbors(router_id, neighbors);
+    if ((int)neighbors.size() != num_router_ports) {
+        output.fatal(CALL_INFO, -1, "slimfly: router %d has %d neighbors, expected %d\n", router_id,
+                     (int)neighbors.size(), num_router_ports);
+    }
+    if (hosts_per_router + num_router_ports > num_ports) {
+        output.fatal(CALL_INFO, -1, "slimfly: routers need %d ports for q = %d and %d hosts, but only have %d\n",
+                     hosts_per_router + num_router_ports, q, hosts_per_router, num_ports);
+    }
+
+    // Minimal routes.  Routers two hops away go through the lowest
+    // numbered common neighbor.
+    route_table.resize(num_routers, 0);
+    for (int dest = 0; dest < num_routers; dest++) {
+        if (dest == router_id)
+            continue;
+        if (connected(router_id, dest)) {
+            route_table[dest] = portForNeighbor(dest);
+            continue;
+        }
+        int i = 0;
+        while (i < num_router_ports && !connected(neighbors[i], dest))
+            i++;
+        if (i == num_router_ports) {
+            output.fatal(CALL_INFO, -1, "slimfly: router %d is more than 2 hops from router %d\n", dest, router_id);
+        }
+        route_table[dest] = hosts_per_router + i;
+    }
+
+    rng = new RNG::XORShiftRNG(router_id + 1);
+
+    output.verbose(CALL_INFO, 1, 1, "slimfly: router %d, q = %d, %d hosts, %d router ports\n", router_id, q,
+                   hosts_per_router, num_router_ports);
+}
+
+topo_slimfly::~topo_slimfly() { delete rng; }
+
+// Builds the GF(q) tables.  Elements are numbered by the coefficients
+// of their polynomial over GF(p) as base p digits.  powers is filled
+// in with the powers of the primitive element that was found.
+void topo_slimfly::buildField(std::vector<int> &powers) {
+    int p = 2;
+    while (q % p != 0)
+        p++;
+    int e = 0;
+    for (int t = q; t > 1; t /= p) {
+        if (t % p != 0) {
+            output.fatal(CALL_INFO, -1, "slimfly: q must be a prime power, got %d\n", q);
+        }
+        e++;
+    }
+
+    gf_add.resize(q * q);
+    gf_sub.resize(q * q);
+    for (int a = 0; a < q; a++) {
+        for (int b = 0; b < q; b++) {
+            int sum = 0;
+            int diff = 0;
+            int place = 1;
+            for (int da = a, db = b; place < q; da /= p, db /= p, place *= p) {
+                sum += ((da % p + db % p) % p) * place;
+                diff += ((da % p - db % p + p) % p) * place;
+            }
+            gf_add[a * q + b] = sum;
+            gf_sub[a * q + b] = diff;
+        }
+    }
+
+    // Search for a primitive element.  For a prime field, try each
+    // element in turn.  Otherwise use x, and try each monic degree e
+    // polynomial as the modulus until x generates the field.
+    for (int candidate = 1; candidate < q; candidate++) {
+        powers.assign(1, 1);
+        int val = 1;
+        while (true) {
+            if (e == 1) {
+                val = (val * candidate) % p;
+            } else {
+                // Multiply by x modulo x^e + sum(digit i of candidate * x^i)
+                int top = val / (q / p);
+                int shifted = (val % (q / p)) * p;
+                int place = 1;
+                int next = 0;
+                for (int i = 0, c = candidate, s = shifted; i < e; i++, c /= p, s /= p, place *= p) {
+                    next += ((s % p - top * (c % p) % p + p) % p) * place;
+                }
+                val = next;
+            }
+            if (val == 1 || (int)powers.size() == q)
+                break;
+            powers.push_back(val);
+        }
+        if ((int)powers.size() == q - 1 && val == 1)
+            break;
+        powers.clear();
+    }
+    if (powers.empty()) {
+        output.fatal(CALL_INFO, -1, "slimfly: unable to find a primitive element of GF(%d)\n", q);
+    }
+
+    std::vector<int> log_table(q, 0);
+    for (int i = 0; i < q - 1; i++) {
+        log_table[powers[i]] = i;
+    }
+    gf_mul.assign(q * q, 0);
+    for (int a = 1; a < q; a++) {
+        for (int b = 1; b < q; b++) {
+            gf_mul[a * q + b] = powers[(log_table[a] + log_table[b]) % (q - 1)];
+        }
+    }
+}
+
+// X and X' from the Slim Fly paper (Besta and Hoefler, SC14)
+void topo_slimfly::buildGeneratorSets(const std::vector<int> &powers) {
+    in_x.assign(q, false);
+    in_x_prime.assign(q, false);
+
+    if (q % 4 == 1) {
+        for (int i = 0; i <= q - 3; i += 2) {
+            in_x[powers[i]] = true;
+            in_x_prime[powers[i + 1]] = true;
+        }
+    } else if (q % 4 == 3) {
+        int w = (q + 1) / 4;
+        for (int i = 0; i <= 2 * w - 2; i += 2) {
+            in_x[powers[i]] = true;
+            in_x_prime[powers[i + 1]] = true;
+        }
+        // The last power in X' is xi^(q - 1) = 1
+        for (int i = 2 * w - 1; i <= 4 * w - 3; i += 2) {
+            in_x[powers[i]] = true;
+            in_x_prime[powers[(i + 1) % (q - 1)]] = true;
+        }
+    } else {
+        for (int i = 0; i <= q - 2; i += 2) {
+            in_x[powers[i]] = true;
+            in_x_prime[powers[(i + 1) % (q - 1)]] = true;
+        }
+    }
+}
+
+bool topo_slimfly::connected(int a, int b) const {
+    int qq = q * q;
+    int sa = a / qq;
+    int sb = b / qq;
+    int a1 = (a % qq) / q;
+    int a2 = a % q;
+    int b1 = (b % qq) / q;
+    int b2 = b % q;
+
+    if (sa == sb) {
+        if (a1 != b1 || a2 == b2)
+            return false;
+        return sa == 0 ? in_x[gf_sub[a2 * q + b2]] : in_x_prime[gf_sub[a2 * q + b2]];
+    }
+
+    // (0, x, y) -- (1, m, c) if y = m * x + c
+    if (sa == 1) {
+        std::swap(a1, b1);
+        std::swap(a2, b2);
+    }
+    return a2 == gf_add[gf_mul[b1 * q + a1] * q + b2];
+}
+
+void topo_slimfly::getNeighbors(int rtr, std::vector<int> &nbrs) const {
+    int qq = q * q;
+    int s = rtr / qq;
+    int a = (rtr % qq) / q;
+    int b = rtr % q;
+
+    nbrs.clear();
+    const std::vector<bool> &gen = (s == 0) ? in_x : in_x_prime;
+    for (int g = 1; g < q; g++) {
+        if (gen[g])
+            nbrs.push_back(s * qq + a * q + gf_add[b * q + g]);
+    }
+    for (int i = 0; i < q; i++) {
+        if (s == 0) {
+            // (1, m, y - m * x)
+            nbrs.push_back(qq + i * q + gf_sub[b * q + gf_mul[i * q + a]]);
+        } else {
+            // (0, x, m * x + c)
+            nbrs.push_back(i * q + gf_add[gf_mul[a * q + i] * q + b]);
+        }
+    }
+    std::sort(nbrs.begin(), nbrs.end());
+}
+
+int topo_slimfly::portForNeighbor(int rtr) const {
+    return hosts_per_router + (std::lower_bound(neighbors.begin(), neighbors.end(), rtr) - neighbors.begin());
+}
+
+int topo_slimfly::lowestCommonNeighbor(int a, int b) const {
+    std::vector<int> nbrs;
+    getNeighbors(a, nbrs);
+    for (int n : nbrs) {
+        if (connected(n, b))
+            return n;
+    }
+    return -1;
+}
+
+void topo_slimfly::route(int port, int vc, internal_router_event *ev) {
+    auto *ts_ev = static_cast<topo_slimfly_event *>(ev);
+
+    if (ts_ev->dest_router == (uint32_t)router_id) {
+        ts_ev->setNextPort(ts_ev->dest_host);
+        return;
+    }
+
+    if (port < hosts_per_router) {
+        // Entering the network, which uses the first VC of the VN
+        if (algorithm == UGAL) {
+            chooseUGAL(vc, ts_ev);
+        } else {
+            ts_ev->setNextPort(route_table[ts_ev->dest_router]);
+        }
+        return;
+    }
+
+    // Came in from another router.  Move up a VC.
+    ts_ev->setVC(vc + 1);
+    if (ts_ev->mid_router == router_id)
+        ts_ev->mid_router = -1;
+    int target = (ts_ev->mid_router == -1) ? ts_ev->dest_router : ts_ev->mid_router;
+    ts_ev->setNextPort(route_table[target]);
+}
+
+void topo_slimfly::reroute(int port, int vc, internal_router_event *ev) {
+    // The UGAL decision is only made at the source router
+    if (algorithm != UGAL || port >= hosts_per_router)
+        return;
+
+    auto *ts_ev = static_cast<topo_slimfly_event *>(ev);
+    if (ts_ev->dest_router == (uint32_t)router_id)
+        return;
+    chooseUGAL(vc, ts_ev);
+}
+
+// UGAL-L: take the Valiant route if its output queue, weighted by
+// the hop count of the route, is shorter than the minimal one's.
+void topo_slimfly::chooseUGAL(int vc, topo_slimfly_event *ev) {
+    int dest = ev->dest_router;
+    int mid = ev->mid_router_shadow;
+
+    int min_port = route_table[dest];
+    int val_port = route_table[mid];
+
+    int min_hops = connected(router_id, dest) ? 1 : 2;
+    int val_hops = (connected(router_id, mid) ? 1 : 2) + (connected(mid, dest) ? 1 : 2);
+
+    int min_weight = output_queue_lengths[min_port * num_vcs + vc] * min_hops;
+    int val_weight = output_queue_lengths[val_port * num_vcs + vc] * val_hops;
+
+    if (min_weight > val_weight + ugal_threshold) {
+        ev->mid_router = mid;
+        ev->setNextPort(val_port);
+    } else {
+        ev->mid_router = -1;
+        ev->setNextPort(min_port);
+    }
+}
+
+internal_router_event *topo_slimfly::process_input(RtrEvent *ev) {
+    int dest = ev->getDest();
+    auto *ts_ev = new topo_slimfly_event(router_id, dest / hosts_per_router, dest % hosts_per_router);
+    ts_ev->setEncapsulatedEvent(ev);
+    ts_ev->setVC(ts_ev->getVN() * vcs_per_vn);
+
+    if (algorithm == UGAL && ts_ev->dest_router != (uint32_t)router_id) {
+        int mid;
+        do {
+            mid = rng->generateNextUInt32() % num_routers;
+        } while (mid == router_id || mid == (int)ts_ev->dest_router);
+        ts_ev->mid_router_shadow = mid;
+    }
+    return ts_ev;
+}
+
+void topo_slimfly::routeInitData(int port, internal_router_event *ev, std::vector<int> &outPorts) {
+    auto *ts_ev = static_cast<topo_slimfly_event *>(ev);
+
+    if (ts_ev->dest_host != (uint32_t)INIT_BROADCAST_ADDR) {
+        if (ts_ev->dest_router == (uint32_t)router_id)
+            outPorts.push_back(ts_ev->dest_host);
+        else
+            outPorts.push_back(route_table[ts_ev->dest_router]);
+        return;
+    }
+
+    if (port < hosts_per_router) {
+        // Came in from a host.  Send to all other hosts and all
+        // neighbors.
+        for (int p = 0; p < hosts_per_router + num_router_ports; p++) {
+            if (p != port)
+                outPorts.push_back(p);
+        }
+        return;
+    }
+
+    for (int p = 0; p < hosts_per_router; p++) {
+        outPorts.push_back(p);
+    }
+
+    // Came straight from the source router.  Routers two hops from
+    // the source get the broadcast from their lowest numbered common
+    // neighbor with it.
+    int src = ts_ev->src_router;
+    if (neighbors[port - hosts_per_router] != src)
+        return;
+    for (int i = 0; i < num_router_ports; i++) {
+        int target = neighbors[i];
+        if (target == src || connected(src, target))
+            continue;
+        if (lowestCommonNeighbor(src, target) == router_id)
+            outPorts.push_back(hosts_per_router + i);
+    }
+}
+
+internal_router_event *topo_slimfly::process_InitData_input(RtrEvent *ev) {
+    int dest = ev->getDest();
+    topo_slimfly_event *ts_ev;
+    if (dest == INIT_BROADCAST_ADDR) {
+        ts_ev = new topo_slimfly_event(router_id, INIT_BROADCAST_ADDR, INIT_BROADCAST_ADDR);
+    } else {
+        ts_ev = new topo_slimfly_event(router_id, dest / hosts_per_router, dest % hosts_per_router);
+    }
+    ts_ev->setEncapsulatedEvent(ev);
+    return ts_ev;
+}
+
+Topology::PortState topo_slimfly::getPortState(int port) const {
+    if (port < hosts_per_router)
+        return R2N;
+    if (port < hosts_per_router + num_router_ports)
+        return R2R;
+    return UNCONNECTED;
+}
+
+void topo_slimfly::setOutputQueueLengthsArray(int const *array, int vcs) {
+    output_queue_lengths = array;
+    num_vcs = vcs;
+}
@@ -0,0 +1,169 @@
+// -*- mode: c++ -*-
+
+// Copyright 2009-2020 NTESS. Under the terms
+// of Contract DE-NA0003525 with NTESS, the U.S.
+// Government retains certain rights in this software.
+//
+// Copyright (c) 2009-2020, NTESS
+// All rights reserved.
+//
+// Portions are copyright of other developers:
+// See the file CONTRIBUTORS.TXT in the top level directory
+// the distribution for more information.
+//
+// This file is part of the SST software package. For license
+// information, see the LICENSE file in the top level directory of the
+// distribution.
+
+#ifndef COMPONENTS_MERLIN_TOPOLOGY_SLIMFLY_H
+#define COMPONENTS_MERLIN_TOPOLOGY_SLIMFLY_H
+
+#include <sst/core/event.h>
+#include <sst/core/link.h>
+#include <sst/core/params.h>
+#include <sst/core/rng/sstrng.h>
+
+#include <vector>
+
+#include "../router.h"
+
+namespace SST {
+namespace Merlin {
+
+class topo_slimfly_event : public internal_router_event {
+
+  public:
+    uint32_t src_router;
+    uint32_t dest_router;
+    uint32_t dest_host;
+    // Intermediate router for a Valiant route, or -1 for a minimal
+    // route.  mid_router_shadow is the one that gets used if UGAL
+    // picks the Valiant route.
+    int32_t mid_router;
+    int32_t mid_router_shadow;
+
+    topo_slimfly_event() = default;
+    topo_slimfly_event(uint32_t src, uint32_t dest, uint32_t host)
+        : src_router(src), dest_router(dest), dest_host(host), mid_router(-1), mid_router_shadow(-1) {}
+    ~topo_slimfly_event() override = default;
+
+    MERLIN_POOLED_EVENT(topo_slimfly_event)
+
+    internal_router_event *clone() override { return new topo_slimfly_event(*this); }
+
+    void serialize_order(SST::Core::Serialization::serializer &ser) override {
+        internal_router_event::serialize_order(ser);
+        ser &src_router;
+        ser &dest_router;
+        ser &dest_host;
+        ser &mid_router;
+        ser &mid_router_shadow;
+    }
+
+  private:
+    ImplementSerializable(SST::Merlin::topo_slimfly_event)
+};
+
+// Slim Fly built from the McKay-Miller-Siran (MMS) graph for a prime
+// power q = 4w + delta, delta in {-1, 0, 1}.  There are 2q^2 routers,
+// (0, x, y) and (1, m, c) with x, y, m, c in GF(q), and the diameter
+// is 2.  Router (s, a, b) has id s * q^2 + a * q + b.  Links are:
+//
+//   (0, x, y) -- (0, x, y')  if y - y' is in X
+//   (1, m, c) -- (1, m, c')  if c - c' is in X'
+//   (0, x, y) -- (1, m, c)   if y = m * x + c
+//
+// where X and X' are built from powers of a primitive element of
+// GF(q).  Each router has (3q - delta) / 2 router links.
+//
+// Assumed connectivity of each router:
+//   ports [0, p-1]:  Hosts
+//   ports [p, k-1]:  Other routers, in order of router id
+//
+// The VC is bumped on every router to router hop, so it always goes
+// up along a path.  Minimal routes are at most 2 hops and Valiant
+// routes at most 4, which sets the number of VCs per VN.
+class topo_slimfly : public Topology {
+
+  public:
+    SST_ELI_REGISTER_SUBCOMPONENT_DERIVED(topo_slimfly, "merlin", "slimfly", SST_ELI_ELEMENT_VERSION(1, 0, 0),
+                                          "Slim Fly topology object built from the MMS graph",
+                                          SST::Merlin::Topology)
+
+    SST_ELI_DOCUMENT_PARAMS(
+        {"q", "Prime power used to build the MMS graph.  There will be 2q^2 routers."},
+        {"hosts_per_router", "Number of hosts connected to each router."},
+        {"algorithm",
+         "Routing algorithm to use [minimal (default) | ugal].  ugal chooses between the minimal route and a "
+         "Valiant route through a random router at the source router, based on local output queue lengths "
+         "(UGAL-L).",
+         "minimal"},
+        {"ugal_threshold",
+         "Number of flits the hop weighted queue length of the minimal route has to exceed that of the Valiant "
+         "route by before UGAL takes the Valiant route.",
+         "0"})
+
+    enum RouteAlgo { MINIMAL, UGAL };
+
+  private:
+    int router_id;
+    int num_ports;
+    int q;
+    int num_routers;
+    int hosts_per_router;
+    int num_router_ports;
+
+    RouteAlgo algorithm;
+    int ugal_threshold;
+    int vcs_per_vn;
+
+    // GF(q) arithmetic tables, indexed by a * q + b
+    std::vector<int> gf_add;
+    std::vector<int> gf_sub;
+    std::vector<int> gf_mul;
+    // Membership in X and X'
+    std::vector<bool> in_x;
+    std::vector<bool> in_x_prime;
+
+    // Neighboring routers, in port order
+    std::vector<int> neighbors;
+    // Minimal route table: output port for each destination router
+    std::vector<uint16_t> route_table;
+
+    RNG::SSTRandom *rng;
+
+    int const *output_queue_lengths;
+    int num_vcs;
+
+  public:
+    topo_slimfly(ComponentId_t cid, Params &params, int num_ports, int rtr_id);
+    ~topo_slimfly() override;
+
+    void route(int port, int vc, internal_router_event *ev) override;
+    void reroute(int port, int vc, internal_router_event *ev) override;
+    internal_router_event *process_input(RtrEvent *ev) override;
+
+    PortState getPortState(int port) const override;
+
+    void routeInitData(int port, internal_router_event *ev, std::vector<int> &outPorts) override;
+    internal_router_event *process_InitData_input(RtrEvent *ev) override;
+
+    int computeNumVCs(int vns) override { return vns * vcs_per_vn; }
+    int getEndpointID(int port) override { return router_id * hosts_per_router + port; }
+
+    void setOutputQueueLengthsArray(int const *array, int vcs) override;
+
+  private:
+    void buildField(std::vector<int> &powers);
+    void buildGeneratorSets(const std::vector<int> &powers);
+    bool connected(int a, int b) const;
+    void getNeighbors(int rtr, std::vector<int> &nbrs) const;
+    int portForNeighbor(int rtr) const;
+    int lowestCommonNeighbor(int a, int b) const;
+    void chooseUGAL(int vc, topo_slimfly_event *ev);
+};
+
+} // namespace Merlin
+} // namespace SST
+
+#endif // COMPONENTS_MERLIN_TOPOLOGY_SLIMFLY_H
@@ -21,7 +21,7 @@
 using namespace SST::Merlin;
 
 topo_torus::topo_torus(ComponentId_t cid, Params &params, int num_ports, int rtr_id)
-    : Topology(cid), router_id(rtr_id) {
+    : Topology(cid), router_id(rtr_id), output_credits(nullptr), output_queue_lengths(nullptr), num_vcs(0) {
 
     // Get the various parameters
     std::string shape;
@@ -32,6 +32,10 @@ topo_torus::topo_torus(ComponentId_t cid, Params &params, int num_ports, int rtr
     // Need to parse the shape string to get the number of dimensions
     // and the size of each dimension
     dimensions = std::count(shape.begin(), shape.end(), 'x') + 1;
+    if (dimensions > MERLIN_MAX_DIMENSIONS) {
+        output.fatal(CALL_INFO, -1, "torus: number of dimensions (%d) exceeds MERLIN_MAX_DIMENSIONS (%d)\n", dimensions,
+                     MERLIN_MAX_DIMENSIONS);
+    }
 
     dim_size = new int[dimensions];
     dim_width = new int[dimensions];
@@ -57,6 +61,17 @@ topo_torus::topo_torus(ComponentId_t cid, Params &params, int num_ports, int rtr
 
     num_local_ports = params.find<int>("local_ports", 1);
 
+    std::string route_algo = params.find<std::string>("algorithm", "dor");
+    if (route_algo == "dor") {
+        algorithm = DOR;
+        vcs_per_vn = 2;
+    } else if (route_algo == "adaptive") {
+        algorithm = ADAPTIVE;
+        vcs_per_vn = 3;
+    } else {
+        output.fatal(CALL_INFO, -1, "Invalid algorithm specified for torus: %s.\n", route_algo.c_str());
+    }
+
     // int n_vc = params.find<int>("num_vcs");
     // if ( n_vc < 2 || (n_vc & 1) ) {
     //     output.fatal(CALL_INFO, -1, "Number of VC's must be a multiple of two for a torus\n");
@@ -86,53 +101,199 @@ topo_torus::~topo_torus() {
 }
 
 void topo_torus::route(int port, int vc, internal_router_event *ev) {
+    if (algorithm == ADAPTIVE) {
+        if (get_dest_router(ev->getDest()) == router_id)
+            ev->setNextPort(get_dest_local_port(ev->getDest()));
+        else
+            routeAdaptive(port, vc, static_cast<topo_torus_event *>(ev));
+        return;
+    }
+    routeDOR(port, vc, ev);
+}
+
+void topo_torus::reroute(int port, int vc, internal_router_event *ev) {
+    // Dimension order routing always picks the same port
+    if (algorithm == DOR)
+        return;
+    route(port, vc, ev);
+}
+
+void topo_torus::routeDOR(int port, int vc, internal_router_event *ev) {
     int dest_router = get_dest_router(ev->getDest());
     if (dest_router == router_id) {
         ev->setNextPort(get_dest_local_port(ev->getDest()));
     } else {
-        auto *tt_ev = static_cast<topo_torus_event *>(ev);
+        routeFrom(id_loc, port, vc, static_cast<topo_torus_event *>(ev));
+    }
+}
 
-        for (int dim = tt_ev->routing_dim; dim < dimensions; dim++) {
-            if (tt_ev->dest_loc[dim] != id_loc[dim]) {
+// Dimension order routing step for a packet at the router at loc,
+// which is not the destination router
+void topo_torus::routeFrom(const int *loc, int port, int vc, topo_torus_event *tt_ev) {
+    for (int dim = tt_ev->routing_dim; dim < dimensions; dim++) {
+        if (tt_ev->dest_loc[dim] != loc[dim]) {
 
-                int dist_neg = id_loc[dim] - tt_ev->dest_loc[dim];
-                if (dist_neg < 0)
-                    dist_neg += dim_size[dim];
-                int dist_pos = tt_ev->dest_loc[dim] - id_loc[dim];
-                if (dist_pos < 0)
-                    dist_pos += dim_size[dim];
+            int dist_neg = loc[dim] - tt_ev->dest_loc[dim];
+            if (dist_neg < 0)
+                dist_neg += dim_size[dim];
+            int dist_pos = tt_ev->dest_loc[dim] - loc[dim];
+            if (dist_pos < 0)
+                dist_pos += dim_size[dim];
 
-                int go_pos = (dist_pos <= dist_neg);
+            int go_pos = (dist_pos <= dist_neg);
 
-                output.verbose(CALL_INFO, 1, 1, " %d to %d:  Dist Neg: %d, Dist Pos: %d\n", id_loc[dim],
-                               tt_ev->dest_loc[dim], dist_neg, dist_pos);
+            output.verbose(CALL_INFO, 1, 1, " %d to %d:  Dist Neg: %d, Dist Pos: %d\n", loc[dim], tt_ev->dest_loc[dim],
+                           dist_neg, dist_pos);
 
-                int p =
-                    choose_multipath(port_start[dim][(go_pos) ? 0 : 1], dim_width[dim], (go_pos) ? dist_pos : dist_neg);
+            int p = choose_multipath(port_start[dim][(go_pos) ? 0 : 1], dim_width[dim], (go_pos) ? dist_pos : dist_neg);
 
-                tt_ev->setNextPort(p);
+            tt_ev->setNextPort(p);
 
-                if (id_loc[dim] == 0 && port < local_port_start) { // Crossing dateline
-                    int new_vc = vc ^ 1;
-                    tt_ev->setVC(new_vc); // Toggle VC
-                    output.verbose(CALL_INFO, 1, 1, "Crossing dateline.  Changing from VC %d to %d\n", vc, new_vc);
-                }
+            if (loc[dim] == 0 && port < local_port_start) { // Crossing dateline
+                int new_vc = vc ^ 1;
+                tt_ev->setVC(new_vc); // Toggle VC
+                output.verbose(CALL_INFO, 1, 1, "Crossing dateline.  Changing from VC %d to %d\n", vc, new_vc);
+            }
 
+            break;
+
+        } else {
+            // Time to change direction
+            tt_ev->routing_dim++;
+            tt_ev->setVC(vc & (~1)); // Reset the VC
+        }
+    }
+}
+
+// Walks the path route() would take from this router to the
+// destination.  A packet leaving on the positive port k of a
+// dimension arrives on the negative port k of the next router, and
+// vice versa.
+bool topo_torus::computeSourceRoute(int port, int vc, internal_router_event *ev) {
+    if (algorithm != DOR)
+        return false;
+
+    // Scratch copy so the routing state in the event isn't touched
+    topo_torus_event scratch(*static_cast<topo_torus_event *>(ev));
+    scratch.setEncapsulatedEvent(nullptr);
+
+    int loc[MERLIN_MAX_DIMENSIONS];
+    for (int i = 0; i < dimensions; i++)
+        loc[i] = id_loc[i];
+
+    SourceRoute route;
+    while (true) {
+        bool at_dest = true;
+        for (int i = 0; i < dimensions; i++) {
+            if (loc[i] != scratch.dest_loc[i]) {
+                at_dest = false;
                 break;
+            }
+        }
+        if (at_dest) {
+            if (!route.addHop(get_dest_local_port(ev->getDest()), vc))
+                return false;
+            ev->setSourceRoute(route);
+            return true;
+        }
 
-            } else {
-                // Time to change direction
-                tt_ev->routing_dim++;
-                tt_ev->setVC(vc & (~1)); // Reset the VC
+        routeFrom(loc, port, vc, &scratch);
+        int out_port = scratch.getNextPort();
+        vc = scratch.getVC();
+        if (!route.addHop(out_port, vc))
+            return false;
+
+        // Move to the next router
+        for (int dim = 0; dim < dimensions; dim++) {
+            int offset = out_port - port_start[dim][0];
+            if (offset >= 0 && offset < dim_width[dim]) {
+                loc[dim] = (loc[dim] + 1) % dim_size[dim];
+                port = port_start[dim][1] + offset;
+                break;
+            }
+            offset = out_port - port_start[dim][1];
+            if (offset >= 0 && offset < dim_width[dim]) {
+                loc[dim] = (loc[dim] + dim_size[dim] - 1) % dim_size[dim];
+                port = port_start[dim][0] + offset;
+                break;
             }
         }
     }
 }
 
+// Minimal adaptive routing.  The packet takes the productive link
+// with the shortest output queue on the adaptive VC, among those with
+// room for it.  If none have room, it takes the dimension order link
+// on an escape VC.  Once on an escape VC, a packet stays on the
+// escape VCs for the rest of its path.
+//
+// The escape dateline VC is picked from where the packet is rather
+// than where it has been: VC 0 if the rest of the path in the current
+// dimension still crosses the wraparound link, and VC 1 if it
+// doesn't.  Packets on VC 1 never use the wraparound link and packets
+// on VC 0 move to VC 1 after it, so neither VC has a cycle.
+void topo_torus::routeAdaptive(int port, int vc, topo_torus_event *tt_ev) {
+    int base_vc = tt_ev->getVN() * vcs_per_vn;
+    int adaptive_vc = base_vc + 2;
+    bool escape_only = port < local_port_start && vc != adaptive_vc;
+    int flits = tt_ev->getFlitCount();
+
+    int escape_port = -1;
+    int escape_vc = base_vc;
+    int best_port = -1;
+    int best_length = 0;
+    for (int dim = 0; dim < dimensions; dim++) {
+        if (tt_ev->dest_loc[dim] == id_loc[dim])
+            continue;
+
+        int dist_neg = id_loc[dim] - tt_ev->dest_loc[dim];
+        if (dist_neg < 0)
+            dist_neg += dim_size[dim];
+        int dist_pos = tt_ev->dest_loc[dim] - id_loc[dim];
+        if (dist_pos < 0)
+            dist_pos += dim_size[dim];
+
+        if (escape_port == -1) {
+            bool go_pos = (dist_pos <= dist_neg);
+            escape_port =
+                choose_multipath(port_start[dim][go_pos ? 0 : 1], dim_width[dim], go_pos ? dist_pos : dist_neg);
+            bool crosses = go_pos ? (id_loc[dim] + dist_pos >= dim_size[dim]) : (id_loc[dim] < dist_neg);
+            escape_vc = base_vc + (crosses ? 0 : 1);
+            if (escape_only)
+                break;
+        }
+
+        // Both directions are minimal when the destination is half
+        // way around
+        for (int dir = 0; dir < 2; dir++) {
+            if ((dir == 0 && dist_pos > dist_neg) || (dir == 1 && dist_neg > dist_pos))
+                continue;
+            for (int i = 0; i < dim_width[dim]; i++) {
+                int p = port_start[dim][dir] + i;
+                int index = p * num_vcs + adaptive_vc;
+                if (output_credits[index] < flits)
+                    continue;
+                if (best_port == -1 || output_queue_lengths[index] < best_length) {
+                    best_port = p;
+                    best_length = output_queue_lengths[index];
+                }
+            }
+        }
+    }
+
+    if (best_port != -1) {
+        tt_ev->setNextPort(best_port);
+        tt_ev->setVC(adaptive_vc);
+    } else {
+        tt_ev->setNextPort(escape_port);
+        tt_ev->setVC(escape_vc);
+    }
+}
+
 internal_router_event *topo_torus::process_input(RtrEvent *ev) {
     auto *tt_ev = new topo_torus_event(dimensions);
     tt_ev->setEncapsulatedEvent(ev);
-    tt_ev->setVC(tt_ev->getVN() * 2);
+    tt_ev->setVC(tt_ev->getVN() * vcs_per_vn);
 
     // Need to figure out what the torus address is for easier
     // routing.
@@ -173,7 +334,7 @@ void topo_torus::routeInitData(int port, internal_router_event *ev, std::vector<
         }
 
     } else {
-        route(port, 0, ev);
+        routeDOR(port, 0, ev);
         outPorts.push_back(ev->getNextPort());
     }
 }
@@ -239,10 +400,20 @@ int topo_torus::choose_multipath(int start_port, int num_ports, int dest_dist) {
     }
 }
 
-int topo_torus::computeNumVCs(int vns) { return 2 * vns; }
+int topo_torus::computeNumVCs(int vns) { return vcs_per_vn * vns; }
 
 int topo_torus::getEndpointID(int port) {
     if (!isHostPort(port))
         return -1;
     return (router_id * num_local_ports) + (port - local_port_start);
 }
+
+void topo_torus::setOutputBufferCreditArray(int const *array, int vcs) {
+    output_credits = array;
+    num_vcs = vcs;
+}
+
+void topo_torus::setOutputQueueLengthsArray(int const *array, int vcs) {
+    output_queue_lengths = array;
+    num_vcs = vcs;
+}
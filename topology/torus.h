@@ -22,8 +22,6 @@
 #include <sst/core/link.h>
 #include <sst/core/params.h>
 
-#include <cstring>
-
 #include "../router.h"
 
 namespace SST {
@@ -33,31 +31,24 @@ class topo_torus_event : public internal_router_event {
   public:
     int dimensions;
     int routing_dim;
-    int *dest_loc;
+    int dest_loc[MERLIN_MAX_DIMENSIONS];
 
     topo_torus_event() = default;
     topo_torus_event(int dim) {
         dimensions = dim;
         routing_dim = 0;
-        dest_loc = new int[dim];
-    }
-    ~topo_torus_event() override { delete[] dest_loc; }
-    internal_router_event *clone() override {
-        auto *tte = new topo_torus_event(*this);
-        tte->dest_loc = new int[dimensions];
-        memcpy(tte->dest_loc, dest_loc, dimensions * sizeof(int));
-        return tte;
     }
+    ~topo_torus_event() override = default;
+
+    MERLIN_POOLED_EVENT(topo_torus_event)
+
+    internal_router_event *clone() override { return new topo_torus_event(*this); }
 
     void serialize_order(SST::Core::Serialization::serializer &ser) override {
         internal_router_event::serialize_order(ser);
         ser &dimensions;
         ser &routing_dim;
 
-        if (ser.mode() == SST::Core::Serialization::serializer::UNPACK) {
-            dest_loc = new int[dimensions];
-        }
-
         for (int i = 0; i < dimensions; i++) {
             ser &dest_loc[i];
         }
@@ -79,12 +70,22 @@ class topo_torus : public Topology {
         {"torus:width", "Number of links between routers in each dimension, specified in same manner as for shape.  "
                         "For example, 2x2x1 denotes 2 links in the x and y dimensions and one in the z dimension."},
         {"torus:local_ports", "Number of endpoints attached to each router."},
+        {"torus:algorithm",
+         "Routing algorithm to use [dor (default) | adaptive].  adaptive is minimal adaptive routing with dimension "
+         "order escape VCs.",
+         "dor"},
 
         {"shape", "Shape of the torus specified as the number of routers in each dimension, where each dimension is "
                   "separated by an x.  For example, 4x4x2x2.  Any number of dimensions is supported."},
         {"width", "Number of links between routers in each dimension, specified in same manner as for shape.  For "
                   "example, 2x2x1 denotes 2 links in the x and y dimensions and one in the z dimension."},
-        {"local_ports", "Number of endpoints attached to each router."}, )
+        {"local_ports", "Number of endpoints attached to each router."},
+        {"algorithm",
+         "Routing algorithm to use [dor (default) | adaptive].  adaptive is minimal adaptive routing with dimension "
+         "order escape VCs.",
+         "dor"}, )
+
+    enum RouteAlgo { DOR, ADAPTIVE };
 
   private:
     int router_id;
@@ -99,12 +100,26 @@ class topo_torus : public Topology {
     int num_local_ports;
     int local_port_start;
 
+    // In adaptive mode, each VN has three VCs.  The first two are the
+    // escape VCs, which use dimension order routing with a dateline,
+    // and the third is the adaptive VC, which can take any productive
+    // link.  This is Duato's protocol: a packet can always fall back
+    // to the escape VCs, which can't deadlock.
+    RouteAlgo algorithm;
+    int vcs_per_vn;
+
+    int const *output_credits;
+    int const *output_queue_lengths;
+    int num_vcs;
+
   public:
     topo_torus(ComponentId_t cid, Params &params, int num_ports, int rtr_id);
     ~topo_torus() override;
 
     void route(int port, int vc, internal_router_event *ev) override;
+    void reroute(int port, int vc, internal_router_event *ev) override;
     internal_router_event *process_input(RtrEvent *ev) override;
+    bool computeSourceRoute(int port, int vc, internal_router_event *ev) override;
 
     void routeInitData(int port, internal_router_event *ev, std::vector<int> &outPorts) override;
     internal_router_event *process_InitData_input(RtrEvent *ev) override;
@@ -113,10 +128,16 @@ class topo_torus : public Topology {
     int computeNumVCs(int vns) override;
     int getEndpointID(int port) override;
 
+    void setOutputBufferCreditArray(int const *array, int vcs) override;
+    void setOutputQueueLengthsArray(int const *array, int vcs) override;
+
   protected:
     virtual int choose_multipath(int start_port, int num_ports, int dest_dist);
 
   private:
+    void routeDOR(int port, int vc, internal_router_event *ev);
+    void routeFrom(const int *loc, int port, int vc, topo_torus_event *ev);
+    void routeAdaptive(int port, int vc, topo_torus_event *ev);
     void idToLocation(int id, int *location) const;
     void parseDimString(const std::string &shape, int *output) const;
     int get_dest_router(int dest_id) const;